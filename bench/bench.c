@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+// the link step wraps the allocator for the srpo sources built into the benchmarks, allocations inside the libraries are not counted
+static uint64_t bench_allocs = 0;
+static uint64_t bench_alloc_bytes = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t size);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+char *__wrap_strdup(const char *s);
+char *__wrap_strndup(const char *s, size_t size);
+
+static void bench_alloc_count(size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	bench_alloc_count(size);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	bench_alloc_count(nmemb * size);
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	bench_alloc_count(size);
+	return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+	bench_alloc_count(strlen(s) + 1);
+	return __real_strdup(s);
+}
+
+char *__wrap_strndup(const char *s, size_t size)
+{
+	bench_alloc_count(strnlen(s, size) + 1);
+	return __real_strndup(s, size);
+}
+
+uint64_t bench_clock(void)
+{
+	struct timespec now = {0};
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+void bench_begin(bench_mark_t *mark)
+{
+	mark->allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+	mark->alloc_bytes = __atomic_load_n(&bench_alloc_bytes, __ATOMIC_RELAXED);
+	mark->elapsed_ns = 0;
+	mark->start_ns = bench_clock();
+}
+
+void bench_end(bench_mark_t *mark)
+{
+	mark->elapsed_ns = bench_clock() - mark->start_ns;
+	mark->allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED) - mark->allocs;
+	mark->alloc_bytes = __atomic_load_n(&bench_alloc_bytes, __ATOMIC_RELAXED) - mark->alloc_bytes;
+}
+
+void bench_report(const char *name, const char *params, size_t iterations, const bench_mark_t *mark)
+{
+	double ns_per_op = (double) mark->elapsed_ns / (double) iterations;
+
+	// one JSON object per line, easy to collect and compare between releases
+	printf("{\"benchmark\": \"%s\"%s%s, \"iterations\": %zu, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f, \"allocs_per_op\": %.2f, \"alloc_bytes_per_op\": %.1f}\n",
+		   name, params[0] ? ", " : "", params, iterations, ns_per_op, ns_per_op > 0 ? 1e9 / ns_per_op : 0.0,
+		   (double) mark->allocs / (double) iterations, (double) mark->alloc_bytes / (double) iterations);
+	fflush(stdout);
+}
+
+static void bench_alloc_count(size_t size)
+{
+	// the library may allocate from its worker threads while a benchmark runs
+	__atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&bench_alloc_bytes, size, __ATOMIC_RELAXED);
+}
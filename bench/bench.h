@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef BENCH_H_ONCE
+#define BENCH_H_ONCE
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	uint64_t start_ns;
+	uint64_t elapsed_ns;
+	uint64_t allocs;
+	uint64_t alloc_bytes;
+} bench_mark_t;
+
+uint64_t bench_clock(void);
+void bench_begin(bench_mark_t *mark);
+void bench_end(bench_mark_t *mark);
+// params are extra JSON members without the surrounding braces, e.g. "\"sections\": 100", or an empty string
+void bench_report(const char *name, const char *params, size_t iterations, const bench_mark_t *mark);
+
+#endif /* BENCH_H_ONCE */
@@ -0,0 +1,397 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "srpo_uci.h"
+#include "srpo_stats.h"
+#include "utils/memory.h"
+#include "bench.h"
+
+#define BENCH_PACKAGE "bench"
+#define BENCH_PATH_SIZE 256
+
+typedef struct {
+	size_t sections;
+	size_t list_size;
+	size_t iterations;
+	char config_dir[BENCH_PATH_SIZE];
+	char config_path[BENCH_PATH_SIZE];
+} bench_ctx_t;
+
+static int bench_config_write(bench_ctx_t *ctx);
+static int bench_load(bench_ctx_t *ctx);
+static int bench_ucipath_list_get(bench_ctx_t *ctx, srpo_uci_handle_t *handle);
+static int bench_convert(bench_ctx_t *ctx, size_t map_size);
+static int bench_element_value_get(bench_ctx_t *ctx, srpo_uci_handle_t *handle);
+static int bench_set_revert(bench_ctx_t *ctx, srpo_uci_handle_t *handle);
+static int bench_commit(bench_ctx_t *ctx, srpo_uci_handle_t *handle);
+static void bench_stats_report(void);
+
+int main(int argc, char **argv)
+{
+	int error = 0;
+	int opt = 0;
+	srpo_uci_handle_t *handle = NULL;
+	bench_ctx_t ctx = {
+		.sections = 10000,
+		.list_size = 64,
+		.iterations = 100000,
+	};
+
+	while ((opt = getopt(argc, argv, "s:l:i:")) != -1) {
+		switch (opt) {
+			case 's':
+				ctx.sections = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				ctx.list_size = strtoul(optarg, NULL, 10);
+				break;
+			case 'i':
+				ctx.iterations = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-s sections] [-l list size] [-i iterations]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (ctx.sections < 2 || ctx.iterations == 0) {
+		fprintf(stderr, "%s: at least 2 sections and 1 iteration are needed\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	snprintf(ctx.config_dir, sizeof(ctx.config_dir), "/tmp/srpo_bench.XXXXXX");
+	if (mkdtemp(ctx.config_dir) == NULL) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	snprintf(ctx.config_path, sizeof(ctx.config_path), "%s/%s", ctx.config_dir, BENCH_PACKAGE);
+
+	error = bench_config_write(&ctx);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_load(&ctx);
+	if (error) {
+		goto out;
+	}
+
+	error = srpo_uci_handle_init(ctx.config_dir, &handle);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_ucipath_list_get(&ctx, handle);
+	if (error) {
+		goto out;
+	}
+
+	for (size_t map_size = 50; map_size <= 500 && error == 0; map_size *= map_size == 50 ? 2 : 5) {
+		error = bench_convert(&ctx, map_size);
+	}
+	if (error) {
+		goto out;
+	}
+
+	error = bench_element_value_get(&ctx, handle);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_set_revert(&ctx, handle);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_commit(&ctx, handle);
+	if (error) {
+		goto out;
+	}
+
+	bench_stats_report();
+
+out:
+	if (error) {
+		fprintf(stderr, "%s: %s\n", argv[0], error > 0 ? "benchmark setup failed" : srpo_uci_error_description_get(error));
+	}
+	if (handle) {
+		srpo_uci_handle_cleanup(handle);
+	}
+	unlink(ctx.config_path);
+	rmdir(ctx.config_dir);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int bench_config_write(bench_ctx_t *ctx)
+{
+	FILE *config = fopen(ctx->config_path, "w");
+
+	if (config == NULL) {
+		perror(ctx->config_path);
+		return 1;
+	}
+
+	// half named sections with a list each, half anonymous sections
+	for (size_t i = 0; i < ctx->sections / 2; i++) {
+		fprintf(config, "config host 'host%zu'\n", i);
+		fprintf(config, "\toption name 'host%zu'\n", i);
+		fprintf(config, "\toption address '10.%zu.%zu.%zu'\n", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+		fprintf(config, "\toption enabled '1'\n");
+		for (size_t j = 0; j < ctx->list_size; j++) {
+			fprintf(config, "\tlist alias 'alias%zu'\n", j);
+		}
+		fprintf(config, "\n");
+	}
+
+	for (size_t i = 0; i < ctx->sections - ctx->sections / 2; i++) {
+		fprintf(config, "config rule\n");
+		fprintf(config, "\toption src 'lan'\n");
+		fprintf(config, "\toption dest_port '%zu'\n", i);
+		fprintf(config, "\toption target 'ACCEPT'\n\n");
+	}
+
+	return fclose(config) == 0 ? 0 : 1;
+}
+
+static int bench_load(bench_ctx_t *ctx)
+{
+	int error = 0;
+	const char *config_list[] = {BENCH_PACKAGE};
+	size_t iterations = ctx->iterations / 10000 ? ctx->iterations / 10000 : 1;
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	// a fresh handle has to parse the whole package
+	bench_begin(&mark);
+	for (size_t i = 0; i < iterations && error == 0; i++) {
+		srpo_uci_handle_t *handle = NULL;
+
+		error = srpo_uci_handle_init(ctx->config_dir, &handle);
+		if (error == 0) {
+			error = srpo_uci_handle_preload(handle, config_list, 1, 1);
+			srpo_uci_handle_cleanup(handle);
+		}
+	}
+	bench_end(&mark);
+	snprintf(params, sizeof(params), "\"sections\": %zu, \"list_size\": %zu", ctx->sections, ctx->list_size);
+	bench_report("package_load", params, iterations, &mark);
+
+	return error;
+}
+
+static int bench_ucipath_list_get(bench_ctx_t *ctx, srpo_uci_handle_t *handle)
+{
+	int error = 0;
+	const char *section_list[] = {"host", "rule"};
+	char **ucipath_list = NULL;
+	size_t ucipath_list_size = 0;
+	size_t iterations = ctx->iterations / 10000 ? ctx->iterations / 10000 : 1;
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	bench_begin(&mark);
+	for (size_t i = 0; i < iterations && error == 0; i++) {
+		error = srpo_uci_handle_ucipath_list_get(handle, BENCH_PACKAGE, section_list, 2, &ucipath_list, &ucipath_list_size, true);
+		for (size_t j = 0; j < ucipath_list_size; j++) {
+			FREE_SAFE(ucipath_list[j]);
+		}
+		FREE_SAFE(ucipath_list);
+	}
+	bench_end(&mark);
+	snprintf(params, sizeof(params), "\"sections\": %zu, \"list_size\": %zu", ctx->sections, ctx->list_size);
+	bench_report("ucipath_list_get", params, iterations, &mark);
+
+	return error;
+}
+
+static int bench_convert(bench_ctx_t *ctx, size_t map_size)
+{
+	int error = 0;
+	srpo_uci_xpath_uci_template_map_t *map = xcalloc(map_size, sizeof(srpo_uci_xpath_uci_template_map_t));
+	char (*xpath_templates)[BENCH_PATH_SIZE] = xcalloc(map_size, BENCH_PATH_SIZE);
+	char (*ucipath_templates)[BENCH_PATH_SIZE] = xcalloc(map_size, BENCH_PATH_SIZE);
+	char (*xpaths)[BENCH_PATH_SIZE] = xcalloc(map_size, BENCH_PATH_SIZE);
+	char (*ucipaths)[BENCH_PATH_SIZE] = xcalloc(map_size, BENCH_PATH_SIZE);
+	char *converted = NULL;
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	// every entry maps a different option of the host sections, the lookups hit the entries evenly
+	for (size_t i = 0; i < map_size; i++) {
+		snprintf(xpath_templates[i], BENCH_PATH_SIZE, "/bench:hosts/host[name='%%s']/attribute%zu", i);
+		snprintf(ucipath_templates[i], BENCH_PATH_SIZE, BENCH_PACKAGE ".%%s.attribute%zu", i);
+		snprintf(xpaths[i], BENCH_PATH_SIZE, "/bench:hosts/host[name='host%zu']/attribute%zu", i % (ctx->sections / 2), i);
+		snprintf(ucipaths[i], BENCH_PATH_SIZE, BENCH_PACKAGE ".host%zu.attribute%zu", i % (ctx->sections / 2), i);
+		map[i].xpath_template = xpath_templates[i];
+		map[i].ucipath_template = ucipath_templates[i];
+		map[i].uci_section_type = "host";
+	}
+	snprintf(params, sizeof(params), "\"map_size\": %zu", map_size);
+
+	bench_begin(&mark);
+	for (size_t i = 0; i < ctx->iterations && error == 0; i++) {
+		error = srpo_uci_xpath_to_ucipath_convert(xpaths[i % map_size], map, map_size, &converted);
+		FREE_SAFE(converted);
+	}
+	bench_end(&mark);
+	bench_report("xpath_to_ucipath_convert", params, ctx->iterations, &mark);
+
+	bench_begin(&mark);
+	for (size_t i = 0; i < ctx->iterations && error == 0; i++) {
+		error = srpo_uci_ucipath_to_xpath_convert(ucipaths[i % map_size], map, map_size, &converted);
+		FREE_SAFE(converted);
+	}
+	bench_end(&mark);
+	bench_report("ucipath_to_xpath_convert", params, ctx->iterations, &mark);
+
+	FREE_SAFE(map);
+	FREE_SAFE(xpath_templates);
+	FREE_SAFE(ucipath_templates);
+	FREE_SAFE(xpaths);
+	FREE_SAFE(ucipaths);
+
+	return error;
+}
+
+static int bench_element_value_get(bench_ctx_t *ctx, srpo_uci_handle_t *handle)
+{
+	int error = 0;
+	const char *names[] = {"element_value_get_option", "element_value_get_anonymous", "element_value_get_list"};
+	size_t sections[] = {ctx->sections / 2, ctx->sections - ctx->sections / 2, ctx->sections / 2};
+	char ucipath[BENCH_PATH_SIZE] = {0};
+	char **value_list = NULL;
+	size_t value_list_size = 0;
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	snprintf(params, sizeof(params), "\"sections\": %zu, \"list_size\": %zu", ctx->sections, ctx->list_size);
+
+	for (size_t k = 0; k < sizeof(names) / sizeof(names[0]) && error == 0; k++) {
+		// the sections are visited with a stride so consecutive lookups do not hit neighbouring sections
+		bench_begin(&mark);
+		for (size_t i = 0; i < ctx->iterations && error == 0; i++) {
+			size_t section = (i * 7919) % sections[k];
+
+			if (k == 0) {
+				snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".host%zu.address", section);
+			} else if (k == 1) {
+				snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".@rule[%zu].dest_port", section);
+			} else {
+				snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".host%zu.alias", section);
+			}
+			error = srpo_uci_handle_element_value_get(handle, ucipath, NULL, NULL, &value_list, &value_list_size);
+			for (size_t j = 0; j < value_list_size; j++) {
+				FREE_SAFE(value_list[j]);
+			}
+			FREE_SAFE(value_list);
+		}
+		bench_end(&mark);
+		bench_report(names[k], params, ctx->iterations, &mark);
+	}
+
+	return error;
+}
+
+static int bench_set_revert(bench_ctx_t *ctx, srpo_uci_handle_t *handle)
+{
+	int error = 0;
+	size_t iterations = ctx->iterations / 10 ? ctx->iterations / 10 : 1;
+	size_t revert_iterations = iterations / 1000 ? iterations / 1000 : 1;
+	char ucipath[BENCH_PATH_SIZE] = {0};
+	char value[32] = {0};
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	snprintf(params, sizeof(params), "\"sections\": %zu", ctx->sections);
+
+	// the first edit parses the package for writing, it is not part of the measurement
+	error = srpo_uci_handle_option_set(handle, BENCH_PACKAGE ".host0.enabled", "0", NULL, NULL);
+	if (error) {
+		return error;
+	}
+
+	bench_begin(&mark);
+	for (size_t i = 0; i < iterations && error == 0; i++) {
+		snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".host%zu.enabled", (i * 7919) % (ctx->sections / 2));
+		snprintf(value, sizeof(value), "%zu", i & 1);
+		error = srpo_uci_handle_option_set(handle, ucipath, value, NULL, NULL);
+	}
+	bench_end(&mark);
+	bench_report("option_set", params, iterations, &mark);
+	if (error) {
+		return error;
+	}
+
+	// every revert rolls back the same number of edits
+	bench_begin(&mark);
+	for (size_t i = 0; i < revert_iterations && error == 0; i++) {
+		for (size_t j = 0; j < 1000 && error == 0; j++) {
+			snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".host%zu.enabled", (j * 7919) % (ctx->sections / 2));
+			error = srpo_uci_handle_option_set(handle, ucipath, "0", NULL, NULL);
+		}
+		if (error == 0) {
+			error = srpo_uci_handle_revert(handle, BENCH_PACKAGE);
+		}
+	}
+	bench_end(&mark);
+	bench_report("option_set_1000_revert", params, revert_iterations, &mark);
+
+	return error;
+}
+
+static int bench_commit(bench_ctx_t *ctx, srpo_uci_handle_t *handle)
+{
+	int error = 0;
+	size_t iterations = ctx->iterations / 10000 ? ctx->iterations / 10000 : 1;
+	char ucipath[BENCH_PATH_SIZE] = {0};
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	snprintf(params, sizeof(params), "\"sections\": %zu", ctx->sections);
+
+	// a commit writes and syncs the whole package and publishes it for the readers
+	bench_begin(&mark);
+	for (size_t i = 0; i < iterations && error == 0; i++) {
+		snprintf(ucipath, sizeof(ucipath), BENCH_PACKAGE ".host%zu.enabled", i % (ctx->sections / 2));
+		error = srpo_uci_handle_option_set(handle, ucipath, i & 1 ? "1" : "0", NULL, NULL);
+		if (error == 0) {
+			error = srpo_uci_handle_commit(handle, BENCH_PACKAGE);
+		}
+	}
+	bench_end(&mark);
+	bench_report("option_set_commit", params, iterations, &mark);
+
+	return error;
+}
+
+static void bench_stats_report(void)
+{
+	srpo_stats_t stats;
+
+	// the library's own latency distribution over the whole run
+	srpo_stats_get(&stats);
+	for (size_t i = 0; i < SRPO_STATS_OP_COUNT; i++) {
+		const srpo_stats_op_t *op = &stats.ops[i];
+
+		if (op->count == 0) {
+			continue;
+		}
+
+		printf("{\"stats\": \"%s\", \"count\": %llu, \"errors\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}\n",
+			   srpo_stats_op_name_get((srpo_stats_op_e) i), (unsigned long long) op->count, (unsigned long long) op->errors,
+			   (unsigned long long) srpo_stats_percentile_get(op, 50.0), (unsigned long long) srpo_stats_percentile_get(op, 99.0),
+			   (unsigned long long) op->max_ns);
+	}
+}
@@ -0,0 +1,414 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <libubus.h>
+#include <libubox/blobmsg.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "srpo_ubus.h"
+#include "srpo_stats.h"
+#include "utils/memory.h"
+#include "bench.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#endif
+
+#define BENCH_OBJECT "srpo.bench"
+#define BENCH_METHOD "get"
+#define BENCH_PATH_SIZE 256
+#define BENCH_VALUE_SIZE_MAX 200
+#define BENCH_XPATH_TEMPLATE "/bench:state/value[name='%s']"
+
+typedef struct {
+	const char *ubusd;
+	size_t reply_size;
+	size_t value_size;
+	unsigned int latency_us;
+	size_t iterations;
+	char socket_dir[BENCH_PATH_SIZE];
+	char socket_path[BENCH_PATH_SIZE];
+	pid_t ubusd_pid;
+	pid_t server_pid;
+} bench_ctx_t;
+
+static struct blob_buf bench_reply;
+static unsigned int bench_latency_us;
+
+static int bench_server_get(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req, const char *method, struct blob_attr *msg);
+
+static const struct ubus_method bench_server_methods[] = {
+	UBUS_METHOD_NOARG(BENCH_METHOD, bench_server_get),
+};
+
+static struct ubus_object_type bench_server_object_type = UBUS_OBJECT_TYPE("srpo-bench", bench_server_methods);
+
+static struct ubus_object bench_server_object = {
+	.name = BENCH_OBJECT,
+	.type = &bench_server_object_type,
+	.methods = bench_server_methods,
+	.n_methods = ARRAY_SIZE(bench_server_methods),
+};
+
+static int bench_ubusd_start(bench_ctx_t *ctx);
+static int bench_server_start(bench_ctx_t *ctx);
+static void bench_server_run(bench_ctx_t *ctx);
+static void bench_stop(bench_ctx_t *ctx);
+static void bench_transform_cb(const char *ubus_json, srpo_ubus_result_values_t *values);
+static int bench_latency_compare(const void *a, const void *b);
+static int bench_call(bench_ctx_t *ctx, const char *name, srpo_ubus_transform_data_cb transform_data_cb);
+static int bench_result_values_add(bench_ctx_t *ctx);
+
+int main(int argc, char **argv)
+{
+	int error = 0;
+	int opt = 0;
+	struct rusage usage = {0};
+	bench_ctx_t ctx = {
+		.ubusd = "ubusd",
+		.reply_size = 1000,
+		.value_size = 32,
+		.latency_us = 0,
+		.iterations = 10000,
+	};
+
+	while ((opt = getopt(argc, argv, "u:n:v:l:i:")) != -1) {
+		switch (opt) {
+			case 'u':
+				ctx.ubusd = optarg;
+				break;
+			case 'n':
+				ctx.reply_size = strtoul(optarg, NULL, 10);
+				break;
+			case 'v':
+				ctx.value_size = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				ctx.latency_us = (unsigned int) strtoul(optarg, NULL, 10);
+				break;
+			case 'i':
+				ctx.iterations = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-u ubusd] [-n reply values] [-v value size] [-l latency us] [-i iterations]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (ctx.iterations == 0 || ctx.value_size == 0 || ctx.value_size > BENCH_VALUE_SIZE_MAX) {
+		fprintf(stderr, "%s: at least 1 iteration and a value size between 1 and %d are needed\n", argv[0], BENCH_VALUE_SIZE_MAX);
+		return EXIT_FAILURE;
+	}
+
+	snprintf(ctx.socket_dir, sizeof(ctx.socket_dir), "/tmp/srpo_ubus_bench.XXXXXX");
+	if (mkdtemp(ctx.socket_dir) == NULL) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	snprintf(ctx.socket_path, sizeof(ctx.socket_path), "%s/ubus.sock", ctx.socket_dir);
+
+	error = bench_ubusd_start(&ctx);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_server_start(&ctx);
+	if (error) {
+		goto out;
+	}
+
+	error = srpo_ubus_socket_path_set(ctx.socket_path);
+	if (error) {
+		goto out;
+	}
+
+	// the bare call only sends the reply over the socket, the pipeline also formats it and fills the result values
+	error = bench_call(&ctx, "ubus_call", NULL);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_call(&ctx, "ubus_call_result_values", bench_transform_cb);
+	if (error) {
+		goto out;
+	}
+
+	error = bench_result_values_add(&ctx);
+	if (error) {
+		goto out;
+	}
+
+	getrusage(RUSAGE_SELF, &usage);
+	printf("{\"benchmark\": \"max_rss\", \"max_rss_kb\": %ld}\n", usage.ru_maxrss);
+
+out:
+	if (error) {
+		fprintf(stderr, "%s: %s\n", argv[0], error > 0 ? "benchmark setup failed" : srpo_ubus_error_description_get(error));
+	}
+	srpo_ubus_socket_path_set(NULL);
+	bench_stop(&ctx);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int bench_ubusd_start(bench_ctx_t *ctx)
+{
+	struct ubus_context *ubus_ctx = NULL;
+
+	ctx->ubusd_pid = fork();
+	if (ctx->ubusd_pid < 0) {
+		perror("fork");
+		return 1;
+	}
+
+	if (ctx->ubusd_pid == 0) {
+		execlp(ctx->ubusd, ctx->ubusd, "-s", ctx->socket_path, (char *) NULL);
+		perror(ctx->ubusd);
+		_exit(EXIT_FAILURE);
+	}
+
+	// ubusd has no readiness notification, the socket is polled for up to 5 seconds
+	for (int i = 0; i < 500 && ubus_ctx == NULL; i++) {
+		ubus_ctx = ubus_connect(ctx->socket_path);
+		if (ubus_ctx == NULL) {
+			usleep(10000);
+		}
+	}
+
+	if (ubus_ctx == NULL) {
+		fprintf(stderr, "%s: no ubusd listening on %s\n", ctx->ubusd, ctx->socket_path);
+		return 1;
+	}
+
+	ubus_free(ubus_ctx);
+
+	return 0;
+}
+
+static int bench_server_start(bench_ctx_t *ctx)
+{
+	struct ubus_context *ubus_ctx = NULL;
+	uint32_t id = 0;
+	int ubus_error = UBUS_STATUS_NOT_FOUND;
+
+	// the fake object runs in its own process so its uloop does not share anything with the measured calls
+	fflush(stdout);
+	ctx->server_pid = fork();
+	if (ctx->server_pid < 0) {
+		perror("fork");
+		return 1;
+	}
+
+	if (ctx->server_pid == 0) {
+		bench_server_run(ctx);
+		_exit(EXIT_FAILURE);
+	}
+
+	ubus_ctx = ubus_connect(ctx->socket_path);
+	if (ubus_ctx == NULL) {
+		return 1;
+	}
+
+	for (int i = 0; i < 500 && ubus_error != UBUS_STATUS_OK; i++) {
+		ubus_error = ubus_lookup_id(ubus_ctx, BENCH_OBJECT, &id);
+		if (ubus_error != UBUS_STATUS_OK) {
+			usleep(10000);
+		}
+	}
+
+	ubus_free(ubus_ctx);
+
+	if (ubus_error != UBUS_STATUS_OK) {
+		fprintf(stderr, "object %s was not registered\n", BENCH_OBJECT);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void bench_server_run(bench_ctx_t *ctx)
+{
+	struct ubus_context *ubus_ctx = NULL;
+	char value[BENCH_VALUE_SIZE_MAX + 1] = {0};
+	void *array = NULL;
+
+	// the reply is built once, every call gets the same values
+	blob_buf_init(&bench_reply, 0);
+	array = blobmsg_open_array(&bench_reply, "values");
+	for (size_t i = 0; i < ctx->reply_size; i++) {
+		int prefix_size = snprintf(value, sizeof(value), "%zu-", i);
+
+		for (size_t j = (size_t) prefix_size; j < ctx->value_size; j++) {
+			value[j] = 'x';
+		}
+		value[ctx->value_size > (size_t) prefix_size ? ctx->value_size : (size_t) prefix_size] = '\0';
+		blobmsg_add_string(&bench_reply, NULL, value);
+	}
+	blobmsg_close_array(&bench_reply, array);
+	bench_latency_us = ctx->latency_us;
+
+	uloop_init();
+	ubus_ctx = ubus_connect(ctx->socket_path);
+	if (ubus_ctx == NULL) {
+		return;
+	}
+	ubus_add_uloop(ubus_ctx);
+
+	if (ubus_add_object(ubus_ctx, &bench_server_object) != UBUS_STATUS_OK) {
+		fprintf(stderr, "adding object %s failed\n", BENCH_OBJECT);
+		ubus_free(ubus_ctx);
+		return;
+	}
+
+	uloop_run();
+
+	ubus_free(ubus_ctx);
+	uloop_done();
+	blob_buf_free(&bench_reply);
+}
+
+static int bench_server_get(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req, const char *method, struct blob_attr *msg)
+{
+	if (bench_latency_us) {
+		usleep(bench_latency_us);
+	}
+
+	ubus_send_reply(ctx, req, bench_reply.head);
+
+	return UBUS_STATUS_OK;
+}
+
+static void bench_stop(bench_ctx_t *ctx)
+{
+	if (ctx->server_pid > 0) {
+		kill(ctx->server_pid, SIGTERM);
+		waitpid(ctx->server_pid, NULL, 0);
+	}
+
+	if (ctx->ubusd_pid > 0) {
+		kill(ctx->ubusd_pid, SIGTERM);
+		waitpid(ctx->ubusd_pid, NULL, 0);
+	}
+
+	unlink(ctx->socket_path);
+	rmdir(ctx->socket_dir);
+}
+
+static void bench_transform_cb(const char *ubus_json, srpo_ubus_result_values_t *values)
+{
+	char value[BENCH_VALUE_SIZE_MAX + 1] = {0};
+	const char *start = strchr(ubus_json, '[');
+
+	// the reply is a flat array of plain strings, a JSON parser would measure the parser instead of srpo
+	while (start && (start = strchr(start, '"')) != NULL) {
+		const char *end = strchr(start + 1, '"');
+		size_t value_size = 0;
+
+		if (end == NULL) {
+			break;
+		}
+
+		value_size = (size_t) (end - start - 1);
+		if (value_size > BENCH_VALUE_SIZE_MAX) {
+			value_size = BENCH_VALUE_SIZE_MAX;
+		}
+		memcpy(value, start + 1, value_size);
+		value[value_size] = '\0';
+
+		srpo_ubus_result_values_add(values, value, value_size, BENCH_XPATH_TEMPLATE, sizeof(BENCH_XPATH_TEMPLATE), value, value_size + 1);
+		start = end + 1;
+	}
+}
+
+static int bench_latency_compare(const void *a, const void *b)
+{
+	uint64_t latency_a = *(const uint64_t *) a;
+	uint64_t latency_b = *(const uint64_t *) b;
+
+	return latency_a < latency_b ? -1 : latency_a > latency_b;
+}
+
+static int bench_call(bench_ctx_t *ctx, const char *name, srpo_ubus_transform_data_cb transform_data_cb)
+{
+	srpo_ubus_error_e error = SRPO_UBUS_ERR_OK;
+	srpo_ubus_call_data_t call_data = {
+		.lookup_path = BENCH_OBJECT,
+		.method = BENCH_METHOD,
+		.json_call_arguments = NULL,
+		.timeout = 5000,
+		.transform_data_cb = transform_data_cb,
+	};
+	srpo_ubus_result_values_t *values = NULL;
+	uint64_t *latencies = xcalloc(ctx->iterations, sizeof(uint64_t));
+	char params[256] = {0};
+	bench_mark_t mark = {0};
+	size_t i = 0;
+
+	bench_begin(&mark);
+	for (i = 0; i < ctx->iterations && error == SRPO_UBUS_ERR_OK; i++) {
+		uint64_t start_ns = bench_clock();
+
+		srpo_ubus_init_result_values(&values);
+		error = srpo_ubus_call(values, &call_data);
+		if (error == SRPO_UBUS_ERR_OK && transform_data_cb && values->num_values != ctx->reply_size) {
+			fprintf(stderr, "%s: %zu of %zu values received\n", name, values->num_values, ctx->reply_size);
+			error = SRPO_UBUS_ERR_INTERNAL;
+		}
+		srpo_ubus_free_result_values(values);
+
+		latencies[i] = bench_clock() - start_ns;
+	}
+	bench_end(&mark);
+
+	if (error == SRPO_UBUS_ERR_OK) {
+		qsort(latencies, ctx->iterations, sizeof(uint64_t), bench_latency_compare);
+		snprintf(params, sizeof(params), "\"reply_size\": %zu, \"value_size\": %zu, \"latency_us\": %u, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu",
+				 ctx->reply_size, ctx->value_size, ctx->latency_us, (unsigned long long) latencies[ctx->iterations / 2],
+				 (unsigned long long) latencies[ctx->iterations * 99 / 100], (unsigned long long) latencies[ctx->iterations - 1]);
+		bench_report(name, params, ctx->iterations, &mark);
+	}
+
+	FREE_SAFE(latencies);
+
+	return error;
+}
+
+static int bench_result_values_add(bench_ctx_t *ctx)
+{
+	srpo_ubus_error_e error = SRPO_UBUS_ERR_OK;
+	srpo_ubus_result_values_t *values = NULL;
+	char value[BENCH_VALUE_SIZE_MAX + 1] = {0};
+	size_t iterations = ctx->iterations * (ctx->reply_size ? ctx->reply_size : 1);
+	char params[64] = {0};
+	bench_mark_t mark = {0};
+
+	memset(value, 'x', ctx->value_size);
+
+	// the values are added the way a transform callback adds a whole reply, per value cost without the socket
+	bench_begin(&mark);
+	for (size_t i = 0; i < ctx->iterations && error == SRPO_UBUS_ERR_OK; i++) {
+		srpo_ubus_init_result_values(&values);
+		for (size_t j = 0; j < iterations / ctx->iterations && error == SRPO_UBUS_ERR_OK; j++) {
+			error = srpo_ubus_result_values_add(values, value, ctx->value_size, BENCH_XPATH_TEMPLATE, sizeof(BENCH_XPATH_TEMPLATE), value, ctx->value_size + 1);
+		}
+		srpo_ubus_free_result_values(values);
+	}
+	bench_end(&mark);
+
+	snprintf(params, sizeof(params), "\"reply_size\": %zu, \"value_size\": %zu", ctx->reply_size, ctx->value_size);
+	bench_report("result_values_add", params, iterations, &mark);
+
+	return error;
+}
@@ -0,0 +1,21 @@
+# LIBYANG_FOUND - true if library and headers were found
+# LIBYANG_INCLUDE_DIRS - include directories
+# LIBYANG_LIBRARIES - library directories
+
+find_package(PkgConfig)
+pkg_check_modules(PC_LIBYANG QUIET libyang)
+
+find_path(LIBYANG_INCLUDE_DIR libyang/libyang.h
+	HINTS ${PC_LIBYANG_INCLUDEDIR} ${PC_LIBYANG_INCLUDE_DIRS})
+
+find_library(LIBYANG_LIBRARY NAMES yang
+	HINTS ${PC_LIBYANG_LIBDIR} ${PC_LIBYANG_LIBRARY_DIRS})
+
+set(LIBYANG_LIBRARIES ${LIBYANG_LIBRARY})
+set(LIBYANG_INCLUDE_DIRS ${LIBYANG_INCLUDE_DIR})
+
+include(FindPackageHandleStandardArgs)
+
+find_package_handle_standard_args(LIBYANG DEFAULT_MSG LIBYANG_LIBRARY LIBYANG_INCLUDE_DIR)
+
+mark_as_advanced(LIBYANG_INCLUDE_DIR LIBYANG_LIBRARY)
@@ -0,0 +1,30 @@
+# srpo_uci_template_map(<name> <description>)
+#
+# Generates <name>.c and <name>.h from a JSON or YAML mapping description.
+# They define the srpo_uci_xpath_uci_template_map_t table <name>, its size
+# <name>_size and the srpo_uci_template_index_t perfect hash index
+# <name>_index.
+#
+# <name>_SOURCES - generated source to add to the plugin target
+# <name>_INCLUDE_DIRS - directory holding the generated header
+
+find_package(PythonInterp 3 REQUIRED)
+
+set(SRPO_TEMPLATE_MAP_GEN "${CMAKE_CURRENT_LIST_DIR}/srpo_template_map_gen.py")
+
+function(srpo_uci_template_map NAME DESCRIPTION)
+	get_filename_component(DESCRIPTION_PATH ${DESCRIPTION} ABSOLUTE)
+	set(OUTPUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/srpo_template_map")
+
+	file(MAKE_DIRECTORY ${OUTPUT_DIR})
+
+	add_custom_command(
+		OUTPUT ${OUTPUT_DIR}/${NAME}.c ${OUTPUT_DIR}/${NAME}.h
+		COMMAND ${PYTHON_EXECUTABLE} ${SRPO_TEMPLATE_MAP_GEN} --name ${NAME} --output-dir ${OUTPUT_DIR} ${DESCRIPTION_PATH}
+		DEPENDS ${DESCRIPTION_PATH} ${SRPO_TEMPLATE_MAP_GEN}
+		COMMENT "Generating template map ${NAME}"
+	)
+
+	set(${NAME}_SOURCES ${OUTPUT_DIR}/${NAME}.c PARENT_SCOPE)
+	set(${NAME}_INCLUDE_DIRS ${OUTPUT_DIR} PARENT_SCOPE)
+endfunction()
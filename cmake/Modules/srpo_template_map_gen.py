@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Copyright (c) 2020 Deutsche Telekom AG.
+#
+# Generates a constant srpo_uci_xpath_uci_template_map_t table together with a
+# srpo_uci_template_index_t perfect hash index from a JSON (or YAML) mapping
+# description. The key matching and the hash need to stay in sync with
+# template_key_find and template_hash in src/srpo_uci.c.
+
+import argparse
+import json
+import os
+import sys
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+SEED_LIMIT = 1 << 24
+
+FIELDS = [
+    ("xpath_template", "string", True),
+    ("ucipath_template", "string", True),
+    ("uci_section_type", "string", False),
+    ("transform_path_cb", "symbol", False),
+    ("transform_sysrepo_data_cb", "symbol", False),
+    ("transform_uci_data_cb", "symbol", False),
+    ("has_transform_sysrepo_data_private", "bool", False),
+    ("has_transform_uci_data_private", "bool", False),
+]
+
+
+def template_hash(seed, data):
+    value = FNV_OFFSET ^ seed
+    for byte in data:
+        value ^= byte
+        value = (value * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def key_find_ucipath(path):
+    # the section name, the second component of the UCI path
+    dot = path.find(b".")
+    if dot < 0:
+        return None
+    start = dot + 1
+    end = path.find(b".", start)
+    end = len(path) if end < 0 else end
+    section = path[start:end]
+    if not section or section.startswith(b"@") or any(c in section for c in b"[]="):
+        return None
+    return start, end
+
+
+def key_find_xpath(path):
+    # the value of the first list key predicate, e.g. [name='value']
+    bracket = path.find(b"[")
+    if bracket < 0:
+        return None
+    end = bracket + 1
+    while end < len(path) and path[end] not in b"=]":
+        end += 1
+    if end + 1 >= len(path) or path[end] != ord("=") or path[end + 1] not in b"'\"":
+        return None
+    quote = path[end + 1]
+    start = end + 2
+    end = path.find(bytes([quote]), start)
+    if end < 0 or end + 1 >= len(path) or path[end + 1] != ord("]"):
+        return None
+    return start, end
+
+
+def key_offset(template):
+    return template.find(b"%s")
+
+
+def hashable(source, target, key_find):
+    # only templates whose key sits where the library looks for it are hashed,
+    # the others keep the generic srpo_uci_path_get matching
+    offset = key_offset(source)
+    if offset < 0:
+        return key_offset(target) < 0
+    if source.count(b"%s") != 1 or target.count(b"%s") > 1:
+        return False
+    return key_find(source) == (offset, offset + 2)
+
+
+def c_string(value):
+    if value is None:
+        return "NULL"
+    out = '"'
+    for byte in value:
+        char = chr(byte)
+        if char in '"\\':
+            out += "\\" + char
+        elif 0x20 <= byte < 0x7F and char != "?":
+            out += char
+        else:
+            out += "\\%03o" % byte
+    return out + '"'
+
+
+def perfect_hash(keys):
+    # hash and displace: every bucket gets a seed that moves all of its keys to free slots
+    size = len(keys)
+    if size == 0:
+        return [], []
+
+    buckets = [[] for _ in range((size + 1) // 2)]
+    for position, key in keys:
+        buckets[template_hash(0, key) % len(buckets)].append((position, key))
+
+    seeds = [0] * len(buckets)
+    slots = [None] * size
+    for bucket_index in sorted(range(len(buckets)), key=lambda i: -len(buckets[i])):
+        bucket = buckets[bucket_index]
+        if not bucket:
+            continue
+        for seed in range(1, SEED_LIMIT):
+            taken = [template_hash(seed, key) % size for _, key in bucket]
+            if len(set(taken)) == len(taken) and all(slots[slot] is None for slot in taken):
+                break
+        else:
+            raise RuntimeError("no perfect hash seed found")
+        seeds[bucket_index] = seed
+        for (position, _), slot in zip(bucket, taken):
+            slots[slot] = position
+
+    return seeds, slots
+
+
+def direction_build(entries, source_field, target_field, key_find):
+    keys = []
+    seen = set()
+    fallback = []
+
+    for position, entry in enumerate(entries):
+        source = entry[source_field]
+        target = entry[target_field]
+        if entry["transform_path_cb"] or not hashable(source, target, key_find):
+            fallback.append(position)
+        elif source not in seen:
+            # a later template with the same path is never matched by the linear search either
+            seen.add(source)
+            keys.append((position, source))
+
+    seeds, slots = perfect_hash(keys)
+
+    return seeds, slots, fallback
+
+
+def entry_load(index, raw):
+    entry = {}
+
+    if not isinstance(raw, dict):
+        raise ValueError("template %d: expected an object" % index)
+
+    for name, kind, required in FIELDS:
+        value = raw.get(name)
+        if value is None:
+            if required:
+                raise ValueError("template %d: missing %s" % (index, name))
+            entry[name] = False if kind == "bool" else None
+        elif kind == "bool":
+            entry[name] = bool(value)
+        elif kind == "string":
+            entry[name] = str(value).encode("utf-8")
+        else:
+            entry[name] = str(value)
+
+    unknown = set(raw) - set(name for name, _, _ in FIELDS)
+    if unknown:
+        raise ValueError("template %d: unknown field %s" % (index, ", ".join(sorted(unknown))))
+
+    return entry
+
+
+def description_load(path):
+    with open(path, "r") as description_file:
+        if path.endswith((".yaml", ".yml")):
+            import yaml
+            description = yaml.safe_load(description_file)
+        else:
+            description = json.load(description_file)
+
+    if isinstance(description, list):
+        description = {"templates": description}
+
+    entries = [entry_load(i, raw) for i, raw in enumerate(description.get("templates", []))]
+    includes = description.get("includes", [])
+
+    return entries, includes
+
+
+def array_emit(lines, name, values):
+    if not values:
+        return "NULL, 0"
+    lines.append("static const uint32_t %s[] = {%s};" % (name, ", ".join(str(v) for v in values)))
+    return "%s, %d" % (name, len(values))
+
+
+def header_emit(name, source):
+    guard = name.upper() + "_H_ONCE"
+    return "\n".join([
+        "// generated by srpo_template_map_gen.py from %s, do not edit" % os.path.basename(source),
+        "",
+        "#ifndef %s" % guard,
+        "#define %s" % guard,
+        "",
+        "#include <srpo_uci.h>",
+        "",
+        "extern srpo_uci_xpath_uci_template_map_t %s[];" % name,
+        "extern const size_t %s_size;" % name,
+        "extern const srpo_uci_template_index_t %s_index;" % name,
+        "",
+        "#endif /* %s */" % guard,
+        "",
+    ])
+
+
+def source_emit(name, source, entries, includes):
+    lines = [
+        "// generated by srpo_template_map_gen.py from %s, do not edit" % os.path.basename(source),
+        "",
+        "#include \"%s.h\"" % name,
+    ]
+    lines += ["#include \"%s\"" % include for include in includes]
+    lines += ["", "srpo_uci_xpath_uci_template_map_t %s[] = {" % name]
+    for entry in entries:
+        values = []
+        for field, kind, _ in FIELDS:
+            value = entry[field]
+            if kind == "bool":
+                values.append("true" if value else "false")
+            elif kind == "string":
+                values.append(c_string(value))
+            else:
+                values.append(value if value else "NULL")
+        lines.append("\t{%s}," % ", ".join(values))
+    lines += ["};", "", "const size_t %s_size = %d;" % (name, len(entries)), ""]
+
+    keys = ", ".join("{%d, %d}" % (key_offset(e["xpath_template"]), key_offset(e["ucipath_template"])) for e in entries)
+    lines.append("static const srpo_uci_template_key_t %s_keys[] = {%s};" % (name, keys))
+
+    hashes = []
+    for direction, source_field, target_field, key_find in (("xpath", "xpath_template", "ucipath_template", key_find_xpath),
+                                                            ("ucipath", "ucipath_template", "xpath_template", key_find_ucipath)):
+        seeds, slots, fallback = direction_build(entries, source_field, target_field, key_find)
+        hashes.append("{%s, %s, %s}" % (array_emit(lines, "%s_%s_seeds" % (name, direction), seeds),
+                                        array_emit(lines, "%s_%s_slots" % (name, direction), slots),
+                                        array_emit(lines, "%s_%s_fallback" % (name, direction), fallback)))
+
+    lines += [
+        "",
+        "const srpo_uci_template_index_t %s_index = {%s, %d, %s_keys, %s, %s};" % (name, name, len(entries), name, hashes[0], hashes[1]),
+        "",
+    ]
+
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a srpo_uci template map with a perfect hash index.")
+    parser.add_argument("--name", required=True, help="C name of the generated map")
+    parser.add_argument("--output-dir", required=True, help="directory for <name>.c and <name>.h")
+    parser.add_argument("description", help="JSON or YAML mapping description")
+    args = parser.parse_args()
+
+    try:
+        entries, includes = description_load(args.description)
+    except (OSError, ValueError, ImportError) as error:
+        sys.stderr.write("%s: %s\n" % (args.description, error))
+        return 1
+
+    with open(os.path.join(args.output_dir, args.name + ".h"), "w") as header_file:
+        header_file.write(header_emit(args.name, args.description))
+    with open(os.path.join(args.output_dir, args.name + ".c"), "w") as source_file:
+        source_file.write(source_emit(args.name, args.description, entries, includes))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
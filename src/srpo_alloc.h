@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef SRPO_ALLOC_H_ONCE
+#define SRPO_ALLOC_H_ONCE
+
+#include <stddef.h>
+
+// every allocation of the library goes through the allocator, either all callbacks are set or none for libc
+typedef struct {
+	void *(*malloc_cb)(size_t size, void *private_data);
+	void *(*realloc_cb)(void *ptr, size_t size, void *private_data);
+	void (*free_cb)(void *ptr, void *private_data);
+	void *private_data;
+} srpo_allocator_t;
+
+int srpo_allocator_set(const srpo_allocator_t *allocator);
+
+void srpo_arena_begin(void);
+void srpo_arena_end(void);
+
+#endif /* SRPO_ALLOC_H_ONCE */
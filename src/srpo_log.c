@@ -0,0 +1,331 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "srpo_log.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+
+#define LOG_RING_SIZE 128 // records per thread, a power of two
+#define LOG_MESSAGE_SIZE 192
+
+typedef struct log_thread log_thread_t;
+
+typedef struct {
+	uint64_t timestamp_ns;
+	srpo_log_level_e level;
+	char message[LOG_MESSAGE_SIZE];
+} log_record_t;
+
+// records of one thread, only the thread itself moves head and only the drainer holding log_drain_lock moves tail
+struct log_thread {
+	log_record_t records[LOG_RING_SIZE];
+	size_t head;
+	size_t tail;
+	bool exited; // the ring is freed by the drainer once it is empty
+	log_thread_t *next;
+};
+
+srpo_log_level_e log_level = SRPO_LOG_LEVEL_WARNING;
+
+// log_drain_lock serializes the sink, log_threads_lock guards the list of rings, always taken in this order
+static pthread_mutex_t log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t log_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_thread_t *log_threads = NULL;
+static srpo_log_cb log_sink_cb = NULL;
+static void *log_sink_private_data = NULL;
+static bool log_buffered = false;
+static uint64_t log_dropped = 0;
+static pthread_key_t log_key;
+static pthread_once_t log_key_once = PTHREAD_ONCE_INIT;
+static __thread log_thread_t *log_thread = NULL;
+static __thread bool log_draining = false;
+
+static pthread_mutex_t log_drainer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_drainer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t log_drainer;
+static bool log_drainer_running = false;
+static bool log_drainer_stop = false;
+static bool log_drainer_buffered = false; // buffering as it was before the drain thread started
+static unsigned int log_drainer_interval_ms = 0;
+
+static uint64_t log_clock(void);
+static void log_key_create(void);
+static log_thread_t *log_thread_get(void);
+static void log_thread_exit(void *arg);
+static void log_drain(void);
+static void log_emit(const log_record_t *record);
+static void *log_drainer_run(void *arg);
+
+void srpo_log_level_set(srpo_log_level_e level)
+{
+	__atomic_store_n(&log_level, level, __ATOMIC_RELAXED);
+}
+
+srpo_log_level_e srpo_log_level_get(void)
+{
+	return __atomic_load_n(&log_level, __ATOMIC_RELAXED);
+}
+
+const char *srpo_log_level_name_get(srpo_log_level_e level)
+{
+	switch (level) {
+#define XM(ENUM, CODE, NAME) \
+	case ENUM:               \
+		return NAME;
+
+		SRPO_LOG_LEVEL_TABLE
+#undef XM
+
+		default:
+			return "unknown";
+	}
+}
+
+void srpo_log_cb_set(srpo_log_cb log_cb, void *private_data)
+{
+	// records already in the rings go to the sink they were written for
+	srpo_log_flush();
+
+	pthread_mutex_lock(&log_drain_lock);
+	log_sink_cb = log_cb;
+	log_sink_private_data = private_data;
+	pthread_mutex_unlock(&log_drain_lock);
+}
+
+void srpo_log_buffered_set(bool buffered)
+{
+	__atomic_store_n(&log_buffered, buffered, __ATOMIC_RELEASE);
+
+	if (!buffered) {
+		srpo_log_flush();
+	}
+}
+
+void srpo_log_flush(void)
+{
+	// a sink that ends up flushing again only finds what it already drains
+	if (log_draining) {
+		return;
+	}
+
+	pthread_mutex_lock(&log_drain_lock);
+	log_drain();
+	pthread_mutex_unlock(&log_drain_lock);
+}
+
+int srpo_log_thread_start(unsigned int interval_ms)
+{
+	int error = 0;
+
+	if (interval_ms == 0) {
+		return EINVAL;
+	}
+
+	pthread_mutex_lock(&log_drainer_lock);
+	if (log_drainer_running) {
+		error = EBUSY;
+		goto out;
+	}
+
+	log_drainer_buffered = __atomic_load_n(&log_buffered, __ATOMIC_RELAXED);
+	log_drainer_interval_ms = interval_ms;
+	log_drainer_stop = false;
+	__atomic_store_n(&log_buffered, true, __ATOMIC_RELEASE);
+
+	error = pthread_create(&log_drainer, NULL, log_drainer_run, NULL);
+	if (error) {
+		__atomic_store_n(&log_buffered, log_drainer_buffered, __ATOMIC_RELEASE);
+		goto out;
+	}
+	log_drainer_running = true;
+
+out:
+	pthread_mutex_unlock(&log_drainer_lock);
+
+	return error;
+}
+
+void srpo_log_thread_stop(void)
+{
+	pthread_mutex_lock(&log_drainer_lock);
+	if (!log_drainer_running) {
+		pthread_mutex_unlock(&log_drainer_lock);
+		return;
+	}
+	log_drainer_stop = true;
+	pthread_cond_signal(&log_drainer_cond);
+	pthread_mutex_unlock(&log_drainer_lock);
+
+	pthread_join(log_drainer, NULL);
+
+	pthread_mutex_lock(&log_drainer_lock);
+	log_drainer_running = false;
+	pthread_mutex_unlock(&log_drainer_lock);
+
+	// whatever was written after the last round goes out now
+	srpo_log_buffered_set(log_drainer_buffered);
+	srpo_log_flush();
+}
+
+uint64_t srpo_log_dropped_get(void)
+{
+	return __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+}
+
+void log_write(srpo_log_level_e level, const char *format, ...)
+{
+	va_list args;
+	log_thread_t *thread = NULL;
+	log_record_t *record = NULL;
+	log_record_t record_direct;
+	size_t head = 0;
+
+	// a sink that logs would only feed itself
+	if (log_draining) {
+		return;
+	}
+
+	// without buffering the record goes to the sink right away, like a plain printf would
+	if (!__atomic_load_n(&log_buffered, __ATOMIC_ACQUIRE)) {
+		record_direct.timestamp_ns = log_clock();
+		record_direct.level = level;
+		va_start(args, format);
+		vsnprintf(record_direct.message, sizeof(record_direct.message), format, args);
+		va_end(args);
+
+		pthread_mutex_lock(&log_drain_lock);
+		log_emit(&record_direct);
+		pthread_mutex_unlock(&log_drain_lock);
+		return;
+	}
+
+	thread = log_thread_get();
+	head = thread->head;
+
+	// a full ring drops the new record, the writer never waits for the drainer
+	if (head - __atomic_load_n(&thread->tail, __ATOMIC_ACQUIRE) == LOG_RING_SIZE) {
+		__atomic_add_fetch(&log_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	record = &thread->records[head & (LOG_RING_SIZE - 1)];
+	record->timestamp_ns = log_clock();
+	record->level = level;
+	va_start(args, format);
+	vsnprintf(record->message, sizeof(record->message), format, args);
+	va_end(args);
+
+	__atomic_store_n(&thread->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static uint64_t log_clock(void)
+{
+	struct timespec now = {0};
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static void log_key_create(void)
+{
+	pthread_key_create(&log_key, log_thread_exit);
+}
+
+static log_thread_t *log_thread_get(void)
+{
+	// a thread gets its ring with the first record it buffers
+	if (log_thread == NULL) {
+		pthread_once(&log_key_once, log_key_create);
+
+		log_thread = xcalloc(1, sizeof(log_thread_t));
+		pthread_setspecific(log_key, log_thread);
+
+		pthread_mutex_lock(&log_threads_lock);
+		log_thread->next = log_threads;
+		log_threads = log_thread;
+		pthread_mutex_unlock(&log_threads_lock);
+	}
+
+	return log_thread;
+}
+
+static void log_thread_exit(void *arg)
+{
+	log_thread_t *thread = arg;
+
+	// the records of an exiting thread are still drained, the drainer frees the ring afterwards
+	__atomic_store_n(&thread->exited, true, __ATOMIC_RELEASE);
+}
+
+static void log_drain(void)
+{
+	pthread_mutex_lock(&log_threads_lock);
+	for (log_thread_t **iter = &log_threads; *iter;) {
+		log_thread_t *thread = *iter;
+		// read before draining, an exited thread wrote its last record before it was marked
+		bool exited = __atomic_load_n(&thread->exited, __ATOMIC_ACQUIRE);
+		size_t head = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+
+		for (size_t tail = thread->tail; tail != head; tail++) {
+			log_emit(&thread->records[tail & (LOG_RING_SIZE - 1)]);
+			__atomic_store_n(&thread->tail, tail + 1, __ATOMIC_RELEASE);
+		}
+
+		if (exited) {
+			*iter = thread->next;
+			FREE_SAFE(thread);
+		} else {
+			iter = &thread->next;
+		}
+	}
+	pthread_mutex_unlock(&log_threads_lock);
+}
+
+static void log_emit(const log_record_t *record)
+{
+	static const int priorities[] = {
+		[SRPO_LOG_LEVEL_ERROR] = LOG_ERR,
+		[SRPO_LOG_LEVEL_WARNING] = LOG_WARNING,
+		[SRPO_LOG_LEVEL_INFO] = LOG_INFO,
+		[SRPO_LOG_LEVEL_DEBUG] = LOG_DEBUG,
+	};
+
+	log_draining = true;
+	if (log_sink_cb) {
+		log_sink_cb(record->level, record->timestamp_ns, record->message, log_sink_private_data);
+	} else {
+		syslog(priorities[record->level], "srpo %s: %s", srpo_log_level_name_get(record->level), record->message);
+	}
+	log_draining = false;
+}
+
+static void *log_drainer_run(void *arg)
+{
+	struct timespec deadline = {0};
+
+	pthread_mutex_lock(&log_drainer_lock);
+	while (!log_drainer_stop) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += log_drainer_interval_ms / 1000;
+		deadline.tv_nsec += (long) (log_drainer_interval_ms % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&log_drainer_cond, &log_drainer_lock, &deadline);
+
+		// the writers are never blocked by the sink, only the drainer waits for it
+		pthread_mutex_unlock(&log_drainer_lock);
+		srpo_log_flush();
+		pthread_mutex_lock(&log_drainer_lock);
+	}
+	pthread_mutex_unlock(&log_drainer_lock);
+
+	return NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file srpo_log.h
+ * @brief srpo_log - leveled logging of the srpo_ubus and srpo_uci calls through per-thread ring buffers.
+ *
+ * @copyright
+ * Copyright (C) 2020 Deutsche Telekom AG.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRPO_LOG_H_ONCE
+#define SRPO_LOG_H_ONCE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+#define SRPO_LOG_LEVEL_TABLE                    \
+	XM(SRPO_LOG_LEVEL_ERROR, 0, "error")        \
+	XM(SRPO_LOG_LEVEL_WARNING, 1, "warning")    \
+	XM(SRPO_LOG_LEVEL_INFO, 2, "info")          \
+	XM(SRPO_LOG_LEVEL_DEBUG, 3, "debug")
+
+#define XM(ENUM, CODE, NAME) ENUM = CODE,
+	SRPO_LOG_LEVEL_TABLE
+#undef XM
+} srpo_log_level_e;
+
+// called with the records in the order each thread wrote them, message is only valid during the call
+typedef void (*srpo_log_cb)(srpo_log_level_e level, uint64_t timestamp_ns, const char *message, void *private_data);
+
+void srpo_log_level_set(srpo_log_level_e level);
+srpo_log_level_e srpo_log_level_get(void);
+const char *srpo_log_level_name_get(srpo_log_level_e level);
+void srpo_log_cb_set(srpo_log_cb log_cb, void *private_data);
+void srpo_log_buffered_set(bool buffered);
+void srpo_log_flush(void);
+int srpo_log_thread_start(unsigned int interval_ms);
+void srpo_log_thread_stop(void);
+uint64_t srpo_log_dropped_get(void);
+
+#endif /* SRPO_LOG_H_ONCE */
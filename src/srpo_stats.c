@@ -0,0 +1,314 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <libubus.h>
+#include <libubox/blobmsg.h>
+
+#include "srpo_stats.h"
+#include "utils/memory.h"
+#include "utils/stats.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+typedef struct srpo_stats_thread srpo_stats_thread_t;
+
+// counters of one thread, only the thread itself writes them
+struct srpo_stats_thread {
+	srpo_stats_t stats;
+	srpo_stats_thread_t *next;
+};
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static srpo_stats_thread_t *stats_threads = NULL;
+static srpo_stats_t stats_exited; // counters of the threads that are gone, guarded by stats_lock
+static srpo_stats_memory_t stats_memory[SRPO_STATS_MEMORY_COUNT]; // shared by all threads, only updated atomically
+static pthread_key_t stats_key;
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+static __thread srpo_stats_thread_t *stats_thread = NULL;
+
+static void stats_key_create(void);
+static srpo_stats_thread_t *stats_thread_get(void);
+static void stats_thread_exit(void *arg);
+static void stats_merge(srpo_stats_t *stats, const srpo_stats_t *thread_stats);
+static void stats_counter_add(uint64_t *counter, uint64_t value);
+static size_t stats_bucket_get(uint64_t duration_ns);
+static int stats_ubus_get(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req, const char *method, struct blob_attr *msg);
+
+static const struct ubus_method stats_ubus_methods[] = {
+	UBUS_METHOD_NOARG("get", stats_ubus_get),
+};
+
+static struct ubus_object_type stats_ubus_object_type = UBUS_OBJECT_TYPE("srpo-stats", stats_ubus_methods);
+
+static struct ubus_object stats_ubus_object = {
+	.name = "srpo.stats",
+	.type = &stats_ubus_object_type,
+	.methods = stats_ubus_methods,
+	.n_methods = ARRAY_SIZE(stats_ubus_methods),
+};
+
+void srpo_stats_get(srpo_stats_t *stats)
+{
+	memset(stats, 0, sizeof(srpo_stats_t));
+
+	// the threads keep counting while they are merged, every counter is read once so the snapshot is consistent per counter only
+	pthread_mutex_lock(&stats_lock);
+	stats_merge(stats, &stats_exited);
+	for (srpo_stats_thread_t *thread = stats_threads; thread; thread = thread->next) {
+		stats_merge(stats, &thread->stats);
+	}
+	pthread_mutex_unlock(&stats_lock);
+
+	for (size_t i = 0; i < SRPO_STATS_MEMORY_COUNT; i++) {
+		stats->memory[i].bytes = __atomic_load_n(&stats_memory[i].bytes, __ATOMIC_RELAXED);
+		stats->memory[i].peak_bytes = __atomic_load_n(&stats_memory[i].peak_bytes, __ATOMIC_RELAXED);
+		stats->memory[i].evictions = __atomic_load_n(&stats_memory[i].evictions, __ATOMIC_RELAXED);
+		stats->memory[i].evicted_bytes = __atomic_load_n(&stats_memory[i].evicted_bytes, __ATOMIC_RELAXED);
+	}
+}
+
+uint64_t srpo_stats_percentile_get(const srpo_stats_op_t *op, double percentile)
+{
+	uint64_t rank = 0;
+	uint64_t seen = 0;
+
+	if (op->count == 0) {
+		return 0;
+	}
+
+	// the rank of the wanted operation, counting from 1
+	rank = (uint64_t) ((double) op->count * percentile / 100.0);
+	rank = rank == 0 ? 1 : rank > op->count ? op->count : rank;
+
+	// the upper bound of the bucket holding it, no operation took longer than the maximum
+	for (size_t i = 0; i < SRPO_STATS_HISTOGRAM_SIZE; i++) {
+		seen += op->histogram[i];
+		if (seen >= rank) {
+			uint64_t bound = i + 1 < 64 ? (uint64_t) 1 << (i + 1) : UINT64_MAX;
+			return bound < op->max_ns ? bound : op->max_ns;
+		}
+	}
+
+	return op->max_ns;
+}
+
+const char *srpo_stats_op_name_get(srpo_stats_op_e op)
+{
+	switch (op) {
+#define XM(ENUM, NAME) \
+	case ENUM:         \
+		return NAME;
+
+		SRPO_STATS_OP_TABLE
+#undef XM
+
+		default:
+			return "unknown";
+	}
+}
+
+uint64_t srpo_stats_memory_total_get(void)
+{
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < SRPO_STATS_MEMORY_COUNT; i++) {
+		total += __atomic_load_n(&stats_memory[i].bytes, __ATOMIC_RELAXED);
+	}
+
+	return total;
+}
+
+const char *srpo_stats_memory_name_get(srpo_stats_memory_e component)
+{
+	switch (component) {
+#define XM(ENUM, NAME) \
+	case ENUM:         \
+		return NAME;
+
+		SRPO_STATS_MEMORY_TABLE
+#undef XM
+
+		default:
+			return "unknown";
+	}
+}
+
+srpo_ubus_error_e srpo_stats_ubus_object_add(struct ubus_context *ubus_ctx)
+{
+	if (ubus_ctx == NULL) {
+		return SRPO_UBUS_ERR_ARG;
+	}
+
+	return ubus_add_object(ubus_ctx, &stats_ubus_object) == UBUS_STATUS_OK ? SRPO_UBUS_ERR_OK : SRPO_UBUS_ERR_INTERNAL;
+}
+
+srpo_ubus_error_e srpo_stats_ubus_object_remove(struct ubus_context *ubus_ctx)
+{
+	if (ubus_ctx == NULL) {
+		return SRPO_UBUS_ERR_ARG;
+	}
+
+	return ubus_remove_object(ubus_ctx, &stats_ubus_object) == UBUS_STATUS_OK ? SRPO_UBUS_ERR_OK : SRPO_UBUS_ERR_INTERNAL;
+}
+
+uint64_t stats_clock(void)
+{
+	struct timespec now = {0};
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+void stats_record(srpo_stats_op_e op, uint64_t start_ns, int error)
+{
+	srpo_stats_thread_t *thread = stats_thread_get();
+	srpo_stats_op_t *stats_op = &thread->stats.ops[op];
+	uint64_t duration_ns = stats_clock() - start_ns;
+
+	stats_counter_add(&stats_op->count, 1);
+	if (error) {
+		stats_counter_add(&stats_op->errors, 1);
+	}
+	stats_counter_add(&stats_op->total_ns, duration_ns);
+	if (duration_ns > stats_op->max_ns) {
+		__atomic_store_n(&stats_op->max_ns, duration_ns, __ATOMIC_RELAXED);
+	}
+	stats_counter_add(&stats_op->histogram[stats_bucket_get(duration_ns)], 1);
+}
+
+void stats_memory_alloc(srpo_stats_memory_e component, size_t size)
+{
+	srpo_stats_memory_t *memory = &stats_memory[component];
+	uint64_t bytes = __atomic_add_fetch(&memory->bytes, size, __ATOMIC_RELAXED);
+	uint64_t peak_bytes = __atomic_load_n(&memory->peak_bytes, __ATOMIC_RELAXED);
+
+	// several threads can raise the peak at once, the highest one wins
+	while (bytes > peak_bytes && !__atomic_compare_exchange_n(&memory->peak_bytes, &peak_bytes, bytes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+void stats_memory_free(srpo_stats_memory_e component, size_t size)
+{
+	__atomic_sub_fetch(&stats_memory[component].bytes, size, __ATOMIC_RELAXED);
+}
+
+void stats_memory_evict(srpo_stats_memory_e component, size_t size)
+{
+	__atomic_add_fetch(&stats_memory[component].evictions, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats_memory[component].evicted_bytes, size, __ATOMIC_RELAXED);
+}
+
+static void stats_key_create(void)
+{
+	pthread_key_create(&stats_key, stats_thread_exit);
+}
+
+static srpo_stats_thread_t *stats_thread_get(void)
+{
+	// a thread registers its counters with the first operation it records
+	if (stats_thread == NULL) {
+		pthread_once(&stats_key_once, stats_key_create);
+
+		stats_thread = xcalloc(1, sizeof(srpo_stats_thread_t));
+		pthread_setspecific(stats_key, stats_thread);
+
+		pthread_mutex_lock(&stats_lock);
+		stats_thread->next = stats_threads;
+		stats_threads = stats_thread;
+		pthread_mutex_unlock(&stats_lock);
+	}
+
+	return stats_thread;
+}
+
+static void stats_thread_exit(void *arg)
+{
+	srpo_stats_thread_t *thread = arg;
+
+	// the counters of an exiting thread are kept in the totals
+	pthread_mutex_lock(&stats_lock);
+	stats_merge(&stats_exited, &thread->stats);
+	for (srpo_stats_thread_t **iter = &stats_threads; *iter; iter = &(*iter)->next) {
+		if (*iter == thread) {
+			*iter = thread->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stats_lock);
+
+	FREE_SAFE(thread);
+}
+
+static void stats_merge(srpo_stats_t *stats, const srpo_stats_t *thread_stats)
+{
+	for (size_t i = 0; i < SRPO_STATS_OP_COUNT; i++) {
+		srpo_stats_op_t *op = &stats->ops[i];
+		const srpo_stats_op_t *thread_op = &thread_stats->ops[i];
+		uint64_t max_ns = __atomic_load_n(&thread_op->max_ns, __ATOMIC_RELAXED);
+
+		op->count += __atomic_load_n(&thread_op->count, __ATOMIC_RELAXED);
+		op->errors += __atomic_load_n(&thread_op->errors, __ATOMIC_RELAXED);
+		op->total_ns += __atomic_load_n(&thread_op->total_ns, __ATOMIC_RELAXED);
+		op->max_ns = max_ns > op->max_ns ? max_ns : op->max_ns;
+		for (size_t j = 0; j < SRPO_STATS_HISTOGRAM_SIZE; j++) {
+			op->histogram[j] += __atomic_load_n(&thread_op->histogram[j], __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static void stats_counter_add(uint64_t *counter, uint64_t value)
+{
+	// a single writer needs no read-modify-write, the atomic store only keeps the readers from seeing a torn value
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static size_t stats_bucket_get(uint64_t duration_ns)
+{
+	size_t bucket = duration_ns ? (size_t) (63 - __builtin_clzll(duration_ns)) : 0;
+
+	return bucket < SRPO_STATS_HISTOGRAM_SIZE ? bucket : SRPO_STATS_HISTOGRAM_SIZE - 1;
+}
+
+static int stats_ubus_get(struct ubus_context *ctx, struct ubus_object *obj, struct ubus_request_data *req, const char *method, struct blob_attr *msg)
+{
+	struct blob_buf buf = {0};
+	srpo_stats_t stats;
+	void *table = NULL;
+	void *memory_table = NULL;
+
+	srpo_stats_get(&stats);
+
+	blob_buf_init(&buf, 0);
+	for (size_t i = 0; i < SRPO_STATS_OP_COUNT; i++) {
+		const srpo_stats_op_t *op = &stats.ops[i];
+
+		table = blobmsg_open_table(&buf, srpo_stats_op_name_get((srpo_stats_op_e) i));
+		blobmsg_add_u64(&buf, "count", op->count);
+		blobmsg_add_u64(&buf, "errors", op->errors);
+		blobmsg_add_u64(&buf, "total_ns", op->total_ns);
+		blobmsg_add_u64(&buf, "max_ns", op->max_ns);
+		blobmsg_add_u64(&buf, "p50_ns", srpo_stats_percentile_get(op, 50.0));
+		blobmsg_add_u64(&buf, "p99_ns", srpo_stats_percentile_get(op, 99.0));
+		blobmsg_close_table(&buf, table);
+	}
+
+	memory_table = blobmsg_open_table(&buf, "memory");
+	for (size_t i = 0; i < SRPO_STATS_MEMORY_COUNT; i++) {
+		const srpo_stats_memory_t *memory = &stats.memory[i];
+
+		table = blobmsg_open_table(&buf, srpo_stats_memory_name_get((srpo_stats_memory_e) i));
+		blobmsg_add_u64(&buf, "bytes", memory->bytes);
+		blobmsg_add_u64(&buf, "peak_bytes", memory->peak_bytes);
+		blobmsg_add_u64(&buf, "evictions", memory->evictions);
+		blobmsg_add_u64(&buf, "evicted_bytes", memory->evicted_bytes);
+		blobmsg_close_table(&buf, table);
+	}
+	blobmsg_close_table(&buf, memory_table);
+
+	ubus_send_reply(ctx, req, buf.head);
+	blob_buf_free(&buf);
+
+	return UBUS_STATUS_OK;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file srpo_stats.h
+ * @brief srpo_stats - per operation counters and latency histograms of the srpo_ubus and srpo_uci calls.
+ *
+ * @copyright
+ * Copyright (C) 2020 Deutsche Telekom AG.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRPO_STATS_H_ONCE
+#define SRPO_STATS_H_ONCE
+
+#include <stdint.h>
+
+#include "srpo_ubus.h"
+
+// histogram[i] counts the operations that took [2^i, 2^(i+1)) nanoseconds, the last bucket everything longer
+#define SRPO_STATS_HISTOGRAM_SIZE 40
+
+typedef enum {
+#define SRPO_STATS_OP_TABLE                                \
+	XM(SRPO_STATS_UBUS_CONNECT, "ubus_connect")            \
+	XM(SRPO_STATS_UBUS_LOOKUP, "ubus_lookup")              \
+	XM(SRPO_STATS_UBUS_INVOKE, "ubus_invoke")              \
+	XM(SRPO_STATS_UBUS_JSON_FORMAT, "ubus_json_format")    \
+	XM(SRPO_STATS_UBUS_TRANSFORM, "ubus_transform")        \
+	XM(SRPO_STATS_UCI_PARSE, "uci_parse")                  \
+	XM(SRPO_STATS_UCI_PATH_CONVERT, "uci_path_convert")    \
+	XM(SRPO_STATS_UCI_TEMPLATE_SCAN, "uci_template_scan")  \
+	XM(SRPO_STATS_UCI_GET, "uci_get")                      \
+	XM(SRPO_STATS_UCI_SET, "uci_set")                      \
+	XM(SRPO_STATS_UCI_COMMIT, "uci_commit")
+
+#define XM(ENUM, NAME) ENUM,
+	SRPO_STATS_OP_TABLE
+#undef XM
+	SRPO_STATS_OP_COUNT,
+} srpo_stats_op_e;
+
+typedef struct {
+	uint64_t count;
+	uint64_t errors;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t histogram[SRPO_STATS_HISTOGRAM_SIZE];
+} srpo_stats_op_t;
+
+typedef enum {
+#define SRPO_STATS_MEMORY_TABLE                              \
+	XM(SRPO_STATS_MEMORY_UCI_SNAPSHOT, "uci_snapshot")       \
+	XM(SRPO_STATS_MEMORY_UCI_WORKING, "uci_working")         \
+	XM(SRPO_STATS_MEMORY_ARENA, "arena")                     \
+	XM(SRPO_STATS_MEMORY_UBUS_REPLAY, "ubus_replay")
+
+#define XM(ENUM, NAME) ENUM,
+	SRPO_STATS_MEMORY_TABLE
+#undef XM
+	SRPO_STATS_MEMORY_COUNT,
+} srpo_stats_memory_e;
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t peak_bytes;
+	uint64_t evictions;
+	uint64_t evicted_bytes;
+} srpo_stats_memory_t;
+
+typedef struct {
+	srpo_stats_op_t ops[SRPO_STATS_OP_COUNT];
+	srpo_stats_memory_t memory[SRPO_STATS_MEMORY_COUNT];
+} srpo_stats_t;
+
+struct ubus_context;
+
+void srpo_stats_get(srpo_stats_t *stats);
+uint64_t srpo_stats_percentile_get(const srpo_stats_op_t *op, double percentile);
+const char *srpo_stats_op_name_get(srpo_stats_op_e op);
+uint64_t srpo_stats_memory_total_get(void);
+const char *srpo_stats_memory_name_get(srpo_stats_memory_e component);
+
+srpo_ubus_error_e srpo_stats_ubus_object_add(struct ubus_context *ubus_ctx);
+srpo_ubus_error_e srpo_stats_ubus_object_remove(struct ubus_context *ubus_ctx);
+
+#endif /* SRPO_STATS_H_ONCE */
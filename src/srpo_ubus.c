@@ -1,38 +1,127 @@
 #include <libubus.h>
 #include <libubox/blobmsg.h>
 #include <libubox/blobmsg_json.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "srpo_ubus.h"
+#include "utils/log.h"
 #include "utils/memory.h"
+#include "utils/stats.h"
+#include "utils/trace.h"
 
 typedef struct {
 	srpo_ubus_transform_data_cb transform_data_cb;
 	srpo_ubus_result_values_t *values;
+	struct blob_buf *record; // NULL if the call is not recorded
 } srpo_ubus_invoke_wrapper_t;
 
+typedef struct {
+	char *reply; // JSON as passed to the transform callback, NULL if the call had no reply
+	int status;
+	uint64_t duration_ns;
+} srpo_ubus_replay_reply_t;
+
+// all recorded replies of one call, served in the recorded order and from the start again once all were served
+typedef struct {
+	char *lookup_path;
+	char *method;
+	char *args; // normalized JSON of the call arguments, NULL for a call without arguments
+	srpo_ubus_replay_reply_t *replies;
+	size_t replies_size;
+	size_t replies_next;
+} srpo_ubus_replay_call_t;
+
+enum {
+	UBUS_RECORD_PATH,
+	UBUS_RECORD_METHOD,
+	UBUS_RECORD_ARGS,
+	UBUS_RECORD_REPLY,
+	UBUS_RECORD_STATUS,
+	UBUS_RECORD_DURATION,
+	UBUS_RECORD_MAX,
+};
+
+static const struct blobmsg_policy ubus_record_policy[UBUS_RECORD_MAX] = {
+	[UBUS_RECORD_PATH] = {.name = "path", .type = BLOBMSG_TYPE_STRING},
+	[UBUS_RECORD_METHOD] = {.name = "method", .type = BLOBMSG_TYPE_STRING},
+	[UBUS_RECORD_ARGS] = {.name = "args", .type = BLOBMSG_TYPE_TABLE},
+	[UBUS_RECORD_REPLY] = {.name = "reply", .type = BLOBMSG_TYPE_TABLE},
+	// JSON numbers come back as 32 bit integers whenever they fit, see ubus_record_number_get
+	[UBUS_RECORD_STATUS] = {.name = "status", .type = BLOBMSG_TYPE_UNSPEC},
+	[UBUS_RECORD_DURATION] = {.name = "duration_ns", .type = BLOBMSG_TYPE_UNSPEC},
+};
+
+static pthread_mutex_t ubus_socket_path_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *ubus_socket_path = NULL; // NULL connects to the default ubusd socket
+
+// the enabled flags let srpo_ubus_call skip the locks while neither recording nor replaying
+static pthread_mutex_t ubus_record_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *ubus_record_file = NULL;
+static bool ubus_record_enabled = false;
+
+static pthread_mutex_t ubus_replay_lock = PTHREAD_MUTEX_INITIALIZER;
+static srpo_ubus_replay_call_t *ubus_replay_calls = NULL;
+static size_t ubus_replay_calls_size = 0;
+static double ubus_replay_speed = 0;
+static bool ubus_replay_enabled = false;
+
+static struct ubus_context *ubus_socket_connect(void);
 static void ubus_data_cb(struct ubus_request *req, int type, struct blob_attr *msg);
+static void ubus_record_write(const srpo_ubus_call_data_t *call_args, struct blob_buf *record, int status, uint64_t duration_ns);
+static uint64_t ubus_record_number_get(struct blob_attr *attr);
+static char *ubus_json_table_format(const void *data, unsigned int data_size);
+static char *ubus_json_args_format(const char *json_call_arguments);
+static int ubus_replay_load(FILE *record_file, srpo_ubus_replay_call_t **calls, size_t *calls_size);
+static srpo_ubus_replay_call_t *ubus_replay_call_find(srpo_ubus_replay_call_t *calls, size_t calls_size, const char *lookup_path, const char *method, const char *args);
+static size_t ubus_replay_calls_memory_size(const srpo_ubus_replay_call_t *calls, size_t calls_size);
+static void ubus_replay_calls_free(srpo_ubus_replay_call_t *calls, size_t calls_size);
+static srpo_ubus_error_e ubus_replay_call(srpo_ubus_result_values_t *values, srpo_ubus_call_data_t *call_args);
 
 srpo_ubus_error_e srpo_ubus_call(srpo_ubus_result_values_t *values, srpo_ubus_call_data_t *call_args)
 {
 	srpo_ubus_error_e error = SRPO_UBUS_ERR_OK;
 	struct ubus_context *ubus_ctx = NULL;
 	struct blob_buf buf = {0};
+	struct blob_buf record = {0};
 	int ubus_error = UBUS_STATUS_OK;
 	uint32_t id = 0;
 	srpo_ubus_invoke_wrapper_t *ubus_wrapper = &((srpo_ubus_invoke_wrapper_t){.transform_data_cb = call_args->transform_data_cb, .values = values});
+	uint64_t stats_start = 0;
+	uint64_t call_start = 0;
+
+	TRACE3(ubus_call_entry, call_args->lookup_path, call_args->method, call_args->json_call_arguments);
+
+	if (__atomic_load_n(&ubus_replay_enabled, __ATOMIC_ACQUIRE)) {
+		error = ubus_replay_call(values, call_args);
+		TRACE4(ubus_call_return, call_args->lookup_path, call_args->method, error, ubus_error);
+		return error;
+	}
+
+	if (__atomic_load_n(&ubus_record_enabled, __ATOMIC_ACQUIRE)) {
+		blob_buf_init(&record, 0);
+		ubus_wrapper->record = &record;
+		call_start = stats_clock();
+	}
 
-	ubus_ctx = ubus_connect(NULL);
+	stats_start = stats_clock();
+	ubus_ctx = ubus_socket_connect();
+	stats_record(SRPO_STATS_UBUS_CONNECT, stats_start, ubus_ctx == NULL);
 	if (ubus_ctx == NULL) {
-		printf("ubus connect failed\n");
+		SRPO_LOG_ERROR("ubus connect failed");
 		error = SRPO_UBUS_ERR_INTERNAL;
 		goto cleanup;
 	}
 
 	blob_buf_init(&buf, 0);
+	stats_start = stats_clock();
 	ubus_error = ubus_lookup_id(ubus_ctx, call_args->lookup_path, &id);
+	stats_record(SRPO_STATS_UBUS_LOOKUP, stats_start, ubus_error);
 	if (ubus_error != UBUS_STATUS_OK) {
-		printf("ubus lookup id failed %d\n", ubus_error == UBUS_STATUS_NOT_FOUND);
+		SRPO_LOG_ERROR("ubus lookup of %s failed: %s", call_args->lookup_path, ubus_strerror(ubus_error));
 		error = SRPO_UBUS_ERR_INTERNAL;
 		goto cleanup;
 	}
@@ -41,25 +130,157 @@ srpo_ubus_error_e srpo_ubus_call(srpo_ubus_result_values_t *values, srpo_ubus_ca
 		blobmsg_add_json_from_string(&buf, call_args->json_call_arguments);
 	}
 
-	if (call_args->transform_data_cb == NULL) {
+	// the invoke includes the reply callback, the JSON formatting and the transform are also counted on their own
+	stats_start = stats_clock();
+	if (call_args->transform_data_cb == NULL && ubus_wrapper->record == NULL) {
 		ubus_error = ubus_invoke(ubus_ctx, id, call_args->method, buf.head, NULL, ubus_wrapper, call_args->timeout);
 	} else {
 		ubus_error = ubus_invoke(ubus_ctx, id, call_args->method, buf.head, ubus_data_cb, ubus_wrapper, call_args->timeout);
 	}
+	stats_record(SRPO_STATS_UBUS_INVOKE, stats_start, ubus_error);
 	if (ubus_error != UBUS_STATUS_OK) {
-		printf("ubus invoke failed\n");
+		SRPO_LOG_ERROR("ubus invoke of %s %s failed: %s", call_args->lookup_path, call_args->method, ubus_strerror(ubus_error));
 		error = SRPO_UBUS_ERR_INTERNAL;
 		goto cleanup;
 	}
 
 cleanup:
 	if (ubus_ctx != NULL) {
+		// failed lookups and invokes are recorded too, replaying them fails the same way
+		if (ubus_wrapper->record) {
+			ubus_record_write(call_args, &record, ubus_error, stats_clock() - call_start);
+		}
 		ubus_free(ubus_ctx);
 		blob_buf_free(&buf);
 	}
+	if (ubus_wrapper->record) {
+		blob_buf_free(&record);
+	}
+	TRACE4(ubus_call_return, call_args->lookup_path, call_args->method, error, ubus_error);
 	return error;
 }
 
+srpo_ubus_error_e srpo_ubus_socket_path_set(const char *socket_path)
+{
+	char *socket_path_old = NULL;
+
+	if (socket_path && socket_path[0] == '\0') {
+		return SRPO_UBUS_ERR_ARG;
+	}
+
+	pthread_mutex_lock(&ubus_socket_path_lock);
+	socket_path_old = ubus_socket_path;
+	ubus_socket_path = socket_path ? xstrdup(socket_path) : NULL;
+	pthread_mutex_unlock(&ubus_socket_path_lock);
+
+	FREE_SAFE(socket_path_old);
+
+	return SRPO_UBUS_ERR_OK;
+}
+
+srpo_ubus_error_e srpo_ubus_record_start(const char *record_path)
+{
+	FILE *record_file = NULL;
+	FILE *record_file_old = NULL;
+
+	if (record_path == NULL) {
+		return SRPO_UBUS_ERR_ARG;
+	}
+
+	record_file = fopen(record_path, "a");
+	if (record_file == NULL) {
+		return SRPO_UBUS_ERR_INTERNAL;
+	}
+
+	pthread_mutex_lock(&ubus_record_lock);
+	record_file_old = ubus_record_file;
+	ubus_record_file = record_file;
+	__atomic_store_n(&ubus_record_enabled, true, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ubus_record_lock);
+
+	if (record_file_old) {
+		fclose(record_file_old);
+	}
+
+	return SRPO_UBUS_ERR_OK;
+}
+
+srpo_ubus_error_e srpo_ubus_record_stop(void)
+{
+	FILE *record_file = NULL;
+
+	pthread_mutex_lock(&ubus_record_lock);
+	record_file = ubus_record_file;
+	ubus_record_file = NULL;
+	__atomic_store_n(&ubus_record_enabled, false, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ubus_record_lock);
+
+	if (record_file && fclose(record_file) != 0) {
+		return SRPO_UBUS_ERR_INTERNAL;
+	}
+
+	return SRPO_UBUS_ERR_OK;
+}
+
+srpo_ubus_error_e srpo_ubus_replay_start(const char *record_path, double speed)
+{
+	srpo_ubus_error_e error = SRPO_UBUS_ERR_OK;
+	FILE *record_file = NULL;
+	srpo_ubus_replay_call_t *calls = NULL;
+	size_t calls_size = 0;
+	srpo_ubus_replay_call_t *calls_old = NULL;
+	size_t calls_old_size = 0;
+
+	if (record_path == NULL || speed < 0) {
+		return SRPO_UBUS_ERR_ARG;
+	}
+
+	record_file = fopen(record_path, "r");
+	if (record_file == NULL) {
+		return SRPO_UBUS_ERR_INTERNAL;
+	}
+
+	error = ubus_replay_load(record_file, &calls, &calls_size);
+	fclose(record_file);
+	if (error) {
+		return error;
+	}
+	stats_memory_alloc(SRPO_STATS_MEMORY_UBUS_REPLAY, ubus_replay_calls_memory_size(calls, calls_size));
+
+	pthread_mutex_lock(&ubus_replay_lock);
+	calls_old = ubus_replay_calls;
+	calls_old_size = ubus_replay_calls_size;
+	ubus_replay_calls = calls;
+	ubus_replay_calls_size = calls_size;
+	ubus_replay_speed = speed;
+	__atomic_store_n(&ubus_replay_enabled, true, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ubus_replay_lock);
+
+	stats_memory_free(SRPO_STATS_MEMORY_UBUS_REPLAY, ubus_replay_calls_memory_size(calls_old, calls_old_size));
+	ubus_replay_calls_free(calls_old, calls_old_size);
+
+	return SRPO_UBUS_ERR_OK;
+}
+
+srpo_ubus_error_e srpo_ubus_replay_stop(void)
+{
+	srpo_ubus_replay_call_t *calls = NULL;
+	size_t calls_size = 0;
+
+	pthread_mutex_lock(&ubus_replay_lock);
+	calls = ubus_replay_calls;
+	calls_size = ubus_replay_calls_size;
+	ubus_replay_calls = NULL;
+	ubus_replay_calls_size = 0;
+	__atomic_store_n(&ubus_replay_enabled, false, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ubus_replay_lock);
+
+	stats_memory_free(SRPO_STATS_MEMORY_UBUS_REPLAY, ubus_replay_calls_memory_size(calls, calls_size));
+	ubus_replay_calls_free(calls, calls_size);
+
+	return SRPO_UBUS_ERR_OK;
+}
+
 const char *srpo_ubus_error_description_get(srpo_ubus_error_e error)
 {
 	switch (error) {
@@ -74,18 +295,55 @@ const char *srpo_ubus_error_description_get(srpo_ubus_error_e error)
 	}
 }
 
+static struct ubus_context *ubus_socket_connect(void)
+{
+	struct ubus_context *ubus_ctx = NULL;
+	char *socket_path = NULL;
+
+	// the path is copied so a concurrent srpo_ubus_socket_path_set can't free it during the connect
+	pthread_mutex_lock(&ubus_socket_path_lock);
+	if (ubus_socket_path) {
+		socket_path = xstrdup(ubus_socket_path);
+	}
+	pthread_mutex_unlock(&ubus_socket_path_lock);
+
+	ubus_ctx = ubus_connect(socket_path);
+	FREE_SAFE(socket_path);
+
+	return ubus_ctx;
+}
+
 static void ubus_data_cb(struct ubus_request *req, int type, struct blob_attr *msg)
 {
 	char *json_result = NULL;
 	srpo_ubus_invoke_wrapper_t *private_data = req->priv;
+	uint64_t stats_start = 0;
+
+	TRACE2(ubus_data_cb_entry, type, msg ? blob_len(msg) : 0);
 
 	if (msg == NULL) {
 		return;
 	}
 
+	if (private_data->record) {
+		blobmsg_add_field(private_data->record, BLOBMSG_TYPE_TABLE, "reply", blob_data(msg), (unsigned int) blob_len(msg));
+	}
+
+	// a call that is only recorded has no transform to format the reply for
+	if (private_data->transform_data_cb == NULL) {
+		return;
+	}
+
+	stats_start = stats_clock();
 	json_result = blobmsg_format_json(msg, true);
+	stats_record(SRPO_STATS_UBUS_JSON_FORMAT, stats_start, json_result == NULL);
+
+	stats_start = stats_clock();
 	private_data->transform_data_cb(json_result, private_data->values);
-	FREE_SAFE(json_result);
+	stats_record(SRPO_STATS_UBUS_TRANSFORM, stats_start, 0);
+	TRACE2(ubus_data_cb_return, json_result, private_data->values ? private_data->values->num_values : 0);
+	// formatted by libubox with the libc allocator
+	free(json_result);
 
 	return;
 }
@@ -133,3 +391,258 @@ void srpo_ubus_free_result_values(srpo_ubus_result_values_t *values)
 	FREE_SAFE(values->values);
 	FREE_SAFE(values);
 }
+
+static void ubus_record_write(const srpo_ubus_call_data_t *call_args, struct blob_buf *record, int status, uint64_t duration_ns)
+{
+	void *args = NULL;
+	char *line = NULL;
+
+	// the reply table was added by the data callback, the rest of the call is added here
+	blobmsg_add_string(record, "path", call_args->lookup_path);
+	blobmsg_add_string(record, "method", call_args->method);
+	if (call_args->json_call_arguments) {
+		args = blobmsg_open_table(record, "args");
+		blobmsg_add_json_from_string(record, call_args->json_call_arguments);
+		blobmsg_close_table(record, args);
+	}
+	blobmsg_add_u32(record, "status", (uint32_t) status);
+	blobmsg_add_u64(record, "duration_ns", duration_ns);
+
+	line = blobmsg_format_json(record->head, true);
+	if (line == NULL) {
+		return;
+	}
+
+	// one call per line, calls finishing at the same time are never interleaved
+	pthread_mutex_lock(&ubus_record_lock);
+	if (ubus_record_file) {
+		fprintf(ubus_record_file, "%s\n", line);
+		fflush(ubus_record_file);
+	}
+	pthread_mutex_unlock(&ubus_record_lock);
+
+	free(line);
+}
+
+static uint64_t ubus_record_number_get(struct blob_attr *attr)
+{
+	if (attr == NULL) {
+		return 0;
+	}
+
+	switch (blobmsg_type(attr)) {
+		case BLOBMSG_TYPE_INT64:
+			return blobmsg_get_u64(attr);
+		case BLOBMSG_TYPE_INT32:
+			return blobmsg_get_u32(attr);
+		default:
+			return 0;
+	}
+}
+
+static char *ubus_json_table_format(const void *data, unsigned int data_size)
+{
+	struct blob_buf buf = {0};
+	char *json_libc = NULL;
+	char *json = NULL;
+
+	// the table members are copied under a root attribute, the same shape ubus hands to the data callback
+	blob_buf_init(&buf, 0);
+	blob_put_raw(&buf, data, data_size);
+	json_libc = blobmsg_format_json(buf.head, true);
+	blob_buf_free(&buf);
+
+	// the replay table is freed with the library allocator
+	json = json_libc ? xstrdup(json_libc) : NULL;
+	free(json_libc);
+
+	return json;
+}
+
+static char *ubus_json_args_format(const char *json_call_arguments)
+{
+	struct blob_buf buf = {0};
+	char *json_libc = NULL;
+	char *json = NULL;
+
+	if (json_call_arguments == NULL) {
+		return NULL;
+	}
+
+	// the arguments go through blobmsg like in the recording so whitespace and number formats don't matter
+	blob_buf_init(&buf, 0);
+	if (blobmsg_add_json_from_string(&buf, json_call_arguments)) {
+		json_libc = blobmsg_format_json(buf.head, true);
+	}
+	blob_buf_free(&buf);
+
+	json = json_libc ? xstrdup(json_libc) : NULL;
+	free(json_libc);
+
+	return json;
+}
+
+static int ubus_replay_load(FILE *record_file, srpo_ubus_replay_call_t **calls, size_t *calls_size)
+{
+	srpo_ubus_error_e error = SRPO_UBUS_ERR_OK;
+	struct blob_buf buf = {0};
+	struct blob_attr *tb[UBUS_RECORD_MAX] = {0};
+	char *line = NULL;
+	size_t line_size = 0;
+	char *args = NULL;
+	srpo_ubus_replay_call_t *call = NULL;
+	srpo_ubus_replay_reply_t *reply = NULL;
+
+	*calls = NULL;
+	*calls_size = 0;
+
+	while (getline(&line, &line_size, record_file) != -1) {
+		if (line[0] == '\n' || line[0] == '\0') {
+			continue;
+		}
+
+		blob_buf_init(&buf, 0);
+		if (!blobmsg_add_json_from_string(&buf, line)) {
+			SRPO_LOG_ERROR("ubus replay record is not valid JSON: %.*s", (int) strcspn(line, "\n"), line);
+			error = SRPO_UBUS_ERR_ARG;
+			goto out;
+		}
+
+		blobmsg_parse(ubus_record_policy, UBUS_RECORD_MAX, tb, blob_data(buf.head), (unsigned int) blob_len(buf.head));
+		if (tb[UBUS_RECORD_PATH] == NULL || tb[UBUS_RECORD_METHOD] == NULL) {
+			SRPO_LOG_ERROR("ubus replay record has no path or method: %.*s", (int) strcspn(line, "\n"), line);
+			error = SRPO_UBUS_ERR_ARG;
+			goto out;
+		}
+
+		args = tb[UBUS_RECORD_ARGS] ? ubus_json_table_format(blobmsg_data(tb[UBUS_RECORD_ARGS]), (unsigned int) blobmsg_data_len(tb[UBUS_RECORD_ARGS])) : NULL;
+
+		call = ubus_replay_call_find(*calls, *calls_size, blobmsg_get_string(tb[UBUS_RECORD_PATH]), blobmsg_get_string(tb[UBUS_RECORD_METHOD]), args);
+		if (call == NULL) {
+			*calls = xrealloc(*calls, sizeof(srpo_ubus_replay_call_t) * (*calls_size + 1));
+			call = &(*calls)[(*calls_size)++];
+			*call = (srpo_ubus_replay_call_t){
+				.lookup_path = xstrdup(blobmsg_get_string(tb[UBUS_RECORD_PATH])),
+				.method = xstrdup(blobmsg_get_string(tb[UBUS_RECORD_METHOD])),
+				.args = args,
+			};
+			args = NULL;
+		}
+		FREE_SAFE(args);
+
+		call->replies = xrealloc(call->replies, sizeof(srpo_ubus_replay_reply_t) * (call->replies_size + 1));
+		reply = &call->replies[call->replies_size++];
+		reply->reply = tb[UBUS_RECORD_REPLY] ? ubus_json_table_format(blobmsg_data(tb[UBUS_RECORD_REPLY]), (unsigned int) blobmsg_data_len(tb[UBUS_RECORD_REPLY])) : NULL;
+		reply->status = (int) ubus_record_number_get(tb[UBUS_RECORD_STATUS]);
+		reply->duration_ns = ubus_record_number_get(tb[UBUS_RECORD_DURATION]);
+	}
+
+out:
+	if (error) {
+		ubus_replay_calls_free(*calls, *calls_size);
+		*calls = NULL;
+		*calls_size = 0;
+	}
+	blob_buf_free(&buf);
+	// getline buffer
+	free(line);
+
+	return error;
+}
+
+static srpo_ubus_replay_call_t *ubus_replay_call_find(srpo_ubus_replay_call_t *calls, size_t calls_size, const char *lookup_path, const char *method, const char *args)
+{
+	for (size_t i = 0; i < calls_size; i++) {
+		if (strcmp(calls[i].lookup_path, lookup_path) != 0 || strcmp(calls[i].method, method) != 0) {
+			continue;
+		}
+
+		if ((calls[i].args == NULL && args == NULL) || (calls[i].args && args && strcmp(calls[i].args, args) == 0)) {
+			return &calls[i];
+		}
+	}
+
+	return NULL;
+}
+
+static size_t ubus_replay_calls_memory_size(const srpo_ubus_replay_call_t *calls, size_t calls_size)
+{
+	size_t size = calls_size * sizeof(srpo_ubus_replay_call_t);
+
+	for (size_t i = 0; i < calls_size; i++) {
+		size += strlen(calls[i].lookup_path) + 1 + strlen(calls[i].method) + 1 + (calls[i].args ? strlen(calls[i].args) + 1 : 0);
+		size += calls[i].replies_size * sizeof(srpo_ubus_replay_reply_t);
+		for (size_t j = 0; j < calls[i].replies_size; j++) {
+			size += calls[i].replies[j].reply ? strlen(calls[i].replies[j].reply) + 1 : 0;
+		}
+	}
+
+	return size;
+}
+
+static void ubus_replay_calls_free(srpo_ubus_replay_call_t *calls, size_t calls_size)
+{
+	for (size_t i = 0; i < calls_size; i++) {
+		for (size_t j = 0; j < calls[i].replies_size; j++) {
+			FREE_SAFE(calls[i].replies[j].reply);
+		}
+		FREE_SAFE(calls[i].replies);
+		FREE_SAFE(calls[i].lookup_path);
+		FREE_SAFE(calls[i].method);
+		FREE_SAFE(calls[i].args);
+	}
+
+	FREE_SAFE(calls);
+}
+
+static srpo_ubus_error_e ubus_replay_call(srpo_ubus_result_values_t *values, srpo_ubus_call_data_t *call_args)
+{
+	srpo_ubus_replay_call_t *call = NULL;
+	srpo_ubus_replay_reply_t *reply = NULL;
+	char *args = ubus_json_args_format(call_args->json_call_arguments);
+	char *reply_json = NULL;
+	int status = UBUS_STATUS_OK;
+	uint64_t delay_ns = 0;
+	uint64_t stats_start = 0;
+	struct timespec delay = {0};
+
+	pthread_mutex_lock(&ubus_replay_lock);
+	call = ubus_replay_call_find(ubus_replay_calls, ubus_replay_calls_size, call_args->lookup_path, call_args->method, args);
+	if (call) {
+		reply = &call->replies[call->replies_next];
+		call->replies_next = (call->replies_next + 1) % call->replies_size;
+
+		reply_json = reply->reply ? xstrdup(reply->reply) : NULL;
+		status = reply->status;
+		delay_ns = ubus_replay_speed > 0 ? (uint64_t) ((double) reply->duration_ns / ubus_replay_speed) : 0;
+	}
+	pthread_mutex_unlock(&ubus_replay_lock);
+	FREE_SAFE(args);
+
+	if (call == NULL) {
+		SRPO_LOG_ERROR("ubus replay has no record of %s %s", call_args->lookup_path, call_args->method);
+		return SRPO_UBUS_ERR_INTERNAL;
+	}
+
+	if (delay_ns) {
+		delay.tv_sec = (time_t) (delay_ns / 1000000000u);
+		delay.tv_nsec = (long) (delay_ns % 1000000000u);
+		while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+		}
+	}
+
+	if (status != UBUS_STATUS_OK) {
+		SRPO_LOG_ERROR("ubus replay of %s %s failed: %s", call_args->lookup_path, call_args->method, ubus_strerror(status));
+		FREE_SAFE(reply_json);
+		return SRPO_UBUS_ERR_INTERNAL;
+	}
+
+	if (call_args->transform_data_cb && reply_json) {
+		stats_start = stats_clock();
+		call_args->transform_data_cb(reply_json, values);
+		stats_record(SRPO_STATS_UBUS_TRANSFORM, stats_start, 0);
+	}
+	FREE_SAFE(reply_json);
+
+	return SRPO_UBUS_ERR_OK;
+}
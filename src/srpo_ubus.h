@@ -56,6 +56,11 @@ typedef struct {
 } srpo_ubus_call_data_t;
 
 srpo_ubus_error_e srpo_ubus_call(srpo_ubus_result_values_t *values, srpo_ubus_call_data_t *transform);
+srpo_ubus_error_e srpo_ubus_socket_path_set(const char *socket_path);
+srpo_ubus_error_e srpo_ubus_record_start(const char *record_path);
+srpo_ubus_error_e srpo_ubus_record_stop(void);
+srpo_ubus_error_e srpo_ubus_replay_start(const char *record_path, double speed);
+srpo_ubus_error_e srpo_ubus_replay_stop(void);
 
 void srpo_ubus_init_result_values(srpo_ubus_result_values_t **values);
 srpo_ubus_error_e srpo_ubus_result_values_add(srpo_ubus_result_values_t *values, const char *value, size_t value_size, const char *xpath_template, size_t xpath_template_size, const char *xpath_value, size_t xpath_value_size);
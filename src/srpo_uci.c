@@ -1,35 +1,167 @@
 #include <stdio.h>
+#include <errno.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 
 #include <libuci2.h>
-#include <sysrepo/xpath.h>
+#include <libyang/libyang.h>
+#include <sysrepo.h>
 
 #include "srpo_uci.h"
+#include "srpo_ubus.h"
+#include "utils/log.h"
 #include "utils/memory.h"
+#include "utils/stats.h"
+#include "utils/trace.h"
+#include "utils/arena.h"
+#include "utils/hash.h"
+#include "utils/hash_table.h"
+#include "utils/str_set.h"
+#include "utils/uci_index.h"
+#include "utils/uci_sections.h"
+#include "utils/uci_diff.h"
 
 #ifndef SRPO_UCI_CONFIG_DIR
 #define SRPO_UCI_CONFIG_DIR "/etc/config"
 #endif
 
+#ifndef SRPO_UCI_CACHE_DIR
+#define SRPO_UCI_CACHE_DIR ""
+#endif
+
+#define SRPO_UCI_CACHE_SUFFIX ".idx"
+
+#define SRPO_UCI_ARENA_CHUNK_SIZE 4096
+
+#define SRPO_UCI_XPATH_TOKENS_MAX 64
+
+#define SRPO_UCI_RELOAD_TIMEOUT 10000
+
 #define UCI2_IS_ANYNYMOUS_SECTION(node) (uci2_nc((node)) && (node)->ch[0]->nt != UCI2_NT_SECTION_NAME)
 
 typedef struct srpo_uci_ctx srpo_uci_ctx_t;
+typedef struct srpo_uci_package srpo_uci_package_t;
+typedef struct srpo_uci_snapshot srpo_uci_snapshot_t;
+typedef struct srpo_uci_preload_job srpo_uci_preload_job_t;
 typedef struct srpo_uci_path srpo_uci_path_t;
 typedef struct srpo_path_list srpo_path_list_t;
+typedef struct srpo_uci_ucipath_list_ctx srpo_uci_ucipath_list_ctx_t;
+typedef struct srpo_path_buffer srpo_path_buffer_t;
+typedef struct srpo_uci_export_ctx srpo_uci_export_ctx_t;
+typedef struct srpo_uci_subtree_ctx srpo_uci_subtree_ctx_t;
+typedef struct srpo_uci_subtree_section srpo_uci_subtree_section_t;
+typedef struct srpo_uci_arena_pin srpo_uci_arena_pin_t;
+typedef struct srpo_uci_diff_ctx srpo_uci_diff_ctx_t;
+typedef struct srpo_uci_watch_diff_ctx srpo_uci_watch_diff_ctx_t;
+typedef struct srpo_uci_reload_request srpo_uci_reload_request_t;
+
+typedef int (*ucipath_node_cb)(const char *ucipath, const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, void *private_data);
+typedef struct srpo_uci_journal srpo_uci_journal_t;
+typedef struct srpo_uci_journal_entry srpo_uci_journal_entry_t;
+
+typedef enum {
+	SRPO_UCI_JOURNAL_NODE_ADD = 0,
+	SRPO_UCI_JOURNAL_NODE_DELETE,
+	SRPO_UCI_JOURNAL_VALUE_CHANGE,
+} srpo_uci_journal_op_t;
+
+typedef enum {
+	SRPO_UCI_LIST_UPDATE_REPLACE = 0,
+	SRPO_UCI_LIST_UPDATE_ADD,
+	SRPO_UCI_LIST_UPDATE_REMOVE,
+} srpo_uci_list_update_t;
+
+// libuci2 only detaches deleted nodes from their parent (see uci_get_last_type),
+// the node memory stays owned by the parser context until it is freed, so every
+// edit can be undone by re-attaching, detaching or restoring the old value
+struct srpo_uci_journal_entry {
+	srpo_uci_journal_op_t op;
+	uci2_n_t *node;
+	uci2_n_t *parent;
+	char *old_value;
+};
 
-struct srpo_uci_ctx {
-	uci2_parser_ctx_t *parser_ctx;
+struct srpo_uci_journal {
+	srpo_uci_journal_entry_t *entries;
+	size_t size;
+	size_t capacity;
+};
+
+// one parsed version of a package, never modified once published so readers can use it without locking
+struct srpo_uci_snapshot {
+	const char *name;
+	uci_index_t index;
+	uci_sections_t sections; // the index sections by type and position
+	hash_table_t names;      // the named index sections by name, a name given twice finds its first section
+	size_t memory_size;
+	unsigned int refcount;
+};
 
-	const char *config_dir;
-	char *current_file;
+struct srpo_uci_package {
+	char *name;
 	char config_path[PATH_MAX];
+	char cache_path[PATH_MAX]; // empty if the index is not cached
+
+	// last committed version, readers pin it with a reference while snapshot_lock is held for the pointer swap only
+	srpo_uci_snapshot_t *published;
+	pthread_mutex_t snapshot_lock;
+
+	// version the last diff was computed against, also guarded by snapshot_lock, a commit holds diff_lock from writing
+	// the file until the diff base is moved past its write and diffs run one at a time under diff_run_lock
+	srpo_uci_snapshot_t *diff_base;
+	pthread_mutex_t diff_lock;
+	pthread_mutex_t diff_run_lock;
+
+	// libuci2 tree the writers edit, readers never see it before it is committed
+	uci2_parser_ctx_t *working;
+	uci_file_id_t working_file_id;
+	srpo_uci_journal_t journal;
+	pthread_mutex_t write_lock;
+
+	// section nodes of the working tree by type and position, kept up to date by the section edits
+	// and rebuilt after a reparse or a revert
+	uci_sections_t sections;
+	bool sections_valid;
+	size_t working_memory_size; // estimate of the libuci2 tree as of its last parse or commit, read without write_lock
+
+	// eviction picks the package with the oldest use, the diff base of a package that is diffed is never evicted
+	uint64_t last_used;
+	bool diffed;
+
+	srpo_uci_package_t *next;
+};
+
+struct srpo_uci_ctx {
+	char *config_dir;
+	char *cache_dir;
+	srpo_uci_package_t *packages;
+	pthread_mutex_t packages_lock;
+	size_t memory_budget; // 0 for no limit
+	uint64_t use_clock;
+};
+
+struct srpo_uci_preload_job {
+	srpo_uci_package_t **packages;
+	int *errors;
+	size_t size;
+	size_t next;
 };
 
 struct srpo_uci_path {
 	char *package;
 	char *section;
+	char *section_type; // set for @type[n] paths only
+	long section_position;
 	char *option;
 	char *value;
 };
@@ -37,18 +169,134 @@ struct srpo_uci_path {
 struct srpo_path_list {
 	char **data;
 	size_t size;
+	size_t capacity;
+};
+
+struct srpo_uci_ucipath_list_ctx {
+	const char **uci_section_list;
+	size_t uci_section_list_size;
+	srpo_path_list_t *type_lists; // one list per requested section type
+};
+
+struct srpo_path_buffer {
+	char *data;
+	size_t size;
+};
+
+struct srpo_uci_arena_pin {
+	srpo_uci_snapshot_t *snapshot;
+	srpo_uci_arena_pin_t *next;
+};
+
+struct srpo_uci_arena {
+	arena_t arena;
+	srpo_uci_arena_pin_t *pins; // snapshots the borrowed values point into
+};
+
+struct srpo_uci_export_ctx {
+	const struct ly_ctx *ly_ctx;
+	struct lyd_node *tree;
+	srpo_uci_xpath_uci_template_map_t *template_map;
+	size_t template_map_size;
+	void *private_data;
+};
+
+struct srpo_uci_subtree_section {
+	size_t snapshot; // position in the snapshot list of the subtree context
+	size_t section; // position in the snapshot index
+};
+
+struct srpo_uci_subtree_ctx {
+	srpo_uci_export_ctx_t export_ctx; // the template map only holds the entries at or below the request
+	const srpo_uci_xpath_token_t *request;
+	size_t request_size;
+	srpo_uci_snapshot_t **snapshots;
+	size_t snapshots_size;
+	srpo_uci_subtree_section_t *sections;
+	size_t sections_size;
+};
+
+struct srpo_uci_diff_ctx {
+	const char *uci_config;
+	srpo_path_buffer_t buffer;
+	srpo_uci_diff_cb diff_cb;
+	int (*finish_cb)(void *private_data); // called after the last change, the diff base only moves on if it succeeds
+	void *private_data;
+	bool list; // the change being reported is a single list item
+};
+
+struct srpo_uci_watch {
+	srpo_uci_ctx_t *ctx;
+	sr_session_ctx_t *session;
+	srpo_uci_watch_config_t *config_list;
+	size_t config_list_size;
+	bool *pending;
+	unsigned int debounce_ms;
+	int inotify_fd;
+	int stop_pipe[2];
+	pthread_t thread;
+};
+
+struct srpo_uci_watch_diff_ctx {
+	srpo_uci_watch_t *watch;
+	const srpo_uci_watch_config_t *config;
+	const srpo_uci_diff_ctx_t *diff_ctx;
+	size_t edit_count;
+};
+
+struct srpo_uci_reload_request {
+	char *uci_config;
+	srpo_uci_reload_cb reload_cb;
+	void *private_data;
+	size_t service; // position in the service list of the reload the request is merged into
+	srpo_uci_reload_request_t *next;
+};
+
+struct srpo_uci_reload {
+	srpo_uci_ctx_t *ctx;
+	srpo_uci_reload_config_t *config_list;
+	size_t config_list_size;
+	unsigned int debounce_ms;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	srpo_uci_reload_request_t *requests; // commits waiting for their reload, in commit order
+	srpo_uci_reload_request_t **requests_tail;
+	struct timespec deadline; // the window is opened by the first waiting commit
+	bool stop;
+	bool thread_started;
+	pthread_t thread;
 };
 
 static srpo_uci_ctx_t *uci_context = NULL;
 
 // helper functions
-int ucipath_add_to_list(const char *uci_config, uci2_n_t *node_type, uci2_n_t *node_sec, bool anonym_sec, srpo_path_list_t *path_list);
+static size_t ucipath_section_format(srpo_path_buffer_t *buffer, const char *uci_config, const uci_index_section_t *section);
+static int ucipath_section_emit(const char *uci_config, const uci_index_t *index, const uci_index_section_t *section, srpo_path_buffer_t *buffer, ucipath_node_cb node_cb, void *private_data);
+static int ucipath_walk(srpo_uci_snapshot_t *snapshot, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, ucipath_node_cb node_cb, void *private_data);
+static bool xpath_token_name_equal(const srpo_uci_xpath_token_t *a, const srpo_uci_xpath_token_t *b);
+static bool xpath_token_value_equal(const srpo_uci_xpath_token_t *a, const srpo_uci_xpath_token_t *b);
+static bool xpath_token_placeholder(const srpo_uci_xpath_token_t *token);
+static bool subtree_xpath_match(const srpo_uci_xpath_token_t *request, size_t request_size, const char *xpath, bool template, const srpo_uci_xpath_token_t **pinned);
+static int subtree_sections_collect(srpo_uci_ctx_t *ctx, srpo_uci_subtree_ctx_t *subtree_ctx, const srpo_uci_xpath_uci_template_map_t *entry, const srpo_uci_xpath_token_t *pinned);
+static srpo_uci_snapshot_t *subtree_snapshot_get(srpo_uci_ctx_t *ctx, srpo_uci_subtree_ctx_t *subtree_ctx, const char *uci_config, size_t *position, int *error);
+static void subtree_section_add(srpo_uci_subtree_ctx_t *subtree_ctx, size_t snapshot, const uci_index_t *index, const uci_index_section_t *section);
+static int subtree_section_compare(const void *a, const void *b);
+static srpo_uci_xpath_uci_template_map_t *template_map_ucipath_entry_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, char **xpath, int *error);
+static bool section_list_contains(const char **uci_section_list, size_t uci_section_list_size, const char *section_type);
 static char *path_from_template_get(const char *template, const char *data);
+static bool path_template_match(const char *target, const char *template, const char *data, size_t data_size);
+static const char *xpath_blank_skip(const char *ptr);
+static void xpath_token_add(srpo_uci_xpath_token_t *token_list, size_t token_list_size, size_t *count, const srpo_uci_xpath_token_t *token);
+static int template_index_convert(const char *path, const srpo_uci_template_index_t *index, srpo_uci_path_direction_t direction, srpo_uci_xpath_uci_template_map_t **entry, char **converted);
+static size_t template_index_find(const srpo_uci_template_index_t *index, srpo_uci_path_direction_t direction, const char *path, size_t key_start, size_t key_end, bool keyed);
+static bool template_key_find(const char *path, srpo_uci_path_direction_t direction, size_t *key_start, size_t *key_end);
+static uint32_t template_hash(uint32_t seed, const char *path, size_t key_start, size_t key_end, bool keyed);
 static uci2_n_t *uci_get_last_type(uci2_n_t *cfg, const char *type_name);
+static uci2_n_t *uci_node_child_get(uci2_n_t *node, const char *name);
 
 // path functions
 static void uci_path_init(srpo_uci_path_t *path);
-static void uci_path_print(srpo_uci_path_t *path);
+static void uci_path_print(const char *ucipath, const srpo_uci_path_t *path);
 static int uci_path_parse(srpo_uci_path_t *path, const char *ucipath);
 static void uci_path_free(srpo_uci_path_t *path);
 
@@ -57,15 +305,78 @@ static void srpo_path_list_init(srpo_path_list_t *ls);
 static void srpo_path_list_append(srpo_path_list_t *ls, char *path);
 static void srpo_path_list_free(srpo_path_list_t *ls);
 
+// path buffer functions
+static void path_buffer_init(srpo_path_buffer_t *buffer);
+static size_t path_buffer_format(srpo_path_buffer_t *buffer, size_t offset, const char *format, ...) __attribute__((format(printf, 3, 4)));
+static void path_buffer_free(srpo_path_buffer_t *buffer);
+
+// journal functions
+static void uci_journal_init(srpo_uci_journal_t *journal);
+static void uci_journal_append(srpo_uci_journal_t *journal, srpo_uci_journal_op_t op, uci2_n_t *node, uci2_n_t *parent, const char *old_value);
+static void uci_journal_rollback(srpo_uci_journal_t *journal, size_t savepoint);
+static void uci_journal_free(srpo_uci_journal_t *journal);
+
+// snapshot functions
+static srpo_uci_snapshot_t *uci_snapshot_load(srpo_uci_package_t *package, int *error);
+static srpo_uci_snapshot_t *uci_snapshot_get(srpo_uci_snapshot_t *snapshot);
+static void uci_snapshot_put(srpo_uci_snapshot_t *snapshot);
+static const uci_index_section_t *uci_snapshot_section_find(srpo_uci_snapshot_t *snapshot, const srpo_uci_path_t *path);
+static const uci_index_section_t *uci_snapshot_named_section_get(srpo_uci_snapshot_t *snapshot, const char *name);
+static uint32_t uci_snapshot_name_hash(const void *section);
+static bool uci_snapshot_name_equal(const void *a, const void *b);
+
+// package functions
+static srpo_uci_package_t *uci_package_alloc(const char *config_dir, const char *cache_dir, const char *config, int *error);
+static int uci_package_parse(srpo_uci_package_t *package, bool diff_rebase);
+static int uci_package_working_parse(srpo_uci_package_t *package);
+static bool uci_package_file_changed(srpo_uci_package_t *package, const uci_file_id_t *file_id);
+static void uci_package_sections_build(srpo_uci_package_t *package);
+static uci2_n_t *uci_package_node_get(srpo_uci_package_t *package, const srpo_uci_path_t *path, const char *option, const char *value);
+static void uci_package_working_account(srpo_uci_package_t *package);
+static size_t uci_package_memory_size(srpo_uci_package_t *package);
+static size_t uci_package_evict(srpo_uci_package_t *package);
+static void uci_package_free(srpo_uci_package_t *package);
+static void *uci_preload_worker(void *arg);
+static size_t uci_node_memory_size(uci2_n_t *node);
+
 // context functions
 static srpo_uci_ctx_t *uci_context_alloc(void);
 static void uci_context_set_config_dir(srpo_uci_ctx_t *ctx, const char *dir);
-static int uci_context_load(srpo_uci_ctx_t *ctx, const char *config);
-static int uci_context_create_config_path(srpo_uci_ctx_t *ctx, const char *config);
-static int uci_context_revert(srpo_uci_ctx_t *ctx, const char *config);
+static int uci_context_set_cache_dir(srpo_uci_ctx_t *ctx, const char *dir);
+static int uci_context_package_get(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_package_t **package);
+static int uci_context_package_acquire(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_package_t **package);
+static void uci_context_package_release(srpo_uci_package_t *package);
+static int uci_context_snapshot_acquire(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_snapshot_t **snapshot);
+static srpo_uci_package_t *uci_context_package_find(srpo_uci_ctx_t *ctx, const char *config);
+static int uci_context_create_config_path(const char *config_dir, const char *config, char *config_path, size_t config_path_size);
+static int uci_context_revert(srpo_uci_ctx_t *ctx, const char *config, size_t savepoint);
 static int uci_context_commit(srpo_uci_ctx_t *ctx, const char *config);
+static int uci_context_config_snapshot(srpo_uci_ctx_t *ctx, const char *config, const char *snapshot_dir);
+static int uci_context_diff(srpo_uci_ctx_t *ctx, srpo_uci_diff_ctx_t *diff_ctx);
+static void uci_context_evict(srpo_uci_ctx_t *ctx, srpo_uci_package_t *keep);
+static int uci_package_last_used_compare(const void *a, const void *b);
 static void uci_context_free(srpo_uci_ctx_t *ctx);
 
+// arena functions
+static void uci_arena_pin(srpo_uci_arena_t *arena, srpo_uci_snapshot_t *snapshot);
+static void uci_arena_unpin(srpo_uci_arena_t *arena);
+static int uci_list_update(srpo_uci_ctx_t *ctx, const char *ucipath, const char **values, size_t values_size, srpo_uci_list_update_t update, bool ordered, srpo_uci_transform_data_batch_cb batch_cb, void *private_data);
+static int uci_values_batch_transform(const char **values, size_t values_size, srpo_uci_transform_data_batch_cb batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***transformed_values, size_t *transformed_values_size);
+
+// watch functions
+static void *uci_watch_thread(void *arg);
+static void uci_watch_event_handle(srpo_uci_watch_t *watch, const struct inotify_event *event);
+static int uci_watch_diff_cb(const char *ucipath, srpo_uci_diff_op_t op, const char *old_value, const char *new_value, void *private_data);
+static int uci_watch_apply_cb(void *private_data);
+static void uci_watch_free(srpo_uci_watch_t *watch);
+
+// reload functions
+static void *uci_reload_thread(void *arg);
+static void uci_reload_run(srpo_uci_reload_t *reload, srpo_uci_reload_request_t *requests);
+static const srpo_uci_reload_config_t *uci_reload_service_get(srpo_uci_reload_t *reload, const char *uci_config);
+static bool uci_reload_service_equal(const srpo_uci_reload_config_t *a, const srpo_uci_reload_config_t *b);
+static void uci_reload_free(srpo_uci_reload_t *reload);
+
 int srpo_uci_init(void)
 {
 	int error = SRPO_UCI_ERR_OK;
@@ -77,6 +388,12 @@ int srpo_uci_init(void)
 	}
 
 	uci_context_set_config_dir(uci_context, SRPO_UCI_CONFIG_DIR);
+	if (SRPO_UCI_CACHE_DIR[0] != '\0') {
+		error = uci_context_set_cache_dir(uci_context, SRPO_UCI_CACHE_DIR);
+		if (error) {
+			goto error_out;
+		}
+	}
 	goto out;
 
 error_out:
@@ -95,1033 +412,4168 @@ void srpo_uci_cleanup(void)
 	}
 }
 
-const char *srpo_uci_error_description_get(srpo_uci_error_e error)
+int srpo_uci_handle_preload(srpo_uci_handle_t *ctx, const char **uci_config_list, size_t uci_config_list_size, size_t worker_count)
 {
-	switch (error) {
-#define XM(ENUM, CODE, DESCRIPTION) \
-	case ENUM:                      \
-		return DESCRIPTION;
+	int error = SRPO_UCI_ERR_OK;
+	srpo_path_list_t config_list;
+	srpo_uci_preload_job_t job = {0};
+	pthread_t *workers = NULL;
+	size_t workers_started = 0;
+	DIR *config_dir = NULL;
+	struct dirent *entry = NULL;
 
-		SRPO_UCI_ERROR_TABLE
-#undef XM
+	srpo_path_list_init(&config_list);
 
-		default:
-			return "unknown error code";
+	if (ctx == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
 	}
-}
 
-int ucipath_add_to_list(const char *uci_config, uci2_n_t *node_type, uci2_n_t *node_sec, bool anonym_sec, srpo_path_list_t *path_list)
-{
-	int error = 0;
+	// without an explicit list every regular file in the config directory is a package
+	if (uci_config_list == NULL) {
+		config_dir = opendir(ctx->config_dir);
+		if (config_dir == NULL) {
+			return SRPO_UCI_ERR_DIRECTORY;
+		}
 
-	// buffers for writing the full node path
-	char path_buffer[PATH_MAX] = {0};
-	char sec_buffer[256] = {0};
-	char list_items_buffer[256] = {0};
+		while ((entry = readdir(config_dir)) != NULL) {
+			if (entry->d_name[0] == '.' || (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)) {
+				continue;
+			}
+			srpo_path_list_append(&config_list, xstrdup(entry->d_name));
+		}
+		closedir(config_dir);
 
-	if (node_sec == NULL) {
-		// wanted node not found -> error
-		return SRPO_UCI_ERR_ARGUMENT;
+		uci_config_list = (const char **) config_list.data;
+		uci_config_list_size = config_list.size;
 	}
 
-	if (anonym_sec) {
-		snprintf(sec_buffer, sizeof(sec_buffer), "@%s[%d]", uci2_get_name(node_sec), node_sec->id - 1);
-	} else {
-		snprintf(sec_buffer, sizeof(sec_buffer), "%s", uci2_get_name(node_sec));
-	}
+	job.packages = xcalloc(uci_config_list_size ? uci_config_list_size : 1, sizeof(srpo_uci_package_t *));
+	job.errors = xcalloc(uci_config_list_size ? uci_config_list_size : 1, sizeof(int));
 
-	// write node path in the list
-	snprintf(path_buffer, sizeof(path_buffer), "%s.%s", uci_config, sec_buffer);
-	srpo_path_list_append(path_list, xstrdup(path_buffer));
+	pthread_mutex_lock(&ctx->packages_lock);
+	for (size_t i = 0; i < uci_config_list_size; i++) {
+		if (uci_context_package_find(ctx, uci_config_list[i]) || section_list_contains(uci_config_list, i, uci_config_list[i])) {
+			continue;
+		}
 
-	// iterate options and lists and write them to the path
-	for (int i = 0; i < node_sec->ch_nr; i++) {
-		uci2_n_t *child = node_sec->ch[i];
-		if (child->nt == UCI2_NT_LIST) {
-			// if its not an option -> list
-			size_t byte_cnt = 0;
-
-			for (int j = 0; j < child->ch_nr; j++) {
-				uci2_n_t *li = child->ch[j];
-
-				if (sizeof(list_items_buffer) - byte_cnt > 0) {
-					snprintf(list_items_buffer + byte_cnt, sizeof(list_items_buffer) - byte_cnt, "\'%s\' ", uci2_get_name(li));
-					byte_cnt += strlen(li->name);
-				} else {
-					error = SRPO_UCI_ERR_UCI;
-					break;
-				}
-			}
-			// remove last space
-			list_items_buffer[byte_cnt - 2] = 0;
+		job.packages[job.size] = uci_package_alloc(ctx->config_dir, ctx->cache_dir, uci_config_list[i], &error);
+		if (job.packages[job.size] == NULL) {
+			pthread_mutex_unlock(&ctx->packages_lock);
+			goto out;
 		}
-		snprintf(path_buffer, sizeof(path_buffer), "%s.%s.%s", uci_config, sec_buffer, uci2_get_name(child));
-		srpo_path_list_append(path_list, xstrdup(path_buffer));
+		job.size++;
 	}
+	pthread_mutex_unlock(&ctx->packages_lock);
 
-	return error;
-}
+	if (worker_count == 0) {
+		long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		worker_count = online_cpus > 0 ? (size_t) online_cpus : 1;
+	}
+	if (worker_count > job.size) {
+		worker_count = job.size;
+	}
 
-int srpo_uci_ucipath_list_get(const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, char ***ucipath_list, size_t *ucipath_list_size, bool convert_to_extended)
-{
-	int error = 0;
-	srpo_path_list_t path_list;
+	// the packages are independent files, parse them on a small pool of workers
+	workers = xcalloc(worker_count ? worker_count : 1, sizeof(pthread_t));
+	for (; workers_started < worker_count; workers_started++) {
+		if (pthread_create(&workers[workers_started], NULL, uci_preload_worker, &job) != 0) {
+			break;
+		}
+	}
 
-	srpo_path_list_init(&path_list);
-	error = uci_context_load(uci_context, uci_config);
+	// parse whatever is left in the calling thread if no worker could be started
+	if (workers_started == 0) {
+		uci_preload_worker(&job);
+	}
 
-	if (error != SRPO_UCI_ERR_OK) {
-		return error;
-	} else {
-		uci2_n_t *root = UCI2_CFG_ROOT(uci_context->parser_ctx);
+	for (size_t i = 0; i < workers_started; i++) {
+		pthread_join(workers[i], NULL);
+	}
 
-		for (size_t iter = 0; iter < uci_section_list_size; iter++) {
-			for (int i = 0; i < root->ch_nr; i++) {
-				uci2_n_t *type = root->ch[i];
-
-				// check if types match
-				if (strcmp(type->name, uci_section_list[iter]) == 0) {
-
-					// anonymous section? if yes => convert to extended i.e. type.@sec...
-					if (UCI2_IS_ANYNYMOUS_SECTION(type) && convert_to_extended) {
-						error = ucipath_add_to_list(uci_config, type, type, true, &path_list);
-						if (error != 0) {
-							goto error_out;
-						}
-					} else {
-						// if not, iterate through sections and append all sections and its options to the path list
-						for (int j = 0; j < type->ch_nr; j++) {
-							uci2_n_t *sec = type->ch[j];
-
-							error = ucipath_add_to_list(uci_config, type, sec, false, &path_list);
-							if (error != 0) {
-								goto error_out;
-							}
-						}
-					}
-				}
+	// publish the parsed packages to the cache, keep the first error for the caller
+	pthread_mutex_lock(&ctx->packages_lock);
+	for (size_t i = 0; i < job.size; i++) {
+		if (job.errors[i] != SRPO_UCI_ERR_OK) {
+			if (error == SRPO_UCI_ERR_OK) {
+				error = job.errors[i];
 			}
+			continue;
+		}
+
+		// another thread may have loaded the same package while the workers were parsing
+		if (uci_context_package_find(ctx, job.packages[i]->name)) {
+			continue;
 		}
+
+		job.packages[i]->last_used = ++ctx->use_clock;
+		job.packages[i]->next = ctx->packages;
+		ctx->packages = job.packages[i];
+		job.packages[i] = NULL;
 	}
-	goto out;
+	pthread_mutex_unlock(&ctx->packages_lock);
 
-error_out:
-	// free the created list if an error occured and set output to NULL
-	srpo_path_list_free(&path_list);
+	uci_context_evict(ctx, NULL);
 
 out:
-	*ucipath_list = path_list.data;
-	*ucipath_list_size = path_list.size;
+	for (size_t i = 0; i < job.size; i++) {
+		uci_package_free(job.packages[i]);
+	}
+	FREE_SAFE(job.packages);
+	FREE_SAFE(job.errors);
+	FREE_SAFE(workers);
+	srpo_path_list_free(&config_list);
 
 	return error;
 }
 
-int srpo_uci_xpath_to_ucipath_convert(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, char **ucipath)
+int srpo_uci_handle_init(const char *config_dir, srpo_uci_handle_t **handle)
 {
-	char *ucipath_tmp = NULL;
-	int error = SR_ERR_OK;
-
-	if (xpath == NULL || ucipath == NULL || xpath_uci_template_map == NULL) {
+	if (handle == NULL) {
 		return SRPO_UCI_ERR_ARGUMENT;
 	}
 
-	*ucipath = NULL;
-
-	// find the table entry that matches the xpath for the found xpath list key
-	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
-		error = srpo_uci_path_get(xpath,
-								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
-								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			continue;
-		} else if (error == SR_ERR_OK) {
-			break;
-		} else {
-			return SRPO_UCI_ERR_ARGUMENT;
-		}
-	}
-
-	*ucipath = ucipath_tmp;
+	*handle = uci_context_alloc();
+	uci_context_set_config_dir(*handle, config_dir ? config_dir : SRPO_UCI_CONFIG_DIR);
 
-	return *ucipath ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_NOT_FOUND;
+	return SRPO_UCI_ERR_OK;
 }
 
-int srpo_uci_ucipath_to_xpath_convert(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, char **xpath)
+void srpo_uci_handle_cleanup(srpo_uci_handle_t *handle)
 {
-	char *xpath_tmp = NULL;
-	int error = SR_ERR_OK;
+	uci_context_free(handle);
+}
 
-	if (ucipath == NULL || xpath == NULL || uci_xpath_template_map == NULL) {
+int srpo_uci_handle_cache_dir_set(srpo_uci_handle_t *handle, const char *cache_dir)
+{
+	if (handle == NULL) {
 		return SRPO_UCI_ERR_ARGUMENT;
 	}
 
-	*xpath = xpath_tmp;
+	return uci_context_set_cache_dir(handle, cache_dir);
+}
 
-	// find the table entry that matches the uci path for the found uci section
-	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
-		error = srpo_uci_path_get(ucipath,
-								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
-								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			continue;
-		} else if (error == SR_ERR_OK) {
-			break;
-		} else {
-			return SRPO_UCI_ERR_ARGUMENT;
-		}
+int srpo_uci_handle_memory_budget_set(srpo_uci_handle_t *handle, size_t memory_budget)
+{
+	if (handle == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
 	}
 
-	*xpath = xpath_tmp;
+	__atomic_store_n(&handle->memory_budget, memory_budget, __ATOMIC_RELAXED);
+	uci_context_evict(handle, NULL);
 
-	return *xpath ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_NOT_FOUND;
+	return SRPO_UCI_ERR_OK;
 }
 
-int srpo_uci_path_get(const char *target, const char *from_template, const char *to_template, srpo_uci_transform_path_cb transform_path_cb, srpo_uci_path_direction_t direction, char **path)
+int srpo_uci_handle_config_snapshot(srpo_uci_handle_t *handle, const char *uci_config, const char *snapshot_dir)
 {
-	int error = SRPO_UCI_ERR_ARGUMENT;
-	char *path_key_value = NULL;
-	char *path_tmp = NULL;
-
-	if (from_template == NULL || to_template == NULL) {
-		goto cleanup;
-	}
-
-	/* redirect to custom path handler */
-	if (transform_path_cb) {
-		error = transform_path_cb(target, from_template, to_template, direction, path);
-		goto cleanup;
-	}
-
-	/* assume simple path constructor */
-	if (direction == SRPO_UCI_PATH_DIRECTION_XPATH) {
-		path_key_value = srpo_uci_section_name_get(target);
-	} else if (direction == SRPO_UCI_PATH_DIRECTION_UCI) {
-		path_key_value = srpo_uci_xpath_key_value_get(target, 1);
+	if (handle == NULL || uci_config == NULL || snapshot_dir == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
 	}
 
-	path_tmp = path_from_template_get(from_template, path_key_value);
-	if (strcmp(target, path_tmp) == 0) {
-		*path = path_from_template_get(to_template, path_key_value);
-
-		error = SRPO_UCI_ERR_OK;
-		goto cleanup;
+	if (mkdir(snapshot_dir, 0700) != 0 && errno != EEXIST) {
+		return SRPO_UCI_ERR_DIRECTORY;
 	}
 
-	error = SRPO_UCI_ERR_NOT_FOUND;
-
-cleanup:
-	FREE_SAFE(path_tmp);
-	FREE_SAFE(path_key_value);
-
-	return error;
+	return uci_context_config_snapshot(handle, uci_config, snapshot_dir);
 }
 
-int srpo_uci_transform_sysrepo_data_cb_get(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, srpo_uci_transform_data_cb *transform_sysrepo_data_cb)
+int srpo_uci_diff(const char *uci_config, srpo_uci_diff_cb diff_cb, void *private_data)
 {
-	int error = SRPO_UCI_ERR_OK;
-	srpo_uci_transform_data_cb transform_sysrepo_data_cb_tmp = NULL;
-	char *ucipath_tmp = NULL;
+	return srpo_uci_handle_diff(uci_context, uci_config, diff_cb, private_data);
+}
 
-	if (xpath == NULL || xpath_uci_template_map == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
-	}
+int srpo_uci_watch_start(sr_conn_ctx_t *connection, const srpo_uci_watch_config_t *watch_config_list, size_t watch_config_list_size, unsigned int debounce_ms, srpo_uci_watch_t **watch)
+{
+	return srpo_uci_handle_watch_start(uci_context, connection, watch_config_list, watch_config_list_size, debounce_ms, watch);
+}
 
-	// find the table entry that matches the xpath for the found xpath list key
-	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
-		error = srpo_uci_path_get(xpath,
-								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
-								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			FREE_SAFE(ucipath_tmp);
-			continue;
-		} else if (error == SRPO_UCI_ERR_OK) {
-			transform_sysrepo_data_cb_tmp = xpath_uci_template_map[i].transform_sysrepo_data_cb;
-			break;
-		} else {
-			FREE_SAFE(ucipath_tmp);
-			return SRPO_UCI_ERR_ARGUMENT;
-		}
-	}
+int srpo_uci_reload_start(const srpo_uci_reload_config_t *reload_config_list, size_t reload_config_list_size, unsigned int debounce_ms, srpo_uci_reload_t **reload)
+{
+	return srpo_uci_handle_reload_start(uci_context, reload_config_list, reload_config_list_size, debounce_ms, reload);
+}
 
-	*transform_sysrepo_data_cb = transform_sysrepo_data_cb_tmp;
+int srpo_uci_cache_dir_set(const char *cache_dir)
+{
+	return srpo_uci_handle_cache_dir_set(uci_context, cache_dir);
+}
 
-	FREE_SAFE(ucipath_tmp);
+int srpo_uci_memory_budget_set(size_t memory_budget)
+{
+	return srpo_uci_handle_memory_budget_set(uci_context, memory_budget);
+}
 
-	return SRPO_UCI_ERR_OK;
+int srpo_uci_config_snapshot(const char *uci_config, const char *snapshot_dir)
+{
+	return srpo_uci_handle_config_snapshot(uci_context, uci_config, snapshot_dir);
 }
 
-int srpo_uci_transform_uci_data_cb_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, srpo_uci_transform_data_cb *transform_uci_data_cb)
+int srpo_uci_preload(const char **uci_config_list, size_t uci_config_list_size, size_t worker_count)
 {
-	int error = SRPO_UCI_ERR_OK;
-	srpo_uci_transform_data_cb transform_uci_data_cb_tmp = NULL;
-	char *xpath_tmp = NULL;
+	return srpo_uci_handle_preload(uci_context, uci_config_list, uci_config_list_size, worker_count);
+}
 
-	if (ucipath == NULL || uci_xpath_template_map == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
-	}
+int srpo_uci_ucipath_foreach(const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, srpo_uci_ucipath_cb ucipath_cb, void *private_data)
+{
+	return srpo_uci_handle_ucipath_foreach(uci_context, uci_config, uci_section_list, uci_section_list_size, convert_to_extended, ucipath_cb, private_data);
+}
 
-	// find the table entry that matches the uci path for the found uci section
-	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
-		error = srpo_uci_path_get(ucipath,
-								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
-								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			FREE_SAFE(xpath_tmp);
-			continue;
-		} else if (error == SR_ERR_OK) {
-			transform_uci_data_cb_tmp = uci_xpath_template_map[i].transform_uci_data_cb;
-			break;
-		} else {
-			FREE_SAFE(xpath_tmp);
-			return SRPO_UCI_ERR_ARGUMENT;
-		}
-	}
+int srpo_uci_ucipath_list_get(const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, char ***ucipath_list, size_t *ucipath_list_size, bool convert_to_extended)
+{
+	return srpo_uci_handle_ucipath_list_get(uci_context, uci_config, uci_section_list, uci_section_list_size, ucipath_list, ucipath_list_size, convert_to_extended);
+}
 
-	*transform_uci_data_cb = transform_uci_data_cb_tmp;
+int srpo_uci_sysrepo_export(sr_session_ctx_t *session, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended,
+							srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data)
+{
+	return srpo_uci_handle_sysrepo_export(uci_context, session, uci_config, uci_section_list, uci_section_list_size, convert_to_extended, uci_xpath_template_map, uci_xpath_template_map_size, private_data);
+}
 
-	FREE_SAFE(xpath_tmp);
+int srpo_uci_get_subtree(const struct ly_ctx *ly_ctx, const char *request_xpath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data, struct lyd_node **tree)
+{
+	return srpo_uci_handle_get_subtree(uci_context, ly_ctx, request_xpath, uci_xpath_template_map, uci_xpath_template_map_size, private_data, tree);
+}
 
-	return SRPO_UCI_ERR_OK;
+int srpo_uci_section_create(const char *ucipath, const char *uci_section_type)
+{
+	return srpo_uci_handle_section_create(uci_context, ucipath, uci_section_type);
 }
 
-int srpo_uci_section_type_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, const char **uci_section_type)
+int srpo_uci_section_delete(const char *ucipath)
+{
+	return srpo_uci_handle_section_delete(uci_context, ucipath);
+}
+
+int srpo_uci_option_set(const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+{
+	return srpo_uci_handle_option_set(uci_context, ucipath, value, transform_sysrepo_data_cb, private_data);
+}
+
+int srpo_uci_option_remove(const char *ucipath)
+{
+	return srpo_uci_handle_option_remove(uci_context, ucipath);
+}
+
+int srpo_uci_list_set(const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+{
+	return srpo_uci_handle_list_set(uci_context, ucipath, value, transform_sysrepo_data_cb, private_data);
+}
+
+int srpo_uci_list_remove(const char *ucipath, const char *value)
+{
+	return srpo_uci_handle_list_remove(uci_context, ucipath, value);
+}
+
+int srpo_uci_element_value_get(const char *ucipath, srpo_uci_transform_data_cb transform_uci_data_cb, void *private_data, char ***value_list, size_t *value_list_size)
+{
+	return srpo_uci_handle_element_value_get(uci_context, ucipath, transform_uci_data_cb, private_data, value_list, value_list_size);
+}
+
+int srpo_uci_list_batch_set(const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	return srpo_uci_handle_list_batch_set(uci_context, ucipath, values, values_size, transform_sysrepo_data_batch_cb, private_data);
+}
+
+int srpo_uci_list_replace(const char *ucipath, const char **values, size_t values_size, bool ordered, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	return srpo_uci_handle_list_replace(uci_context, ucipath, values, values_size, ordered, transform_sysrepo_data_batch_cb, private_data);
+}
+
+int srpo_uci_list_bulk_add(const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	return srpo_uci_handle_list_bulk_add(uci_context, ucipath, values, values_size, transform_sysrepo_data_batch_cb, private_data);
+}
+
+int srpo_uci_list_bulk_remove(const char *ucipath, const char **values, size_t values_size)
+{
+	return srpo_uci_handle_list_bulk_remove(uci_context, ucipath, values, values_size);
+}
+
+int srpo_uci_element_value_batch_get(const char *ucipath, srpo_uci_transform_data_batch_cb transform_uci_data_batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***value_list, size_t *value_list_size)
+{
+	return srpo_uci_handle_element_value_batch_get(uci_context, ucipath, transform_uci_data_batch_cb, private_data, arena, value_list, value_list_size);
+}
+
+int srpo_uci_revert(const char *uci_config)
+{
+	return srpo_uci_handle_revert(uci_context, uci_config);
+}
+
+int srpo_uci_savepoint_get(const char *uci_config, size_t *savepoint)
+{
+	return srpo_uci_handle_savepoint_get(uci_context, uci_config, savepoint);
+}
+
+int srpo_uci_savepoint_revert(const char *uci_config, size_t savepoint)
+{
+	return srpo_uci_handle_savepoint_revert(uci_context, uci_config, savepoint);
+}
+
+int srpo_uci_commit(const char *uci_config)
+{
+	return srpo_uci_handle_commit(uci_context, uci_config);
+}
+
+const char *srpo_uci_error_description_get(srpo_uci_error_e error)
+{
+	switch (error) {
+#define XM(ENUM, CODE, DESCRIPTION) \
+	case ENUM:                      \
+		return DESCRIPTION;
+
+		SRPO_UCI_ERROR_TABLE
+#undef XM
+
+		default:
+			return "unknown error code";
+	}
+}
+
+static size_t ucipath_section_format(srpo_path_buffer_t *buffer, const char *uci_config, const uci_index_section_t *section)
+{
+	if (section->name == NULL) {
+		return path_buffer_format(buffer, 0, "%s.@%s[%zu]", uci_config, section->type, section->position);
+	}
+
+	return path_buffer_format(buffer, 0, "%s.%s", uci_config, section->name);
+}
+
+static int ucipath_section_emit(const char *uci_config, const uci_index_t *index, const uci_index_section_t *section, srpo_path_buffer_t *buffer, ucipath_node_cb node_cb, void *private_data)
 {
 	int error = SRPO_UCI_ERR_OK;
-	const char *uci_section_type_tmp = NULL;
-	char *xpath_tmp = NULL;
+	size_t sec_len = 0;
 
-	if (ucipath == NULL || uci_xpath_template_map == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	// the section path is written once and only the option part is rewritten for every child
+	sec_len = ucipath_section_format(buffer, uci_config, section);
+
+	error = node_cb(buffer->data, index, section, NULL, private_data);
+	if (error) {
+		return error;
 	}
 
-	// find the table entry that matches the uci path for the found uci section
-	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
-		error = srpo_uci_path_get(ucipath,
-								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
-								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+	// iterate options and lists and write them to the path
+	for (size_t i = section->option_first; i < section->option_first + section->option_count; i++) {
+		const uci_index_option_t *option = &index->options[i];
+
+		path_buffer_format(buffer, sec_len, ".%s", option->name);
+		error = node_cb(buffer->data, index, section, option, private_data);
+		if (error) {
+			return error;
+		}
+	}
+
+	return SRPO_UCI_ERR_OK;
+}
+
+static int ucipath_walk(srpo_uci_snapshot_t *snapshot, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, ucipath_node_cb node_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_path_buffer_t buffer;
+	const uci_index_t *index = &snapshot->index;
+
+	path_buffer_init(&buffer);
+
+	// visit every section once and check its type against the requested section types
+	for (size_t i = 0; i < index->sections_size; i++) {
+		const uci_index_section_t *section = &index->sections[i];
+
+		if (!section_list_contains(uci_section_list, uci_section_list_size, section->type)) {
 			continue;
-		} else if (error == SR_ERR_OK) {
-			uci_section_type_tmp = uci_xpath_template_map[i].uci_section_type;
-			break;
-		} else {
-			return SRPO_UCI_ERR_ARGUMENT;
+		}
+
+		// anonymous sections can only be addressed with the extended i.e. type.@sec... syntax
+		if (section->name == NULL && !convert_to_extended) {
+			continue;
+		}
+
+		error = ucipath_section_emit(snapshot->name, index, section, &buffer, node_cb, private_data);
+		if (error) {
+			goto out;
 		}
 	}
 
-	*uci_section_type = uci_section_type_tmp;
+out:
+	path_buffer_free(&buffer);
 
-	FREE_SAFE(xpath_tmp);
+	return error;
+}
 
-	return SRPO_UCI_ERR_OK;
+static int ucipath_foreach_cb(const char *ucipath, const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, void *private_data)
+{
+	struct {
+		srpo_uci_ucipath_cb ucipath_cb;
+		void *private_data;
+	} *foreach_args = private_data;
+
+	return foreach_args->ucipath_cb(ucipath, foreach_args->private_data);
 }
 
-int srpo_uci_has_transform_sysrepo_data_private_get(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, bool *has_transform_sysrepo_data_private)
+int srpo_uci_handle_ucipath_foreach(srpo_uci_handle_t *ctx, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, srpo_uci_ucipath_cb ucipath_cb, void *private_data)
 {
 	int error = SRPO_UCI_ERR_OK;
-	bool has_transform_sysrepo_data_private_tmp = false;
-	char *ucipath_tmp = NULL;
+	struct {
+		srpo_uci_ucipath_cb ucipath_cb;
+		void *private_data;
+	} foreach_args = {ucipath_cb, private_data};
+	srpo_uci_snapshot_t *snapshot = NULL;
 
-	if (xpath == NULL || xpath_uci_template_map == NULL) {
+	if (uci_config == NULL || ucipath_cb == NULL) {
 		return SRPO_UCI_ERR_ARGUMENT;
 	}
 
-	// find the table entry that matches the xpath for the found xpath list key
-	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
-		error = srpo_uci_path_get(xpath,
-								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
-								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			FREE_SAFE(ucipath_tmp);
-			continue;
-		} else if (error == SRPO_UCI_ERR_OK) {
-			has_transform_sysrepo_data_private_tmp = xpath_uci_template_map[i].has_transform_sysrepo_data_private;
-			break;
-		} else {
-			FREE_SAFE(ucipath_tmp);
-			return SRPO_UCI_ERR_ARGUMENT;
+	error = uci_context_snapshot_acquire(ctx, uci_config, &snapshot);
+	if (error != SRPO_UCI_ERR_OK) {
+		return error;
+	}
+
+	error = ucipath_walk(snapshot, uci_section_list, uci_section_list_size, convert_to_extended, ucipath_foreach_cb, &foreach_args);
+	uci_snapshot_put(snapshot);
+
+	return error;
+}
+
+static int ucipath_list_append_cb(const char *ucipath, const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, void *private_data)
+{
+	srpo_uci_ucipath_list_ctx_t *list_ctx = private_data;
+
+	// every path goes to the list of its requested section type, a type requested twice gets the paths twice
+	for (size_t i = 0; i < list_ctx->uci_section_list_size; i++) {
+		if (strcmp(list_ctx->uci_section_list[i], section->type) == 0) {
+			srpo_path_list_append(&list_ctx->type_lists[i], xstrdup(ucipath));
 		}
 	}
 
-	*has_transform_sysrepo_data_private = has_transform_sysrepo_data_private_tmp;
+	return SRPO_UCI_ERR_OK;
+}
 
-	FREE_SAFE(ucipath_tmp);
+int srpo_uci_handle_ucipath_list_get(srpo_uci_handle_t *ctx, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, char ***ucipath_list, size_t *ucipath_list_size, bool convert_to_extended)
+{
+	int error = 0;
+	srpo_path_list_t path_list;
+	srpo_uci_ucipath_list_ctx_t list_ctx = {uci_section_list, uci_section_list_size, NULL};
+	srpo_uci_snapshot_t *snapshot = NULL;
+
+	srpo_path_list_init(&path_list);
+	error = uci_context_snapshot_acquire(ctx, uci_config, &snapshot);
+
+	if (error != SRPO_UCI_ERR_OK) {
+		return error;
+	}
+
+	// the configuration is walked once, the paths are grouped in the order of the requested section types afterwards
+	list_ctx.type_lists = xcalloc(uci_section_list_size ? uci_section_list_size : 1, sizeof(srpo_path_list_t));
+	error = ucipath_walk(snapshot, uci_section_list, uci_section_list_size, convert_to_extended, ucipath_list_append_cb, &list_ctx);
+	if (error != 0) {
+		goto error_out;
+	}
+
+	for (size_t iter = 0; iter < uci_section_list_size; iter++) {
+		path_list.size += list_ctx.type_lists[iter].size;
+	}
+	if (path_list.size) {
+		path_list.data = xmalloc(sizeof(char *) * path_list.size);
+		path_list.capacity = path_list.size;
+		path_list.size = 0;
+		for (size_t iter = 0; iter < uci_section_list_size; iter++) {
+			// the strings move to the result, only the arrays of the type lists are freed
+			if (list_ctx.type_lists[iter].size) {
+				memcpy(&path_list.data[path_list.size], list_ctx.type_lists[iter].data, sizeof(char *) * list_ctx.type_lists[iter].size);
+				path_list.size += list_ctx.type_lists[iter].size;
+			}
+			FREE_SAFE(list_ctx.type_lists[iter].data);
+		}
+	}
+	goto out;
+
+error_out:
+	// free the created lists if an error occured and set output to NULL
+	for (size_t iter = 0; iter < uci_section_list_size; iter++) {
+		srpo_path_list_free(&list_ctx.type_lists[iter]);
+	}
+	srpo_path_list_free(&path_list);
+
+out:
+	FREE_SAFE(list_ctx.type_lists);
+	uci_snapshot_put(snapshot);
+	*ucipath_list = path_list.data;
+	*ucipath_list_size = path_list.size;
+
+	return error;
+}
+
+static int export_value_add(srpo_uci_export_ctx_t *export_ctx, const char *xpath, const char *value, srpo_uci_xpath_uci_template_map_t *template_entry)
+{
+	char *transform_value = NULL;
+	struct lyd_node *node = NULL;
+	void *transform_private_data = NULL;
+
+	if (value && template_entry->transform_uci_data_cb) {
+		transform_private_data = template_entry->has_transform_uci_data_private ? export_ctx->private_data : NULL;
+		transform_value = template_entry->transform_uci_data_cb(value, transform_private_data);
+		if (transform_value == NULL) {
+			// transform callback dropped the value
+			return SRPO_UCI_ERR_OK;
+		}
+		value = transform_value;
+	}
+
+	ly_errno = LY_SUCCESS;
+	node = lyd_new_path(export_ctx->tree, export_ctx->ly_ctx, xpath, (void *) value, LYD_ANYDATA_CONSTSTRING, LYD_PATH_OPT_UPDATE);
+	FREE_SAFE(transform_value);
+
+	// NULL without an error means the node already existed with the same value
+	if (node == NULL && ly_errno != LY_SUCCESS) {
+		return SRPO_UCI_ERR_XPATH;
+	}
+
+	if (export_ctx->tree == NULL) {
+		export_ctx->tree = node;
+	}
 
 	return SRPO_UCI_ERR_OK;
 }
 
-int srpo_uci_has_transform_uci_data_private_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, bool *has_transform_uci_data_private)
+static int export_node_add(srpo_uci_export_ctx_t *export_ctx, const char *xpath, const uci_index_t *index, const uci_index_option_t *option, srpo_uci_xpath_uci_template_map_t *template_entry)
 {
 	int error = SRPO_UCI_ERR_OK;
-	bool has_transform_uci_data_private_tmp = false;
-	char *xpath_tmp = NULL;
 
-	if (ucipath == NULL || uci_xpath_template_map == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	if (option) {
+		// an option has one value, a list one value per item
+		for (size_t i = option->value_first; i < option->value_first + option->value_count && error == SRPO_UCI_ERR_OK; i++) {
+			error = export_value_add(export_ctx, xpath, index->values[i], template_entry);
+		}
+	} else {
+		// sections map to list instances which carry no value of their own
+		error = export_value_add(export_ctx, xpath, NULL, template_entry);
+	}
+
+	return error;
+}
+
+static int export_node_cb(const char *ucipath, const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_export_ctx_t *export_ctx = private_data;
+	srpo_uci_xpath_uci_template_map_t *template_entry = NULL;
+	char *xpath = NULL;
+
+	template_entry = template_map_ucipath_entry_get(ucipath, export_ctx->template_map, export_ctx->template_map_size, &xpath, &error);
+	if (template_entry == NULL) {
+		// paths without a template are not exported
+		return error == SRPO_UCI_ERR_NOT_FOUND ? SRPO_UCI_ERR_OK : error;
+	}
+
+	error = export_node_add(export_ctx, xpath, index, option, template_entry);
+	FREE_SAFE(xpath);
+
+	return error;
+}
+
+int srpo_uci_handle_sysrepo_export(srpo_uci_handle_t *ctx, sr_session_ctx_t *session, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended,
+							srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_export_ctx_t export_ctx = {0};
+	srpo_uci_snapshot_t *snapshot = NULL;
+
+	if (session == NULL || uci_config == NULL || uci_xpath_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	export_ctx.ly_ctx = sr_get_context(sr_session_get_connection(session));
+	export_ctx.template_map = uci_xpath_template_map;
+	export_ctx.template_map_size = uci_xpath_template_map_size;
+	export_ctx.private_data = private_data;
+
+	error = uci_context_snapshot_acquire(ctx, uci_config, &snapshot);
+	if (error != SRPO_UCI_ERR_OK) {
+		return error;
+	}
+
+	error = ucipath_walk(snapshot, uci_section_list, uci_section_list_size, convert_to_extended, export_node_cb, &export_ctx);
+	uci_snapshot_put(snapshot);
+	if (error != SRPO_UCI_ERR_OK) {
+		goto out;
+	}
+
+	// hand the whole package to sysrepo as one edit, the caller applies it together with its other changes
+	if (export_ctx.tree && sr_edit_batch(session, export_ctx.tree, "merge") != SR_ERR_OK) {
+		error = SRPO_UCI_ERR_XPATH;
+		goto out;
+	}
+
+out:
+	if (export_ctx.tree) {
+		lyd_free_withsiblings(export_ctx.tree);
+	}
+
+	return error;
+}
+
+static bool xpath_token_name_equal(const srpo_uci_xpath_token_t *a, const srpo_uci_xpath_token_t *b)
+{
+	const char *a_name = memchr(a->name, ':', a->name_size);
+	const char *b_name = memchr(b->name, ':', b->name_size);
+	size_t a_size = a->name_size;
+	size_t b_size = b->name_size;
+
+	// only the first node carries the module prefix, the local names are compared
+	if (a_name) {
+		a_size -= (size_t) (++a_name - a->name);
+	} else {
+		a_name = a->name;
+	}
+	if (b_name) {
+		b_size -= (size_t) (++b_name - b->name);
+	} else {
+		b_name = b->name;
+	}
+
+	return a_size == b_size && strncmp(a_name, b_name, a_size) == 0;
+}
+
+static bool xpath_token_value_equal(const srpo_uci_xpath_token_t *a, const srpo_uci_xpath_token_t *b)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	// a doubled quote is compared as the single character it stands for
+	while (i < a->value_size && j < b->value_size) {
+		if (a->value[i] != b->value[j]) {
+			return false;
+		}
+		i += a->value[i] == a->quote ? 2 : 1;
+		j += b->value[j] == b->quote ? 2 : 1;
+	}
+
+	return i >= a->value_size && j >= b->value_size;
+}
+
+static bool xpath_token_placeholder(const srpo_uci_xpath_token_t *token)
+{
+	for (size_t i = 0; i + 1 < token->value_size; i++) {
+		if (token->value[i] == '%' && token->value[i + 1] == 's') {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool subtree_xpath_match(const srpo_uci_xpath_token_t *request, size_t request_size, const char *xpath, bool template, const srpo_uci_xpath_token_t **pinned)
+{
+	srpo_uci_xpath_token_t token_list[SRPO_UCI_XPATH_TOKENS_MAX];
+	size_t token_count = 0;
+	size_t key_first = 0;
+	size_t t = 0;
+
+	if (srpo_uci_xpath_tokenize(xpath, token_list, SRPO_UCI_XPATH_TOKENS_MAX, &token_count) != SRPO_UCI_ERR_OK) {
+		return false;
+	}
+
+	// every node of the request has to be on the path, and every requested key has to be there with the same value,
+	// key values of a template are only compared if they are constant
+	for (size_t r = 0; r < request_size;) {
+		if (t >= token_count || !xpath_token_name_equal(&request[r], &token_list[t])) {
+			return false;
+		}
+
+		for (key_first = ++t; t < token_count && token_list[t].type == SRPO_UCI_XPATH_TOKEN_KEY; t++)
+			;
+
+		for (r++; r < request_size && request[r].type == SRPO_UCI_XPATH_TOKEN_KEY; r++) {
+			const srpo_uci_xpath_token_t *key = NULL;
+
+			for (size_t k = key_first; k < t && key == NULL; k++) {
+				if (token_list[k].name_size == request[r].name_size && strncmp(token_list[k].name, request[r].name, request[r].name_size) == 0) {
+					key = &token_list[k];
+				}
+			}
+
+			if (key == NULL) {
+				return false;
+			}
+
+			if (template && xpath_token_placeholder(key)) {
+				// the requested value decides which UCI section the template is filled with
+				if (key->value_size == 2 && pinned) {
+					*pinned = &request[r];
+				}
+				continue;
+			}
+
+			if (!xpath_token_value_equal(key, &request[r])) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static srpo_uci_snapshot_t *subtree_snapshot_get(srpo_uci_ctx_t *ctx, srpo_uci_subtree_ctx_t *subtree_ctx, const char *uci_config, size_t *position, int *error)
+{
+	srpo_uci_snapshot_t *snapshot = NULL;
+
+	*error = SRPO_UCI_ERR_OK;
+
+	// every configuration is read from the same snapshot for the whole request
+	for (size_t i = 0; i < subtree_ctx->snapshots_size; i++) {
+		if (strcmp(subtree_ctx->snapshots[i]->name, uci_config) == 0) {
+			*position = i;
+			return subtree_ctx->snapshots[i];
+		}
+	}
+
+	*error = uci_context_snapshot_acquire(ctx, uci_config, &snapshot);
+	if (*error != SRPO_UCI_ERR_OK) {
+		return NULL;
+	}
+
+	subtree_ctx->snapshots = xrealloc(subtree_ctx->snapshots, sizeof(srpo_uci_snapshot_t *) * (subtree_ctx->snapshots_size + 1));
+	subtree_ctx->snapshots[subtree_ctx->snapshots_size] = snapshot;
+	*position = subtree_ctx->snapshots_size++;
+
+	return snapshot;
+}
+
+static void subtree_section_add(srpo_uci_subtree_ctx_t *subtree_ctx, size_t snapshot, const uci_index_t *index, const uci_index_section_t *section)
+{
+	subtree_ctx->sections = xrealloc(subtree_ctx->sections, sizeof(srpo_uci_subtree_section_t) * (subtree_ctx->sections_size + 1));
+	subtree_ctx->sections[subtree_ctx->sections_size++] = (srpo_uci_subtree_section_t){snapshot, (size_t) (section - index->sections)};
+}
+
+static int subtree_section_compare(const void *a, const void *b)
+{
+	const srpo_uci_subtree_section_t *section_a = a;
+	const srpo_uci_subtree_section_t *section_b = b;
+
+	if (section_a->snapshot != section_b->snapshot) {
+		return section_a->snapshot < section_b->snapshot ? -1 : 1;
+	}
+
+	return section_a->section < section_b->section ? -1 : section_a->section > section_b->section;
+}
+
+static int subtree_sections_collect(srpo_uci_ctx_t *ctx, srpo_uci_subtree_ctx_t *subtree_ctx, const srpo_uci_xpath_uci_template_map_t *entry, const srpo_uci_xpath_token_t *pinned)
+{
+	int error = SRPO_UCI_ERR_OK;
+	const char *template = entry->ucipath_template;
+	size_t config_size = strcspn(template, ".");
+	const char *section_template = template + config_size + 1;
+	size_t section_template_size = 0;
+	char *uci_config = NULL;
+	char *name = NULL;
+	char *type = NULL;
+	srpo_uci_snapshot_t *snapshot = NULL;
+	size_t snapshot_position = 0;
+	const uci_index_section_t *section = NULL;
+
+	// templates without a section have nothing to visit
+	if (template[config_size] != '.') {
+		return SRPO_UCI_ERR_OK;
+	}
+	section_template_size = strcspn(section_template, ".");
+
+	uci_config = scratch_strndup(template, config_size);
+	snapshot = subtree_snapshot_get(ctx, subtree_ctx, uci_config, &snapshot_position, &error);
+	if (snapshot == NULL) {
+		goto out;
+	}
+
+	if (entry->transform_path_cb == NULL && section_template_size == 2 && strncmp(section_template, "%s", 2) == 0 && pinned) {
+		// the section name comes from a key of the request, a single lookup in the names of the snapshot
+		name = scratch_malloc(pinned->value_size + 1);
+		srpo_uci_xpath_token_value_copy(pinned, name, pinned->value_size + 1);
+		section = uci_snapshot_named_section_get(snapshot, name);
+		if (section) {
+			subtree_section_add(subtree_ctx, snapshot_position, &snapshot->index, section);
+		}
+	} else if (entry->transform_path_cb == NULL && section_template[0] != '@' && strstr(template, "%s") == NULL) {
+		name = scratch_strndup(section_template, section_template_size);
+		section = uci_snapshot_named_section_get(snapshot, name);
+		if (section) {
+			subtree_section_add(subtree_ctx, snapshot_position, &snapshot->index, section);
+		}
+	} else {
+		// the section is not pinned by the request, only the sections of the mapped type are visited
+		if (section_template[0] == '@') {
+			type = scratch_strndup(section_template + 1, strcspn(section_template + 1, "[."));
+		} else if (entry->uci_section_type) {
+			type = scratch_strdup(entry->uci_section_type);
+		}
+
+		if (type) {
+			for (long i = 0; (section = uci_sections_get(&snapshot->sections, type, i)) != NULL; i++) {
+				subtree_section_add(subtree_ctx, snapshot_position, &snapshot->index, section);
+			}
+		} else {
+			for (size_t i = 0; i < snapshot->index.sections_size; i++) {
+				subtree_section_add(subtree_ctx, snapshot_position, &snapshot->index, &snapshot->index.sections[i]);
+			}
+		}
+	}
+
+out:
+	FREE_SAFE(uci_config);
+	FREE_SAFE(name);
+	FREE_SAFE(type);
+
+	return error;
+}
+
+static int subtree_node_cb(const char *ucipath, const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_subtree_ctx_t *subtree_ctx = private_data;
+	srpo_uci_xpath_uci_template_map_t *template_entry = NULL;
+	char *xpath = NULL;
+
+	template_entry = template_map_ucipath_entry_get(ucipath, subtree_ctx->export_ctx.template_map, subtree_ctx->export_ctx.template_map_size, &xpath, &error);
+	if (template_entry == NULL) {
+		return error == SRPO_UCI_ERR_NOT_FOUND ? SRPO_UCI_ERR_OK : error;
+	}
+
+	// sections of a type can hold list instances other than the requested one
+	if (subtree_xpath_match(subtree_ctx->request, subtree_ctx->request_size, xpath, false, NULL)) {
+		error = export_node_add(&subtree_ctx->export_ctx, xpath, index, option, template_entry);
+	}
+	FREE_SAFE(xpath);
+
+	return error;
+}
+
+int srpo_uci_handle_get_subtree(srpo_uci_handle_t *ctx, const struct ly_ctx *ly_ctx, const char *request_xpath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size,
+								void *private_data, struct lyd_node **tree)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_xpath_token_t request[SRPO_UCI_XPATH_TOKENS_MAX];
+	srpo_uci_subtree_ctx_t subtree_ctx = {0};
+	srpo_uci_xpath_uci_template_map_t *template_map = NULL;
+	size_t template_map_size = 0;
+	const srpo_uci_xpath_token_t *pinned = NULL;
+	srpo_path_buffer_t buffer;
+	uint64_t stats_start = stats_clock();
+
+	if (ly_ctx == NULL || request_xpath == NULL || uci_xpath_template_map == NULL || tree == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	error = srpo_uci_xpath_tokenize(request_xpath, request, SRPO_UCI_XPATH_TOKENS_MAX, &subtree_ctx.request_size);
+	if (error) {
+		return error;
+	}
+
+	path_buffer_init(&buffer);
+	subtree_ctx.request = request;
+	subtree_ctx.export_ctx.ly_ctx = ly_ctx;
+	subtree_ctx.export_ctx.tree = *tree;
+	subtree_ctx.export_ctx.private_data = private_data;
+
+	// only the templates at or below the requested node can produce a part of the answer, they also tell which
+	// sections hold it
+	template_map = xmalloc(sizeof(srpo_uci_xpath_uci_template_map_t) * (uci_xpath_template_map_size ? uci_xpath_template_map_size : 1));
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		pinned = NULL;
+		if (!subtree_xpath_match(request, subtree_ctx.request_size, uci_xpath_template_map[i].xpath_template, true, &pinned)) {
+			continue;
+		}
+
+		template_map[template_map_size++] = uci_xpath_template_map[i];
+		error = subtree_sections_collect(ctx, &subtree_ctx, &uci_xpath_template_map[i], pinned);
+		if (error) {
+			goto out;
+		}
+	}
+
+	subtree_ctx.export_ctx.template_map = template_map;
+	subtree_ctx.export_ctx.template_map_size = template_map_size;
+
+	// several templates usually map to the same section, every section is visited once
+	if (subtree_ctx.sections_size) {
+		qsort(subtree_ctx.sections, subtree_ctx.sections_size, sizeof(srpo_uci_subtree_section_t), subtree_section_compare);
+	}
+
+	for (size_t i = 0; i < subtree_ctx.sections_size; i++) {
+		const srpo_uci_subtree_section_t *position = &subtree_ctx.sections[i];
+		srpo_uci_snapshot_t *snapshot = subtree_ctx.snapshots[position->snapshot];
+
+		if (i && subtree_section_compare(position, &subtree_ctx.sections[i - 1]) == 0) {
+			continue;
+		}
+
+		error = ucipath_section_emit(snapshot->name, &snapshot->index, &snapshot->index.sections[position->section], &buffer, subtree_node_cb, &subtree_ctx);
+		if (error) {
+			goto out;
+		}
+	}
+
+out:
+	if (error && *tree == NULL && subtree_ctx.export_ctx.tree) {
+		lyd_free_withsiblings(subtree_ctx.export_ctx.tree);
+		subtree_ctx.export_ctx.tree = NULL;
+	}
+	*tree = subtree_ctx.export_ctx.tree;
+
+	for (size_t i = 0; i < subtree_ctx.snapshots_size; i++) {
+		uci_snapshot_put(subtree_ctx.snapshots[i]);
+	}
+	FREE_SAFE(subtree_ctx.snapshots);
+	FREE_SAFE(subtree_ctx.sections);
+	FREE_SAFE(template_map);
+	path_buffer_free(&buffer);
+	stats_record(SRPO_STATS_UCI_GET, stats_start, error);
+
+	return error;
+}
+
+static int diff_node_cb(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, uci_diff_op_t op, const char *old_value, const char *new_value, void *private_data)
+{
+	srpo_uci_diff_ctx_t *diff_ctx = private_data;
+	srpo_uci_diff_op_t diff_op = SRPO_UCI_DIFF_OP_ADD;
+	size_t sec_len = 0;
+
+	switch (op) {
+		case UCI_DIFF_ADD:
+			diff_op = SRPO_UCI_DIFF_OP_ADD;
+			break;
+		case UCI_DIFF_DELETE:
+			diff_op = SRPO_UCI_DIFF_OP_DELETE;
+			break;
+		case UCI_DIFF_MODIFY:
+			diff_op = SRPO_UCI_DIFF_OP_MODIFY;
+			break;
+	}
+
+	diff_ctx->list = option && option->list;
+	sec_len = ucipath_section_format(&diff_ctx->buffer, diff_ctx->uci_config, section);
+	if (option) {
+		path_buffer_format(&diff_ctx->buffer, sec_len, ".%s", option->name);
+	}
+
+	return diff_ctx->diff_cb(diff_ctx->buffer.data, diff_op, old_value, new_value, diff_ctx->private_data);
+}
+
+int srpo_uci_handle_diff(srpo_uci_handle_t *ctx, const char *uci_config, srpo_uci_diff_cb diff_cb, void *private_data)
+{
+	srpo_uci_diff_ctx_t diff_ctx = {0};
+
+	if (ctx == NULL || uci_config == NULL || diff_cb == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	diff_ctx.uci_config = uci_config;
+	diff_ctx.diff_cb = diff_cb;
+	diff_ctx.private_data = private_data;
+
+	return uci_context_diff(ctx, &diff_ctx);
+}
+
+int srpo_uci_handle_watch_start(srpo_uci_handle_t *ctx, sr_conn_ctx_t *connection, const srpo_uci_watch_config_t *watch_config_list, size_t watch_config_list_size, unsigned int debounce_ms, srpo_uci_watch_t **watch)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_watch_t *watch_tmp = NULL;
+
+	if (ctx == NULL || connection == NULL || watch_config_list == NULL || watch_config_list_size == 0 || watch == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	watch_tmp = xcalloc(1, sizeof(srpo_uci_watch_t));
+	watch_tmp->ctx = ctx;
+	watch_tmp->config_list = xcalloc(watch_config_list_size, sizeof(srpo_uci_watch_config_t));
+	memcpy(watch_tmp->config_list, watch_config_list, watch_config_list_size * sizeof(srpo_uci_watch_config_t));
+	watch_tmp->config_list_size = watch_config_list_size;
+	watch_tmp->pending = xcalloc(watch_config_list_size, sizeof(bool));
+	watch_tmp->debounce_ms = debounce_ms;
+	watch_tmp->inotify_fd = -1;
+	watch_tmp->stop_pipe[0] = watch_tmp->stop_pipe[1] = -1;
+
+	// sessions are not thread safe, the thread applies its changes with a session of its own
+	if (sr_session_start(connection, SR_DS_RUNNING, &watch_tmp->session) != SR_ERR_OK) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto error_out;
+	}
+
+	// read every package once so the diffs start at the current files
+	for (size_t i = 0; i < watch_config_list_size; i++) {
+		srpo_uci_diff_ctx_t diff_ctx = {.uci_config = watch_config_list[i].uci_config};
+
+		error = uci_context_diff(ctx, &diff_ctx);
+		if (error) {
+			goto error_out;
+		}
+	}
+
+	// uci and most tools replace the file with a rename, in place writes end with a close
+	watch_tmp->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch_tmp->inotify_fd < 0 || inotify_add_watch(watch_tmp->inotify_fd, ctx->config_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+		error = SRPO_UCI_ERR_DIRECTORY;
+		goto error_out;
+	}
+
+	if (pipe(watch_tmp->stop_pipe) != 0 || pthread_create(&watch_tmp->thread, NULL, uci_watch_thread, watch_tmp) != 0) {
+		error = SRPO_UCI_ERR_UCI;
+		goto error_out;
+	}
+
+	*watch = watch_tmp;
+
+	return SRPO_UCI_ERR_OK;
+
+error_out:
+	uci_watch_free(watch_tmp);
+
+	return error;
+}
+
+void srpo_uci_watch_stop(srpo_uci_watch_t *watch)
+{
+	ssize_t written = 0;
+
+	if (watch) {
+		// wake the thread up, it drops the pending changes and exits
+		do {
+			written = write(watch->stop_pipe[1], "", 1);
+		} while (written < 0 && errno == EINTR);
+
+		// closing the write end wakes the thread up as well, it is joined either way before the watch is freed
+		if (written != 1) {
+			close(watch->stop_pipe[1]);
+			watch->stop_pipe[1] = -1;
+		}
+		pthread_join(watch->thread, NULL);
+		uci_watch_free(watch);
+	}
+}
+
+int srpo_uci_handle_reload_start(srpo_uci_handle_t *ctx, const srpo_uci_reload_config_t *reload_config_list, size_t reload_config_list_size, unsigned int debounce_ms, srpo_uci_reload_t **reload)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_reload_t *reload_tmp = NULL;
+	pthread_condattr_t cond_attr;
+
+	if (ctx == NULL || (reload_config_list == NULL && reload_config_list_size) || reload == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	for (size_t i = 0; i < reload_config_list_size; i++) {
+		if (reload_config_list[i].uci_config == NULL || reload_config_list[i].lookup_path == NULL || reload_config_list[i].method == NULL) {
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	reload_tmp = xcalloc(1, sizeof(srpo_uci_reload_t));
+	reload_tmp->ctx = ctx;
+	if (reload_config_list_size) {
+		// the reload thread reads the strings until it is stopped, they are copied so the caller can free its list
+		reload_tmp->config_list = xcalloc(reload_config_list_size, sizeof(srpo_uci_reload_config_t));
+		for (size_t i = 0; i < reload_config_list_size; i++) {
+			reload_tmp->config_list[i].uci_config = xstrdup(reload_config_list[i].uci_config);
+			reload_tmp->config_list[i].lookup_path = xstrdup(reload_config_list[i].lookup_path);
+			reload_tmp->config_list[i].method = xstrdup(reload_config_list[i].method);
+			reload_tmp->config_list[i].json_call_arguments = reload_config_list[i].json_call_arguments ? xstrdup(reload_config_list[i].json_call_arguments) : NULL;
+			reload_tmp->config_list[i].timeout = reload_config_list[i].timeout;
+		}
+	}
+	reload_tmp->config_list_size = reload_config_list_size;
+	reload_tmp->debounce_ms = debounce_ms;
+	reload_tmp->requests_tail = &reload_tmp->requests;
+
+	// the window is measured on the same clock as the watcher debounce, wall clock jumps don't move it
+	pthread_mutex_init(&reload_tmp->lock, NULL);
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&reload_tmp->cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	if (pthread_create(&reload_tmp->thread, NULL, uci_reload_thread, reload_tmp) != 0) {
+		error = SRPO_UCI_ERR_UCI;
+		goto error_out;
+	}
+	reload_tmp->thread_started = true;
+
+	*reload = reload_tmp;
+
+	return SRPO_UCI_ERR_OK;
+
+error_out:
+	uci_reload_free(reload_tmp);
+
+	return error;
+}
+
+int srpo_uci_commit_reload(srpo_uci_reload_t *reload, const char *uci_config, srpo_uci_reload_cb reload_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_reload_request_t *request = NULL;
+
+	if (reload == NULL || uci_config == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	error = srpo_uci_handle_commit(reload->ctx, uci_config);
+	if (error) {
+		return error;
+	}
+
+	request = xcalloc(1, sizeof(srpo_uci_reload_request_t));
+	request->uci_config = xstrdup(uci_config);
+	request->reload_cb = reload_cb;
+	request->private_data = private_data;
+
+	pthread_mutex_lock(&reload->lock);
+	if (reload->requests == NULL) {
+		// later commits don't push the reload back, a steady stream of edits is applied at least once per window
+		clock_gettime(CLOCK_MONOTONIC, &reload->deadline);
+		reload->deadline.tv_sec += reload->debounce_ms / 1000;
+		reload->deadline.tv_nsec += (long) (reload->debounce_ms % 1000) * 1000000;
+		if (reload->deadline.tv_nsec >= 1000000000) {
+			reload->deadline.tv_sec++;
+			reload->deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_signal(&reload->cond);
+	}
+	*reload->requests_tail = request;
+	reload->requests_tail = &request->next;
+	pthread_mutex_unlock(&reload->lock);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+void srpo_uci_reload_stop(srpo_uci_reload_t *reload)
+{
+	if (reload) {
+		// unlike the watcher the pending reloads are run, the configurations are already commited
+		pthread_mutex_lock(&reload->lock);
+		reload->stop = true;
+		pthread_cond_signal(&reload->cond);
+		pthread_mutex_unlock(&reload->lock);
+
+		uci_reload_free(reload);
+	}
+}
+
+int srpo_uci_xpath_to_ucipath_convert(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, char **ucipath)
+{
+	char *ucipath_tmp = NULL;
+	int error = SR_ERR_OK;
+	uint64_t stats_start = 0;
+
+	if (xpath == NULL || ucipath == NULL || xpath_uci_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	*ucipath = NULL;
+	stats_start = stats_clock();
+	TRACE2(xpath_to_ucipath_convert_entry, xpath, xpath_uci_template_map_size);
+
+	// find the table entry that matches the xpath for the found xpath list key
+	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
+		error = srpo_uci_path_get(xpath,
+								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
+								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			continue;
+		} else if (error == SR_ERR_OK) {
+			break;
+		} else {
+			error = SRPO_UCI_ERR_ARGUMENT;
+			goto out;
+		}
+	}
+
+	*ucipath = ucipath_tmp;
+	error = *ucipath ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_NOT_FOUND;
+
+out:
+	// the linear search is the whole conversion
+	stats_record(SRPO_STATS_UCI_TEMPLATE_SCAN, stats_start, error);
+	stats_record(SRPO_STATS_UCI_PATH_CONVERT, stats_start, error);
+	TRACE3(xpath_to_ucipath_convert_return, xpath, *ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_ucipath_to_xpath_convert(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, char **xpath)
+{
+	char *xpath_tmp = NULL;
+	int error = SR_ERR_OK;
+	uint64_t stats_start = 0;
+
+	if (ucipath == NULL || xpath == NULL || uci_xpath_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	*xpath = xpath_tmp;
+	stats_start = stats_clock();
+	TRACE2(ucipath_to_xpath_convert_entry, ucipath, uci_xpath_template_map_size);
+
+	// find the table entry that matches the uci path for the found uci section
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		error = srpo_uci_path_get(ucipath,
+								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
+								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			continue;
+		} else if (error == SR_ERR_OK) {
+			break;
+		} else {
+			error = SRPO_UCI_ERR_ARGUMENT;
+			goto out;
+		}
+	}
+
+	*xpath = xpath_tmp;
+	error = *xpath ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_NOT_FOUND;
+
+out:
+	// the linear search is the whole conversion
+	stats_record(SRPO_STATS_UCI_TEMPLATE_SCAN, stats_start, error);
+	stats_record(SRPO_STATS_UCI_PATH_CONVERT, stats_start, error);
+	TRACE3(ucipath_to_xpath_convert_return, ucipath, *xpath, error);
+
+	return error;
+}
+
+int srpo_uci_xpath_to_ucipath_indexed_convert(const char *xpath, const srpo_uci_template_index_t *index, srpo_uci_xpath_uci_template_map_t **entry, char **ucipath)
+{
+	int error = SRPO_UCI_ERR_OK;
+	uint64_t stats_start = 0;
+
+	if (xpath == NULL || index == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	stats_start = stats_clock();
+	TRACE2(xpath_to_ucipath_indexed_convert_entry, xpath, index->map_size);
+	error = template_index_convert(xpath, index, SRPO_UCI_PATH_DIRECTION_UCI, entry, ucipath);
+	stats_record(SRPO_STATS_UCI_PATH_CONVERT, stats_start, error);
+	TRACE3(xpath_to_ucipath_indexed_convert_return, xpath, error ? NULL : *ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_ucipath_to_xpath_indexed_convert(const char *ucipath, const srpo_uci_template_index_t *index, srpo_uci_xpath_uci_template_map_t **entry, char **xpath)
+{
+	int error = SRPO_UCI_ERR_OK;
+	uint64_t stats_start = 0;
+
+	if (ucipath == NULL || index == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	stats_start = stats_clock();
+	TRACE2(ucipath_to_xpath_indexed_convert_entry, ucipath, index->map_size);
+	error = template_index_convert(ucipath, index, SRPO_UCI_PATH_DIRECTION_XPATH, entry, xpath);
+	stats_record(SRPO_STATS_UCI_PATH_CONVERT, stats_start, error);
+	TRACE3(ucipath_to_xpath_indexed_convert_return, ucipath, error ? NULL : *xpath, error);
+
+	return error;
+}
+
+int srpo_uci_path_get(const char *target, const char *from_template, const char *to_template, srpo_uci_transform_path_cb transform_path_cb, srpo_uci_path_direction_t direction, char **path)
+{
+	int error = SRPO_UCI_ERR_ARGUMENT;
+	srpo_uci_xpath_token_t token_list[SRPO_UCI_XPATH_TOKENS_MAX];
+	size_t token_count = 0;
+	const srpo_uci_xpath_token_t *key = NULL;
+	const char *path_key = NULL;
+	size_t path_key_size = 0;
+	char *path_key_value = NULL;
+
+	if (from_template == NULL || to_template == NULL) {
+		goto cleanup;
+	}
+
+	/* redirect to custom path handler */
+	if (transform_path_cb) {
+		error = transform_path_cb(target, from_template, to_template, direction, path);
+		goto cleanup;
+	}
+
+	/* assume simple path constructor */
+	if (direction == SRPO_UCI_PATH_DIRECTION_XPATH) {
+		path_key_value = srpo_uci_section_name_get(target);
+	} else if (direction == SRPO_UCI_PATH_DIRECTION_UCI) {
+		if (srpo_uci_xpath_tokenize(target, token_list, SRPO_UCI_XPATH_TOKENS_MAX, &token_count) == SRPO_UCI_ERR_OK) {
+			key = srpo_uci_xpath_key_get(token_list, token_count, 1);
+		}
+
+		// a key without doubled quotes is compared in place and only copied if the template matches
+		if (key && memchr(key->value, key->quote, key->value_size) == NULL) {
+			path_key = key->value;
+			path_key_size = key->value_size;
+		} else if (key) {
+			path_key_value = srpo_uci_xpath_key_value_get(target, 1);
+		}
+	}
+
+	if (path_key_value) {
+		path_key = path_key_value;
+		path_key_size = strlen(path_key_value);
+	}
+
+	if (path_template_match(target, from_template, path_key ? path_key : "", path_key_size)) {
+		if (path_key && path_key_value == NULL) {
+			path_key_value = scratch_strndup(path_key, path_key_size);
+		}
+		*path = path_from_template_get(to_template, path_key_value);
+
+		error = SRPO_UCI_ERR_OK;
+		goto cleanup;
+	}
+
+	error = SRPO_UCI_ERR_NOT_FOUND;
+
+cleanup:
+	FREE_SAFE(path_key_value);
+
+	return error;
+}
+
+int srpo_uci_transform_sysrepo_data_cb_get(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, srpo_uci_transform_data_cb *transform_sysrepo_data_cb)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_transform_data_cb transform_sysrepo_data_cb_tmp = NULL;
+	char *ucipath_tmp = NULL;
+
+	if (xpath == NULL || xpath_uci_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	// find the table entry that matches the xpath for the found xpath list key
+	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
+		error = srpo_uci_path_get(xpath,
+								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
+								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			FREE_SAFE(ucipath_tmp);
+			continue;
+		} else if (error == SRPO_UCI_ERR_OK) {
+			transform_sysrepo_data_cb_tmp = xpath_uci_template_map[i].transform_sysrepo_data_cb;
+			break;
+		} else {
+			FREE_SAFE(ucipath_tmp);
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*transform_sysrepo_data_cb = transform_sysrepo_data_cb_tmp;
+
+	FREE_SAFE(ucipath_tmp);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+int srpo_uci_transform_uci_data_cb_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, srpo_uci_transform_data_cb *transform_uci_data_cb)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_transform_data_cb transform_uci_data_cb_tmp = NULL;
+	char *xpath_tmp = NULL;
+
+	if (ucipath == NULL || uci_xpath_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	// find the table entry that matches the uci path for the found uci section
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		error = srpo_uci_path_get(ucipath,
+								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
+								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			FREE_SAFE(xpath_tmp);
+			continue;
+		} else if (error == SR_ERR_OK) {
+			transform_uci_data_cb_tmp = uci_xpath_template_map[i].transform_uci_data_cb;
+			break;
+		} else {
+			FREE_SAFE(xpath_tmp);
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*transform_uci_data_cb = transform_uci_data_cb_tmp;
+
+	FREE_SAFE(xpath_tmp);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+int srpo_uci_section_type_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, const char **uci_section_type)
+{
+	int error = SRPO_UCI_ERR_OK;
+	const char *uci_section_type_tmp = NULL;
+	char *xpath_tmp = NULL;
+
+	if (ucipath == NULL || uci_xpath_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	// find the table entry that matches the uci path for the found uci section
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		error = srpo_uci_path_get(ucipath,
+								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
+								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			continue;
+		} else if (error == SR_ERR_OK) {
+			uci_section_type_tmp = uci_xpath_template_map[i].uci_section_type;
+			break;
+		} else {
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*uci_section_type = uci_section_type_tmp;
+
+	FREE_SAFE(xpath_tmp);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+int srpo_uci_has_transform_sysrepo_data_private_get(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, bool *has_transform_sysrepo_data_private)
+{
+	int error = SRPO_UCI_ERR_OK;
+	bool has_transform_sysrepo_data_private_tmp = false;
+	char *ucipath_tmp = NULL;
+
+	if (xpath == NULL || xpath_uci_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	// find the table entry that matches the xpath for the found xpath list key
+	for (size_t i = 0; i < xpath_uci_template_map_size; i++) {
+		error = srpo_uci_path_get(xpath,
+								  xpath_uci_template_map[i].xpath_template, xpath_uci_template_map[i].ucipath_template,
+								  xpath_uci_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_UCI, &ucipath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			FREE_SAFE(ucipath_tmp);
+			continue;
+		} else if (error == SRPO_UCI_ERR_OK) {
+			has_transform_sysrepo_data_private_tmp = xpath_uci_template_map[i].has_transform_sysrepo_data_private;
+			break;
+		} else {
+			FREE_SAFE(ucipath_tmp);
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*has_transform_sysrepo_data_private = has_transform_sysrepo_data_private_tmp;
+
+	FREE_SAFE(ucipath_tmp);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+int srpo_uci_has_transform_uci_data_private_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, bool *has_transform_uci_data_private)
+{
+	int error = SRPO_UCI_ERR_OK;
+	bool has_transform_uci_data_private_tmp = false;
+	char *xpath_tmp = NULL;
+
+	if (ucipath == NULL || uci_xpath_template_map == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	// find the table entry that matches the uci path for the found uci section
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		error = srpo_uci_path_get(ucipath,
+								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
+								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			FREE_SAFE(xpath_tmp);
+			continue;
+		} else if (error == SR_ERR_OK) {
+			has_transform_uci_data_private_tmp = uci_xpath_template_map[i].has_transform_uci_data_private;
+			break;
+		} else {
+			FREE_SAFE(xpath_tmp);
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*has_transform_uci_data_private = has_transform_uci_data_private_tmp;
+
+	FREE_SAFE(xpath_tmp);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+char *srpo_uci_section_name_get(const char *ucipath)
+{
+	int error = 0;
+	srpo_uci_path_t uci_path;
+	char *value_tmp = NULL;
+
+	uci_path_init(&uci_path);
+
+	error = uci_path_parse(&uci_path, ucipath);
+
+	if (error)
+		goto out;
+
+	// check for empty section
+	if (!uci_path.section) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	value_tmp = xstrdup(uci_path.section);
+
+out:
+	uci_path_free(&uci_path);
+
+	return value_tmp;
+}
+
+char *srpo_uci_xpath_key_value_get(const char *xpath, int level)
+{
+	srpo_uci_xpath_token_t token_list[SRPO_UCI_XPATH_TOKENS_MAX];
+	size_t token_count = 0;
+	const srpo_uci_xpath_token_t *key = NULL;
+	char *xpath_key_value = NULL;
+
+	if (xpath == NULL || srpo_uci_xpath_tokenize(xpath, token_list, SRPO_UCI_XPATH_TOKENS_MAX, &token_count) != SRPO_UCI_ERR_OK) {
+		return NULL;
+	}
+
+	key = srpo_uci_xpath_key_get(token_list, token_count, level);
+	if (key) {
+		xpath_key_value = xmalloc(key->value_size + 1);
+		srpo_uci_xpath_token_value_copy(key, xpath_key_value, key->value_size + 1);
+	}
+
+	return xpath_key_value;
+}
+
+int srpo_uci_xpath_tokenize(const char *xpath, srpo_uci_xpath_token_t *token_list, size_t token_list_size, size_t *token_count)
+{
+	const char *ptr = xpath;
+	srpo_uci_xpath_token_t token = {0};
+	size_t count = 0;
+
+	if (xpath == NULL || token_count == NULL || (token_list == NULL && token_list_size)) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	*token_count = 0;
+
+	while (*ptr) {
+		while (*ptr == '/') {
+			ptr++;
+		}
+		if (*ptr == '\0') {
+			break;
+		}
+
+		token = (srpo_uci_xpath_token_t){.type = SRPO_UCI_XPATH_TOKEN_NODE, .name = ptr, .name_size = strcspn(ptr, "/[")};
+		ptr += token.name_size;
+		xpath_token_add(token_list, token_list_size, &count, &token);
+
+		while (*ptr == '[') {
+			token = (srpo_uci_xpath_token_t){.type = SRPO_UCI_XPATH_TOKEN_KEY};
+
+			ptr = xpath_blank_skip(ptr + 1);
+			token.name = ptr;
+			token.name_size = strcspn(ptr, "=] \t");
+			ptr = xpath_blank_skip(ptr + token.name_size);
+
+			// positional predicates carry no key
+			if (*ptr == ']') {
+				ptr++;
+				continue;
+			}
+
+			if (*ptr != '=') {
+				return SRPO_UCI_ERR_ARGUMENT;
+			}
+
+			ptr = xpath_blank_skip(ptr + 1);
+			if (*ptr != '\'' && *ptr != '"') {
+				return SRPO_UCI_ERR_ARGUMENT;
+			}
+			token.quote = *ptr++;
+			token.value = ptr;
+
+			// the value ends at the first quote that is not doubled, it can contain '/', '[' and ']'
+			for (ptr = strchr(ptr, token.quote); ptr && ptr[1] == token.quote; ptr = strchr(ptr + 2, token.quote))
+				;
+			if (ptr == NULL) {
+				return SRPO_UCI_ERR_ARGUMENT;
+			}
+			token.value_size = (size_t) (ptr - token.value);
+
+			ptr = xpath_blank_skip(ptr + 1);
+			if (*ptr != ']') {
+				return SRPO_UCI_ERR_ARGUMENT;
+			}
+			ptr++;
+
+			xpath_token_add(token_list, token_list_size, &count, &token);
+		}
+
+		if (*ptr != '\0' && *ptr != '/') {
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+	}
+
+	*token_count = count;
+
+	// the count tells the caller how large the list needs to be
+	return count > token_list_size ? SRPO_UCI_ERR_ARGUMENT : SRPO_UCI_ERR_OK;
+}
+
+const srpo_uci_xpath_token_t *srpo_uci_xpath_key_get(const srpo_uci_xpath_token_t *token_list, size_t token_count, int level)
+{
+	int xpath_level = 0;
+
+	if (token_list == NULL) {
+		return NULL;
+	}
+
+	// levels count the keys from the start of the XPath
+	for (size_t i = 0; i < token_count; i++) {
+		if (token_list[i].type == SRPO_UCI_XPATH_TOKEN_KEY && ++xpath_level >= level) {
+			return &token_list[i];
+		}
+	}
+
+	return NULL;
+}
+
+size_t srpo_uci_xpath_token_value_copy(const srpo_uci_xpath_token_t *token, char *buffer, size_t buffer_size)
+{
+	size_t size = 0;
+
+	if (token == NULL || token->value == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < token->value_size; i++) {
+		if (size + 1 < buffer_size) {
+			buffer[size] = token->value[i];
+		}
+		size++;
+
+		if (token->value[i] == token->quote) {
+			i++;
+		}
+	}
+
+	if (buffer_size) {
+		buffer[size < buffer_size ? size : buffer_size - 1] = '\0';
+	}
+
+	return size;
+}
+
+static const char *xpath_blank_skip(const char *ptr)
+{
+	return ptr + strspn(ptr, " \t");
+}
+
+static void xpath_token_add(srpo_uci_xpath_token_t *token_list, size_t token_list_size, size_t *count, const srpo_uci_xpath_token_t *token)
+{
+	if (*count < token_list_size) {
+		token_list[*count] = *token;
+	}
+	(*count)++;
+}
+
+int srpo_uci_handle_section_create(srpo_uci_handle_t *ctx, const char *ucipath, const char *uci_section_type)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uci2_n_t *last_type = NULL;
+	uci2_n_t *section_node = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	if (uci_section_type == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE2(section_create_entry, ucipath, uci_section_type);
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error || !uci_path.package) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	last_type = uci_get_last_type(UCI2_CFG_ROOT(package->working), uci_section_type);
+
+	if (!last_type) {
+		error = SRPO_UCI_ERR_UCI;
+		goto out;
+	}
+
+	section_node = uci2_add_S(package->working, last_type, uci_path.section);
+	if (section_node) {
+		uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_ADD, section_node, last_type, NULL);
+		// the new section goes to the last type node, so it is the last section of its type
+		if (package->sections_valid) {
+			uci_sections_append(&package->sections, last_type->name, section_node);
+		}
+	}
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(section_create_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_section_delete(srpo_uci_handle_t *ctx, const char *ucipath)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uci2_n_t *lookup_node = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE1(section_delete_entry, ucipath);
+
+	error = uci_path_parse(&uci_path, ucipath);
+
+	if (error) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	if (!uci_path.section || !uci_path.package) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, NULL, NULL);
+
+	if (!lookup_node) {
+		// no such node found
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	// the sections behind the deleted one move up a position
+	if (package->sections_valid) {
+		uci_sections_remove(&package->sections, lookup_node->nt == UCI2_NT_TYPE ? lookup_node->name : lookup_node->parent->name, lookup_node);
+	}
+
+	uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_DELETE, lookup_node, lookup_node->parent, NULL);
+	uci2_del(lookup_node);
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(section_delete_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_option_set(srpo_uci_handle_t *ctx, const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	char *transform_value = NULL;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uci2_n_t *lookup_node = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	if (value == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE2(option_set_entry, ucipath, value);
+
+	transform_value = transform_sysrepo_data_cb ? transform_sysrepo_data_cb(value, private_data) : scratch_strdup(value);
+	if (transform_value == NULL) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	uci_path_parse(&uci_path, ucipath);
+	if (!uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, NULL);
+
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_VALUE_CHANGE, lookup_node, lookup_node->parent, lookup_node->value);
+	uci2_change_value(lookup_node, transform_value);
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	FREE_SAFE(transform_value);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(option_set_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_option_remove(srpo_uci_handle_t *ctx, const char *ucipath)
+{
+	int error = 0;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uci2_n_t *lookup_node = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE1(option_remove_entry, ucipath);
+
+	error = uci_path_parse(&uci_path, ucipath);
+
+	if (error) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	if (!uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, NULL);
+
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_DELETE, lookup_node, lookup_node->parent, NULL);
+	uci2_del(lookup_node);
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(option_remove_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_list_set(srpo_uci_handle_t *ctx, const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	char *transform_value = NULL;
+	uci2_n_t *lookup_node = NULL;
+	uci2_n_t *list_item_node = NULL;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	if (value == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE2(list_set_entry, ucipath, value);
+
+	transform_value = transform_sysrepo_data_cb ? transform_sysrepo_data_cb(value, private_data) : scratch_strdup(value);
+	if (transform_value == NULL) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	if (!uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, NULL);
+
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	list_item_node = uci2_add_I(package->working, lookup_node, transform_value);
+	if (list_item_node) {
+		uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_ADD, list_item_node, lookup_node, NULL);
+	}
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	FREE_SAFE(transform_value);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(list_set_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_list_batch_set(srpo_uci_handle_t *ctx, const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_arena_t arena = {0};
+	const char **transform_values = NULL;
+	size_t transform_values_size = 0;
+	uci2_n_t *lookup_node = NULL;
+	uci2_n_t *list_item_node = NULL;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+	arena_init(&arena.arena, SRPO_UCI_ARENA_CHUNK_SIZE);
+
+	if (ucipath == NULL || (values == NULL && values_size)) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE2(list_batch_set_entry, ucipath, values_size);
+
+	// all values are transformed before the package is locked
+	error = uci_values_batch_transform(values, values_size, transform_sysrepo_data_batch_cb, private_data, &arena, &transform_values, &transform_values_size);
+	if (error) {
+		goto out;
+	}
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error || !uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, NULL);
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	for (size_t i = 0; i < transform_values_size; i++) {
+		list_item_node = uci2_add_I(package->working, lookup_node, (char *) transform_values[i]);
+		if (list_item_node) {
+			uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_ADD, list_item_node, lookup_node, NULL);
+		}
+	}
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	arena_free(&arena.arena);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(list_batch_set_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_list_remove(srpo_uci_handle_t *ctx, const char *ucipath, const char *value)
+{
+	int error = SRPO_UCI_ERR_OK;
+	uci2_n_t *lookup_node = NULL;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	if (value == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE2(list_remove_entry, ucipath, value);
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	if (!uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, value);
+
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_DELETE, lookup_node, lookup_node->parent, NULL);
+	uci2_del(lookup_node);
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(list_remove_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_list_replace(srpo_uci_handle_t *ctx, const char *ucipath, const char **values, size_t values_size, bool ordered, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	return uci_list_update(ctx, ucipath, values, values_size, SRPO_UCI_LIST_UPDATE_REPLACE, ordered, transform_sysrepo_data_batch_cb, private_data);
+}
+
+int srpo_uci_handle_list_bulk_add(srpo_uci_handle_t *ctx, const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data)
+{
+	return uci_list_update(ctx, ucipath, values, values_size, SRPO_UCI_LIST_UPDATE_ADD, false, transform_sysrepo_data_batch_cb, private_data);
+}
+
+int srpo_uci_handle_list_bulk_remove(srpo_uci_handle_t *ctx, const char *ucipath, const char **values, size_t values_size)
+{
+	return uci_list_update(ctx, ucipath, values, values_size, SRPO_UCI_LIST_UPDATE_REMOVE, false, NULL, NULL);
+}
+
+static int uci_list_update(srpo_uci_ctx_t *ctx, const char *ucipath, const char **values, size_t values_size, srpo_uci_list_update_t update, bool ordered, srpo_uci_transform_data_batch_cb batch_cb, void *private_data)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_arena_t arena = {0};
+	const char **transform_values = NULL;
+	size_t transform_values_size = 0;
+	const char **unique_values = NULL;
+	size_t unique_values_size = 0;
+	size_t unique_values_matched = 0;
+	str_set_t value_set = {0};
+	str_set_t item_set = {0};
+	uci2_n_t *lookup_node = NULL;
+	uci2_n_t *list_item_node = NULL;
+	srpo_uci_path_t uci_path;
+	srpo_uci_package_t *package = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+	arena_init(&arena.arena, SRPO_UCI_ARENA_CHUNK_SIZE);
+
+	if (ucipath == NULL || (values == NULL && values_size)) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	TRACE3(list_update_entry, ucipath, values_size, (int) update);
+
+	// all values are transformed before the package is locked
+	error = uci_values_batch_transform(values, values_size, batch_cb, private_data, &arena, &transform_values, &transform_values_size);
+	if (error) {
+		goto out;
+	}
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error || !uci_path.package || !uci_path.section || !uci_path.option) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	// the values are a set, only the first of duplicate values counts
+	unique_values = arena_alloc(&arena.arena, (transform_values_size ? transform_values_size : 1) * sizeof(char *));
+	str_set_init(&value_set, transform_values_size);
+	for (size_t i = 0; i < transform_values_size; i++) {
+		if (str_set_add(&value_set, transform_values[i])) {
+			unique_values[unique_values_size++] = transform_values[i];
+		}
+	}
+
+	error = uci_context_package_acquire(ctx, uci_path.package, &package);
+	if (error) {
+		goto out;
+	}
+
+	lookup_node = uci_package_node_get(package, &uci_path, uci_path.option, NULL);
+	if (!lookup_node) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	str_set_init(&item_set, (size_t) uci2_nc(lookup_node));
+
+	// one pass over the list items decides which of them stay, items deleted earlier have no parent
+	for (int i = 0; i < uci2_nc(lookup_node); i++) {
+		uci2_n_t *item = lookup_node->ch[i];
+		bool keep = true;
+
+		if (item->parent != lookup_node) {
+			continue;
+		}
+
+		switch (update) {
+			case SRPO_UCI_LIST_UPDATE_REPLACE:
+				if (!str_set_contains(&value_set, item->name) || !str_set_add(&item_set, item->name)) {
+					// not wanted anymore or a duplicate of an earlier item
+					keep = false;
+				} else if (ordered) {
+					// items can only be appended, so the kept items have to be the leading values in their order,
+					// an item out of order is deleted and appended again at its place
+					keep = unique_values_matched < unique_values_size && strcmp(unique_values[unique_values_matched], item->name) == 0;
+					if (keep) {
+						unique_values_matched++;
+					}
+				}
+				break;
+			case SRPO_UCI_LIST_UPDATE_ADD:
+				str_set_add(&item_set, item->name);
+				break;
+			case SRPO_UCI_LIST_UPDATE_REMOVE:
+				keep = !str_set_contains(&value_set, item->name);
+				break;
+		}
+
+		if (!keep) {
+			uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_DELETE, item, lookup_node, NULL);
+			uci2_del(item);
+		}
+	}
+
+	if (update == SRPO_UCI_LIST_UPDATE_REMOVE) {
+		goto out;
+	}
+
+	for (size_t i = ordered ? unique_values_matched : 0; i < unique_values_size; i++) {
+		if (!ordered && str_set_contains(&item_set, unique_values[i])) {
+			continue;
+		}
+
+		list_item_node = uci2_add_I(package->working, lookup_node, (char *) unique_values[i]);
+		if (list_item_node) {
+			uci_journal_append(&package->journal, SRPO_UCI_JOURNAL_NODE_ADD, list_item_node, lookup_node, NULL);
+		}
+	}
+
+out:
+	if (package) {
+		uci_context_package_release(package);
+	}
+	uci_path_free(&uci_path);
+	str_set_free(&value_set);
+	str_set_free(&item_set);
+	arena_free(&arena.arena);
+	stats_record(SRPO_STATS_UCI_SET, stats_start, error);
+	TRACE2(list_update_return, ucipath, error);
+
+	return error;
+}
+
+int srpo_uci_handle_element_value_get(srpo_uci_handle_t *ctx, const char *ucipath, srpo_uci_transform_data_cb transform_uci_data_cb, void *private_data, char ***value_list, size_t *value_list_size)
+{
+	int error = 0;
+	srpo_uci_path_t uci_path;
+	srpo_uci_snapshot_t *snapshot = NULL;
+	const uci_index_section_t *uci_section = NULL;
+	const uci_index_option_t *uci_option = NULL;
+	const char *value = NULL;
+	struct {
+		char **list;
+		size_t size;
+	} val_list = {0, 0};
+	uint64_t stats_start = stats_clock();
+
+	*value_list = NULL;
+	*value_list_size = 0;
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	// there needs to be an options which is wanted -> no option == noting to return
+	if (uci_path.package && uci_path.section && uci_path.option) {
+		error = uci_context_snapshot_acquire(ctx, uci_path.package, &snapshot);
+		if (error) {
+			goto out;
+		}
+
+		// named section match
+		uci_section = uci_snapshot_section_find(snapshot, &uci_path);
+		if (uci_section == NULL) {
+			error = SRPO_UCI_ERR_NOT_FOUND;
+			goto out;
+		}
+
+		// option name match
+		uci_option = uci_index_option_find(&snapshot->index, uci_section, uci_path.option);
+		if (uci_option == NULL) {
+			error = SRPO_UCI_ERR_NOT_FOUND;
+			goto out;
+		}
+
+		// gather all values, an option has exactly one
+		for (size_t i = uci_option->value_first; i < uci_option->value_first + uci_option->value_count; i++) {
+			value = snapshot->index.values[i];
+			val_list.list = xrealloc(val_list.list, sizeof(char *) * (++val_list.size));
+			val_list.list[val_list.size - 1] = transform_uci_data_cb ? transform_uci_data_cb(value, private_data) : xstrdup(value);
+		}
+	} else if (uci_path.package && uci_path.section) {
+		val_list.list = xrealloc(val_list.list, sizeof(char *) * (++val_list.size));
+		val_list.list[val_list.size - 1] = xstrdup("");
+	} else {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	*value_list = val_list.list;
+	*value_list_size = val_list.size;
+out:
+	uci_snapshot_put(snapshot);
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_GET, stats_start, error);
+
+	return error;
+}
+
+int srpo_uci_handle_element_value_batch_get(srpo_uci_handle_t *ctx, const char *ucipath, srpo_uci_transform_data_batch_cb transform_uci_data_batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***value_list, size_t *value_list_size)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_path_t uci_path;
+	srpo_uci_snapshot_t *snapshot = NULL;
+	const uci_index_section_t *uci_section = NULL;
+	const uci_index_option_t *uci_option = NULL;
+	uint64_t stats_start = stats_clock();
+
+	uci_path_init(&uci_path);
+
+	if (ucipath == NULL || arena == NULL || value_list == NULL || value_list_size == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	*value_list = NULL;
+	*value_list_size = 0;
+
+	error = uci_path_parse(&uci_path, ucipath);
+	if (error || !uci_path.package || !uci_path.section) {
+		error = SRPO_UCI_ERR_ARGUMENT;
+		goto out;
+	}
+
+	// a section has no value of its own
+	if (uci_path.option == NULL) {
+		*value_list = arena_alloc(&arena->arena, sizeof(char *));
+		(*value_list)[0] = "";
+		*value_list_size = 1;
+		goto out;
+	}
+
+	error = uci_context_snapshot_acquire(ctx, uci_path.package, &snapshot);
+	if (error) {
+		goto out;
+	}
+
+	uci_section = uci_snapshot_section_find(snapshot, &uci_path);
+	uci_option = uci_section ? uci_index_option_find(&snapshot->index, uci_section, uci_path.option) : NULL;
+	if (uci_option == NULL) {
+		error = SRPO_UCI_ERR_NOT_FOUND;
+		goto out;
+	}
+
+	// the values of an option are adjacent in the snapshot and go to the callback as they are
+	error = uci_values_batch_transform(&snapshot->index.values[uci_option->value_first], uci_option->value_count, transform_uci_data_batch_cb, private_data, arena, value_list, value_list_size);
+	if (error) {
+		goto out;
+	}
+
+	// borrowed values stay valid until the arena is reset, even if the configuration is commited meanwhile
+	uci_arena_pin(arena, snapshot);
+	snapshot = NULL;
+
+out:
+	uci_snapshot_put(snapshot);
+	uci_path_free(&uci_path);
+	stats_record(SRPO_STATS_UCI_GET, stats_start, error);
+
+	return error;
+}
+
+int srpo_uci_arena_init(srpo_uci_arena_t **arena)
+{
+	if (arena == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	*arena = xcalloc(1, sizeof(srpo_uci_arena_t));
+	arena_init(&(*arena)->arena, SRPO_UCI_ARENA_CHUNK_SIZE);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+char *srpo_uci_arena_strdup(srpo_uci_arena_t *arena, const char *value)
+{
+	if (arena == NULL || value == NULL) {
+		return NULL;
+	}
+
+	return arena_strndup(&arena->arena, value, strlen(value));
+}
+
+void srpo_uci_arena_reset(srpo_uci_arena_t *arena)
+{
+	if (arena) {
+		uci_arena_unpin(arena);
+		arena_reset(&arena->arena);
+	}
+}
+
+void srpo_uci_arena_cleanup(srpo_uci_arena_t *arena)
+{
+	if (arena) {
+		uci_arena_unpin(arena);
+		arena_free(&arena->arena);
+		xfree(arena);
+	}
+}
+
+static void uci_arena_pin(srpo_uci_arena_t *arena, srpo_uci_snapshot_t *snapshot)
+{
+	srpo_uci_arena_pin_t *pin = NULL;
+
+	// a snapshot pinned by an earlier call only needs the one reference
+	for (pin = arena->pins; pin; pin = pin->next) {
+		if (pin->snapshot == snapshot) {
+			uci_snapshot_put(snapshot);
+			return;
+		}
+	}
+
+	pin = arena_alloc(&arena->arena, sizeof(srpo_uci_arena_pin_t));
+	pin->snapshot = snapshot;
+	pin->next = arena->pins;
+	arena->pins = pin;
+}
+
+static void uci_arena_unpin(srpo_uci_arena_t *arena)
+{
+	for (srpo_uci_arena_pin_t *pin = arena->pins; pin; pin = pin->next) {
+		uci_snapshot_put(pin->snapshot);
+	}
+
+	arena->pins = NULL;
+}
+
+static int uci_values_batch_transform(const char **values, size_t values_size, srpo_uci_transform_data_batch_cb batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***transformed_values, size_t *transformed_values_size)
+{
+	int error = SRPO_UCI_ERR_OK;
+	const char **transformed_values_tmp = NULL;
+	size_t transformed_values_size_tmp = 0;
+
+	transformed_values_tmp = arena_alloc(&arena->arena, (values_size ? values_size : 1) * sizeof(char *));
+
+	if (values_size == 0) {
+		goto out;
+	}
+
+	// without a callback the values are borrowed as they are
+	if (batch_cb == NULL) {
+		memcpy(transformed_values_tmp, values, values_size * sizeof(char *));
+		transformed_values_size_tmp = values_size;
+		goto out;
+	}
+
+	memset(transformed_values_tmp, 0, values_size * sizeof(char *));
+	error = batch_cb(values, values_size, arena, transformed_values_tmp, private_data);
+	if (error) {
+		error = SRPO_UCI_ERR_TRANSFORM_CB;
+		goto out;
+	}
+
+	// values the callback dropped are left out
+	for (size_t i = 0; i < values_size; i++) {
+		if (transformed_values_tmp[i]) {
+			transformed_values_tmp[transformed_values_size_tmp++] = transformed_values_tmp[i];
+		}
+	}
+
+out:
+	*transformed_values = error ? NULL : transformed_values_tmp;
+	*transformed_values_size = error ? 0 : transformed_values_size_tmp;
+
+	return error;
+}
+
+int srpo_uci_handle_revert(srpo_uci_handle_t *ctx, const char *uci_config)
+{
+	int error = SRPO_UCI_ERR_OK;
+	char *uci_config_tmp = NULL;
+
+	if (uci_config == NULL) {
+		error = SRPO_UCI_ERR_UCI;
+		goto out;
+	}
+
+	error = uci_context_revert(ctx, uci_config, 0);
+	if (error) {
+		error = SRPO_UCI_ERR_UCI;
+		goto out;
+	}
+
+out:
+	FREE_SAFE(uci_config_tmp);
+	return error;
+}
+
+int srpo_uci_handle_savepoint_get(srpo_uci_handle_t *ctx, const char *uci_config, size_t *savepoint)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_package_t *package = NULL;
+
+	if (uci_config == NULL || savepoint == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	error = uci_context_package_acquire(ctx, uci_config, &package);
+	if (error) {
+		return error;
+	}
+
+	*savepoint = package->journal.size;
+	uci_context_package_release(package);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+int srpo_uci_handle_savepoint_revert(srpo_uci_handle_t *ctx, const char *uci_config, size_t savepoint)
+{
+	if (uci_config == NULL) {
+		return SRPO_UCI_ERR_ARGUMENT;
+	}
+
+	return uci_context_revert(ctx, uci_config, savepoint);
+}
+
+int srpo_uci_handle_commit(srpo_uci_handle_t *ctx, const char *uci_config)
+{
+	int error = SRPO_UCI_ERR_OK;
+	char *uci_config_tmp = NULL;
+
+	if (uci_config == NULL) {
+		error = SRPO_UCI_ERR_UCI;
+		goto out;
+	}
+
+	error = uci_context_commit(ctx, uci_config);
+	if (error) {
+		error = SRPO_UCI_ERR_UCI;
+		goto out;
+	}
+
+out:
+	FREE_SAFE(uci_config_tmp);
+	return error;
+}
+
+static srpo_uci_xpath_uci_template_map_t *template_map_ucipath_entry_get(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, char **xpath, int *error)
+{
+	srpo_uci_xpath_uci_template_map_t *entry = NULL;
+	uint64_t stats_start = stats_clock();
+
+	*xpath = NULL;
+	*error = SRPO_UCI_ERR_NOT_FOUND;
+
+	// find the table entry that matches the uci path and return it together with the converted xpath
+	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
+		*error = srpo_uci_path_get(ucipath,
+								   uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
+								   uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, xpath);
+		if (*error == SRPO_UCI_ERR_NOT_FOUND) {
+			continue;
+		} else if (*error == SRPO_UCI_ERR_OK) {
+			entry = &uci_xpath_template_map[i];
+		} else {
+			*error = SRPO_UCI_ERR_ARGUMENT;
+		}
+		break;
+	}
+
+	stats_record(SRPO_STATS_UCI_TEMPLATE_SCAN, stats_start, *error);
+
+	return entry;
+}
+
+static int template_index_convert(const char *path, const srpo_uci_template_index_t *index, srpo_uci_path_direction_t direction, srpo_uci_xpath_uci_template_map_t **entry, char **converted)
+{
+	int error = SRPO_UCI_ERR_OK;
+	const srpo_uci_template_hash_t *hash = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? &index->ucipath_hash : &index->xpath_hash;
+	size_t key_start = 0;
+	size_t key_end = 0;
+	size_t found = SIZE_MAX;
+	size_t keyed_found = SIZE_MAX;
+	bool keyed = false;
+	srpo_uci_xpath_uci_template_map_t *template_entry = NULL;
+	const char *to_template = NULL;
+	int to_key_offset = 0;
+	char *converted_tmp = NULL;
+	size_t converted_size = 0;
+
+	// templates without a key are found by the whole path, templates with a key by the path with the key replaced by %s
+	found = template_index_find(index, direction, path, strlen(path), strlen(path), false);
+	if (template_key_find(path, direction, &key_start, &key_end)) {
+		keyed_found = template_index_find(index, direction, path, key_start, key_end, true);
+		if (keyed_found < found) {
+			found = keyed_found;
+			keyed = true;
+		}
+	}
+
+	// templates the generator could not hash are matched as before, the first entry in map order wins
+	for (size_t i = 0; i < hash->fallback_size && hash->fallback[i] < found; i++) {
+		template_entry = &index->map[hash->fallback[i]];
+		error = direction == SRPO_UCI_PATH_DIRECTION_XPATH ?
+					srpo_uci_path_get(path, template_entry->ucipath_template, template_entry->xpath_template, template_entry->transform_path_cb, direction, &converted_tmp) :
+					srpo_uci_path_get(path, template_entry->xpath_template, template_entry->ucipath_template, template_entry->transform_path_cb, direction, &converted_tmp);
+		if (error == SRPO_UCI_ERR_NOT_FOUND) {
+			FREE_SAFE(converted_tmp);
+			continue;
+		} else if (error != SRPO_UCI_ERR_OK) {
+			FREE_SAFE(converted_tmp);
+			return SRPO_UCI_ERR_ARGUMENT;
+		}
+
+		found = hash->fallback[i];
+		goto out;
+	}
+
+	if (found == SIZE_MAX) {
+		return SRPO_UCI_ERR_NOT_FOUND;
+	}
+
+	template_entry = &index->map[found];
+	if (converted) {
+		to_template = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? template_entry->xpath_template : template_entry->ucipath_template;
+		to_key_offset = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? index->keys[found].xpath_key_offset : index->keys[found].ucipath_key_offset;
+		if (to_key_offset < 0) {
+			converted_tmp = xstrdup(to_template);
+		} else {
+			// the key is copied straight from the path into the other template
+			key_end = keyed ? key_end : key_start;
+			converted_size = strlen(to_template) - 2 + (key_end - key_start) + 1;
+			converted_tmp = xmalloc(converted_size);
+			snprintf(converted_tmp, converted_size, "%.*s%.*s%s", to_key_offset, to_template, (int) (key_end - key_start), path + key_start, to_template + to_key_offset + 2);
+		}
+	}
+
+out:
+	if (entry) {
+		*entry = &index->map[found];
+	}
+
+	if (converted) {
+		*converted = converted_tmp;
+	} else {
+		FREE_SAFE(converted_tmp);
+	}
+
+	return SRPO_UCI_ERR_OK;
+}
+
+static size_t template_index_find(const srpo_uci_template_index_t *index, srpo_uci_path_direction_t direction, const char *path, size_t key_start, size_t key_end, bool keyed)
+{
+	const srpo_uci_template_hash_t *hash = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? &index->ucipath_hash : &index->xpath_hash;
+	uint32_t seed = 0;
+	size_t position = 0;
+	const char *template = NULL;
+	int key_offset = 0;
+
+	if (hash->slots_size == 0) {
+		return SIZE_MAX;
+	}
+
+	seed = hash->seeds[template_hash(0, path, key_start, key_end, keyed) % hash->seeds_size];
+	position = hash->slots[template_hash(seed, path, key_start, key_end, keyed) % hash->slots_size];
+
+	template = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? index->map[position].ucipath_template : index->map[position].xpath_template;
+	key_offset = direction == SRPO_UCI_PATH_DIRECTION_XPATH ? index->keys[position].ucipath_key_offset : index->keys[position].xpath_key_offset;
+
+	// the slot only names the one template the path can match
+	if (keyed) {
+		if (key_offset < 0 || (size_t) key_offset != key_start || strncmp(template, path, key_start) != 0 || strcmp(template + key_start + 2, path + key_end) != 0) {
+			return SIZE_MAX;
+		}
+	} else if (key_offset >= 0 || strcmp(template, path) != 0) {
+		return SIZE_MAX;
+	}
+
+	return position;
+}
+
+static bool template_key_find(const char *path, srpo_uci_path_direction_t direction, size_t *key_start, size_t *key_end)
+{
+	const char *start = NULL;
+	const char *end = NULL;
+	char quote = 0;
+
+	if (direction == SRPO_UCI_PATH_DIRECTION_XPATH) {
+		// the section name of a UCI path, unnamed sections have no key
+		start = strchr(path, '.');
+		if (start == NULL) {
+			return false;
+		}
+		start++;
+		end = start + strcspn(start, ".");
+		if (end == start || *start == '@' || strcspn(start, "[]=") < (size_t) (end - start)) {
+			return false;
+		}
+	} else {
+		// the value of the first list key predicate of an XPath, e.g. [name='value']
+		start = strchr(path, '[');
+		if (start == NULL) {
+			return false;
+		}
+		start += 1 + strcspn(start + 1, "=]");
+		if (start[0] != '=' || (start[1] != '\'' && start[1] != '"')) {
+			return false;
+		}
+		quote = start[1];
+		start += 2;
+		end = strchr(start, quote);
+		if (end == NULL || end[1] != ']') {
+			return false;
+		}
+	}
+
+	*key_start = (size_t) (start - path);
+	*key_end = (size_t) (end - path);
+
+	return true;
+}
+
+static uint32_t template_hash(uint32_t seed, const char *path, size_t key_start, size_t key_end, bool keyed)
+{
+	// FNV-1a over the path with the key replaced by %s, the generator hashes the templates the same way
+	uint32_t hash = hash_fnv_update(HASH_FNV_OFFSET ^ seed, path, key_start);
+
+	if (keyed) {
+		hash = hash_fnv_update(hash, "%s", 2);
+		hash = hash_fnv_update(hash, path + key_end, strlen(path + key_end));
+	}
+
+	return hash;
+}
+
+static char *path_from_template_get(const char *template, const char *data)
+{
+	char *path = NULL;
+	size_t path_size = 0;
+
+	if (strstr(template, "%s")) {
+		path_size = strlen(template) - 2 + (data ? strlen(data) : 0) + 1;
+		path = xmalloc(path_size);
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+		snprintf(path, path_size, template, data ? data : "");
+#pragma GCC diagnostic warning "-Wformat-nonliteral"
+	} else {
+		path = xstrdup(template);
+	}
+
+	return path;
+}
+
+static bool path_template_match(const char *target, const char *template, const char *data, size_t data_size)
+{
+	// same as comparing with path_from_template_get(template, data) without building the path
+	const char *format = strstr(template, "%s");
+	size_t prefix_size = 0;
+
+	if (format == NULL) {
+		return strcmp(target, template) == 0;
+	}
+
+	prefix_size = (size_t) (format - template);
+
+	return strncmp(target, template, prefix_size) == 0 && strncmp(target + prefix_size, data, data_size) == 0 && strcmp(target + prefix_size + data_size, format + 2) == 0;
+}
+
+static uci2_n_t *uci_get_last_type(uci2_n_t *cfg, const char *type_name)
+{
+	uci2_n_t *ret_node = NULL;
+	uci2_iter(cfg, t)
+	{
+		// check that the node is not deleted
+		if (t->parent && strcmp(t->name, type_name) == 0) {
+			ret_node = t;
+		}
+	}
+	return ret_node;
+}
+
+static uci2_n_t *uci_node_child_get(uci2_n_t *node, const char *name)
+{
+	for (int i = 0; i < uci2_nc(node); i++) {
+		// check that the node is not deleted
+		if (node->ch[i]->parent == node && strcmp(node->ch[i]->name, name) == 0) {
+			return node->ch[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void uci_path_init(srpo_uci_path_t *ptr)
+{
+	ptr->package = NULL;
+	ptr->section = NULL;
+	ptr->section_type = NULL;
+	ptr->section_position = 0;
+	ptr->option = NULL;
+	ptr->value = NULL;
+}
+
+static void uci_path_print(const char *ucipath, const srpo_uci_path_t *ptr)
+{
+	SRPO_LOG_DEBUG("uci path %s: package %s, section %s, option %s, value %s", ucipath, ptr->package ? ptr->package : "-", ptr->section ? ptr->section : "-",
+				   ptr->option ? ptr->option : "-", ptr->value ? ptr->value : "-");
+}
+
+static int uci_path_parse(srpo_uci_path_t *path, const char *uci_path)
+{
+	int error = 0;
+	size_t opt_pos = 0;
+	const char delims[] = ".[]=";
+	char *token = NULL;
+	char *ucipath = scratch_strdup(uci_path);
+
+	// the parts list is grown with xrealloc, only the strings can live in the scratch arena
+	struct {
+		char **list;
+		size_t size;
+	} parts = {0, 0};
+
+	token = strtok((char *) ucipath, delims);
+	while (token != NULL) {
+		parts.list = xrealloc(parts.list, sizeof(char *) * (++parts.size));
+		parts.list[parts.size - 1] = scratch_strdup(token);
+		token = strtok(NULL, delims);
+	}
+	if (parts.size > 0) {
+		path->package = scratch_strdup(parts.list[0]);
+	}
+	if (parts.size > 1) {
+		if (parts.list[1][0] == '@' && parts.size > 2) {
+			size_t size = strlen(parts.list[1]) + strlen(parts.list[2]) + 3;
+
+			path->section_type = scratch_strdup(parts.list[1] + 1);
+			path->section_position = strtol(parts.list[2], NULL, 10);
+			// libuci2 names anonymous sections type#n counting from 1, a position relative to the end keeps its UCI form
+			path->section = scratch_malloc(sizeof(char) * size);
+			if (path->section_position < 0) {
+				snprintf(path->section, size, "%s[%ld]", parts.list[1], path->section_position);
+			} else {
+				snprintf(path->section, size, "%s#%ld", path->section_type, path->section_position + 1);
+			}
+			opt_pos = 3;
+		} else {
+			path->section = scratch_strdup(parts.list[1]);
+			opt_pos = 2;
+		}
+	}
+	if (parts.size > opt_pos) {
+		if (parts.size <= opt_pos + 1) {
+			path->option = scratch_strdup(parts.list[opt_pos]);
+		} else {
+			path->option = scratch_strdup(parts.list[opt_pos]);
+			path->value = scratch_strdup(parts.list[opt_pos + 1]);
+		}
+	}
+
+	for (size_t i = 0; i < parts.size; i++) {
+		FREE_SAFE(parts.list[i]);
+	}
+	FREE_SAFE(parts.list);
+	FREE_SAFE(ucipath);
+	uci_path_print(uci_path, path);
+	return error;
+}
+
+static void uci_path_free(srpo_uci_path_t *ptr)
+{
+	FREE_SAFE(ptr->package);
+	FREE_SAFE(ptr->section);
+	FREE_SAFE(ptr->section_type);
+	FREE_SAFE(ptr->option);
+	FREE_SAFE(ptr->value);
+}
+
+static void srpo_path_list_init(srpo_path_list_t *ls)
+{
+	ls->data = NULL;
+	ls->size = 0;
+	ls->capacity = 0;
+}
+
+static void srpo_path_list_append(srpo_path_list_t *ls, char *path)
+{
+	if (ls->size == ls->capacity) {
+		ls->capacity = ls->capacity ? ls->capacity * 2 : 16;
+		ls->data = xrealloc(ls->data, sizeof(char *) * ls->capacity);
+	}
+	ls->data[ls->size++] = path;
+}
+
+static void srpo_path_list_free(srpo_path_list_t *ls)
+{
+	if (ls->data) {
+		for (size_t i = 0; i < ls->size; i++) {
+			FREE_SAFE(ls->data[i]);
+		}
+		FREE_SAFE(ls->data);
+		srpo_path_list_init(ls);
+	}
+}
+
+static void path_buffer_init(srpo_path_buffer_t *buffer)
+{
+	buffer->data = NULL;
+	buffer->size = 0;
+}
+
+static size_t path_buffer_format(srpo_path_buffer_t *buffer, size_t offset, const char *format, ...)
+{
+	va_list args;
+	int length = 0;
+
+	// format at offset, growing the buffer only when the result does not fit
+	for (;;) {
+		va_start(args, format);
+		length = vsnprintf(buffer->data ? buffer->data + offset : NULL, buffer->data ? buffer->size - offset : 0, format, args);
+		va_end(args);
+
+		if (length < 0) {
+			length = 0;
+			if (buffer->data) {
+				buffer->data[offset] = 0;
+			}
+			break;
+		}
+
+		if (buffer->data && offset + (size_t) length < buffer->size) {
+			break;
+		}
+
+		buffer->size = buffer->size ? buffer->size : 256;
+		while (buffer->size <= offset + (size_t) length) {
+			buffer->size *= 2;
+		}
+		buffer->data = xrealloc(buffer->data, buffer->size);
+	}
+
+	return offset + (size_t) length;
+}
+
+static void path_buffer_free(srpo_path_buffer_t *buffer)
+{
+	FREE_SAFE(buffer->data);
+	buffer->size = 0;
+}
+
+static bool section_list_contains(const char **uci_section_list, size_t uci_section_list_size, const char *section_type)
+{
+	for (size_t i = 0; i < uci_section_list_size; i++) {
+		if (strcmp(uci_section_list[i], section_type) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void uci_journal_init(srpo_uci_journal_t *journal)
+{
+	journal->entries = NULL;
+	journal->size = 0;
+	journal->capacity = 0;
+}
+
+static void uci_journal_append(srpo_uci_journal_t *journal, srpo_uci_journal_op_t op, uci2_n_t *node, uci2_n_t *parent, const char *old_value)
+{
+	srpo_uci_journal_entry_t *entry = NULL;
+
+	if (journal->size == journal->capacity) {
+		journal->capacity = journal->capacity ? journal->capacity * 2 : 16;
+		journal->entries = xrealloc(journal->entries, sizeof(srpo_uci_journal_entry_t) * journal->capacity);
+	}
+
+	entry = &journal->entries[journal->size++];
+	entry->op = op;
+	entry->node = node;
+	entry->parent = parent;
+	entry->old_value = old_value ? xstrdup(old_value) : NULL;
+}
+
+static void uci_journal_rollback(srpo_uci_journal_t *journal, size_t savepoint)
+{
+	// undo the edits newest first so every entry sees the tree as it was right after it was recorded
+	while (journal->size > savepoint) {
+		srpo_uci_journal_entry_t *entry = &journal->entries[--journal->size];
+
+		switch (entry->op) {
+			case SRPO_UCI_JOURNAL_NODE_ADD:
+				uci2_del(entry->node);
+				break;
+			case SRPO_UCI_JOURNAL_NODE_DELETE:
+				entry->node->parent = entry->parent;
+				break;
+			case SRPO_UCI_JOURNAL_VALUE_CHANGE:
+				uci2_change_value(entry->node, entry->old_value);
+				break;
+		}
+
+		FREE_SAFE(entry->old_value);
+	}
+}
+
+static void uci_journal_free(srpo_uci_journal_t *journal)
+{
+	for (size_t i = 0; i < journal->size; i++) {
+		FREE_SAFE(journal->entries[i].old_value);
+	}
+
+	FREE_SAFE(journal->entries);
+	uci_journal_init(journal);
+}
+
+static srpo_uci_snapshot_t *uci_snapshot_load(srpo_uci_package_t *package, int *error)
+{
+	srpo_uci_snapshot_t *snapshot = xcalloc(1, sizeof(srpo_uci_snapshot_t));
+	uci_file_id_t file_id = {0};
+	bool cache_hit = false;
+
+	// an image built from the same file skips parsing, e.g. after a plugin restart
+	if (package->cache_path[0] && uci_file_id_get(package->config_path, &file_id) == 0) {
+		cache_hit = uci_index_cache_load(package->cache_path, &file_id, &snapshot->index) == 0;
+	}
+
+	// readers only need the index, libuci2 is parsed lazily for the writers
+	if (!cache_hit) {
+		uint64_t stats_start = stats_clock();
+		int load_error = uci_index_load(package->config_path, &snapshot->index);
+
+		stats_record(SRPO_STATS_UCI_PARSE, stats_start, load_error);
+		if (load_error != 0) {
+			SRPO_LOG_ERROR("loading %s failed: %s", package->config_path, strerror(errno));
+			*error = SRPO_UCI_ERR_UCI_FILE;
+			FREE_SAFE(snapshot);
+			return NULL;
+		}
+
+		// the cache is only an optimization, failing to write it is not an error
+		if (package->cache_path[0]) {
+			uci_index_cache_store(&snapshot->index, package->cache_path);
+		}
+	}
+
+	uci_sections_init(&snapshot->sections);
+	hash_table_init(&snapshot->names, 0, uci_snapshot_name_hash, uci_snapshot_name_equal);
+	for (size_t i = 0; i < snapshot->index.sections_size; i++) {
+		uci_sections_append(&snapshot->sections, snapshot->index.sections[i].type, &snapshot->index.sections[i]);
+		if (snapshot->index.sections[i].name) {
+			hash_table_add(&snapshot->names, &snapshot->index.sections[i]);
+		}
+	}
+
+	snapshot->name = package->name;
+	snapshot->memory_size = sizeof(srpo_uci_snapshot_t) + uci_index_memory_size(&snapshot->index) + uci_sections_memory_size(&snapshot->sections) +
+							hash_table_memory_size(&snapshot->names);
+	snapshot->refcount = 1;
+	stats_memory_alloc(SRPO_STATS_MEMORY_UCI_SNAPSHOT, snapshot->memory_size);
+	*error = SRPO_UCI_ERR_OK;
+
+	return snapshot;
+}
+
+static srpo_uci_snapshot_t *uci_snapshot_get(srpo_uci_snapshot_t *snapshot)
+{
+	__atomic_add_fetch(&snapshot->refcount, 1, __ATOMIC_RELAXED);
+	return snapshot;
+}
+
+static void uci_snapshot_put(srpo_uci_snapshot_t *snapshot)
+{
+	// the last reference frees the tree, either the package dropped it or the last reader of a replaced version did
+	if (snapshot && __atomic_sub_fetch(&snapshot->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+		stats_memory_free(SRPO_STATS_MEMORY_UCI_SNAPSHOT, snapshot->memory_size);
+		uci_sections_free(&snapshot->sections);
+		hash_table_free(&snapshot->names);
+		uci_index_free(&snapshot->index);
+		xfree(snapshot);
+	}
+}
+
+static const uci_index_section_t *uci_snapshot_section_find(srpo_uci_snapshot_t *snapshot, const srpo_uci_path_t *path)
+{
+	if (path->section_type) {
+		return uci_sections_get(&snapshot->sections, path->section_type, path->section_position);
+	}
+
+	return uci_snapshot_named_section_get(snapshot, path->section);
+}
+
+static const uci_index_section_t *uci_snapshot_named_section_get(srpo_uci_snapshot_t *snapshot, const char *name)
+{
+	uci_index_section_t key = {.name = name};
+
+	return hash_table_get(&snapshot->names, &key);
+}
+
+static uint32_t uci_snapshot_name_hash(const void *section)
+{
+	return hash_fnv(((const uci_index_section_t *) section)->name);
+}
+
+static bool uci_snapshot_name_equal(const void *a, const void *b)
+{
+	return strcmp(((const uci_index_section_t *) a)->name, ((const uci_index_section_t *) b)->name) == 0;
+}
+
+static srpo_uci_package_t *uci_package_alloc(const char *config_dir, const char *cache_dir, const char *config, int *error)
+{
+	srpo_uci_package_t *package = xcalloc(1, sizeof(srpo_uci_package_t));
+	size_t cache_path_len = 0;
+
+	*error = uci_context_create_config_path(config_dir, config, package->config_path, sizeof(package->config_path));
+	if (*error) {
+		FREE_SAFE(package);
+		return NULL;
+	}
+
+	if (cache_dir) {
+		*error = uci_context_create_config_path(cache_dir, config, package->cache_path, sizeof(package->cache_path) - strlen(SRPO_UCI_CACHE_SUFFIX));
+		if (*error) {
+			FREE_SAFE(package);
+			return NULL;
+		}
+		cache_path_len = strlen(package->cache_path);
+		snprintf(package->cache_path + cache_path_len, sizeof(package->cache_path) - cache_path_len, "%s", SRPO_UCI_CACHE_SUFFIX);
+	}
+
+	package->name = xstrdup(config);
+	uci_journal_init(&package->journal);
+	uci_sections_init(&package->sections);
+	pthread_mutex_init(&package->snapshot_lock, NULL);
+	pthread_mutex_init(&package->diff_lock, NULL);
+	pthread_mutex_init(&package->diff_run_lock, NULL);
+	pthread_mutex_init(&package->write_lock, NULL);
+
+	return package;
+}
+
+static int uci_package_parse(srpo_uci_package_t *package, bool diff_rebase)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_snapshot_t *snapshot = NULL;
+	srpo_uci_snapshot_t *old_snapshot = NULL;
+	srpo_uci_snapshot_t *old_diff_base = NULL;
+
+	TRACE1(uci_load_entry, package->config_path);
+	snapshot = uci_snapshot_load(package, &error);
+	TRACE2(uci_load_return, package->config_path, snapshot ? SRPO_UCI_ERR_OK : error);
+	if (snapshot == NULL) {
+		return error;
+	}
+
+	pthread_mutex_lock(&package->snapshot_lock);
+	old_snapshot = package->published;
+	package->published = snapshot;
+	// diffs start at the first version that was read and skip over our own commits
+	if (package->diff_base == NULL || diff_rebase) {
+		old_diff_base = package->diff_base;
+		package->diff_base = uci_snapshot_get(snapshot);
+	}
+	pthread_mutex_unlock(&package->snapshot_lock);
+
+	uci_snapshot_put(old_snapshot);
+	uci_snapshot_put(old_diff_base);
+
+	return SRPO_UCI_ERR_OK;
+}
+
+static int uci_package_working_parse(srpo_uci_package_t *package)
+{
+	uint64_t stats_start = 0;
+
+	// a fresh parse invalidates every node the journal and the sections index point to
+	uci_journal_free(&package->journal);
+	package->sections_valid = false;
+	if (package->working) {
+		uci2_free_ctx(package->working);
+	}
+
+	// stat before parsing, a write in between makes the tree look stale instead of hiding the change
+	uci_file_id_get(package->config_path, &package->working_file_id);
+	stats_start = stats_clock();
+	TRACE1(uci_working_load_entry, package->config_path);
+	package->working = uci2_parse_file((const char *) package->config_path);
+	stats_record(SRPO_STATS_UCI_PARSE, stats_start, package->working == NULL);
+	TRACE2(uci_working_load_return, package->config_path, package->working ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_UCI_FILE);
+	uci_package_working_account(package);
+	if (package->working == NULL) {
+		SRPO_LOG_ERROR("parsing %s with libuci2 failed", package->config_path);
+	}
+
+	return package->working ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_UCI_FILE;
+}
+
+static bool uci_package_file_changed(srpo_uci_package_t *package, const uci_file_id_t *file_id)
+{
+	uci_file_id_t current_file_id = {0};
+
+	return uci_file_id_get(package->config_path, &current_file_id) != 0 || !uci_file_id_equal(&current_file_id, file_id);
+}
+
+static void uci_package_sections_build(srpo_uci_package_t *package)
+{
+	uci2_n_t *root = UCI2_CFG_ROOT(package->working);
+
+	uci_sections_free(&package->sections);
+	uci_sections_init(&package->sections);
+
+	for (int i = 0; i < uci2_nc(root); i++) {
+		uci2_n_t *type = root->ch[i];
+		bool anonymous = false;
+
+		// deleted nodes are detached from their parent
+		if (type->nt != UCI2_NT_TYPE || type->parent != root) {
+			continue;
+		}
+
+		// a type node is an anonymous section if it was parsed as one or has options of its own, a named section
+		// created while the last section of its type is an anonymous one goes below that type node and must not hide it
+		anonymous = uci2_nc(type) == 0 || type->ch[0]->nt != UCI2_NT_SECTION_NAME;
+		for (int j = 0; j < uci2_nc(type) && !anonymous; j++) {
+			uci2_n_t *child = type->ch[j];
+
+			anonymous = child->parent == type && (child->nt == UCI2_NT_OPTION || child->nt == UCI2_NT_LIST);
+		}
+
+		if (anonymous) {
+			uci_sections_append(&package->sections, type->name, type);
+		}
+
+		// only the named sections that are still attached, a revert detaches the ones it removes
+		for (int j = 0; j < uci2_nc(type); j++) {
+			uci2_n_t *section = type->ch[j];
+
+			if (section->nt == UCI2_NT_SECTION_NAME && section->parent == type) {
+				uci_sections_append(&package->sections, type->name, section);
+			}
+		}
+	}
+
+	package->sections_valid = true;
+}
+
+static uci2_n_t *uci_package_node_get(srpo_uci_package_t *package, const srpo_uci_path_t *path, const char *option, const char *value)
+{
+	uci2_n_t *node = NULL;
+
+	// named sections are looked up by libuci2
+	if (path->section_type == NULL) {
+		if (option == NULL) {
+			return uci2_q(package->working, path->section);
+		} else if (value == NULL) {
+			return uci2_q(package->working, path->section, option);
+		}
+		return uci2_q(package->working, path->section, option, value);
+	}
+
+	// @type[n] is resolved by position instead of searching the tree, the index follows the section edits
+	if (!package->sections_valid) {
+		uci_package_sections_build(package);
 	}
 
-	// find the table entry that matches the uci path for the found uci section
-	for (size_t i = 0; i < uci_xpath_template_map_size; i++) {
-		error = srpo_uci_path_get(ucipath,
-								  uci_xpath_template_map[i].ucipath_template, uci_xpath_template_map[i].xpath_template,
-								  uci_xpath_template_map[i].transform_path_cb, SRPO_UCI_PATH_DIRECTION_XPATH, &xpath_tmp);
-		if (error == SRPO_UCI_ERR_NOT_FOUND) {
-			FREE_SAFE(xpath_tmp);
-			continue;
-		} else if (error == SR_ERR_OK) {
-			has_transform_uci_data_private_tmp = uci_xpath_template_map[i].has_transform_uci_data_private;
-			break;
-		} else {
-			FREE_SAFE(xpath_tmp);
-			return SRPO_UCI_ERR_ARGUMENT;
-		}
+	node = (uci2_n_t *) uci_sections_get(&package->sections, path->section_type, path->section_position);
+	if (node && option) {
+		node = uci_node_child_get(node, option);
+	}
+	if (node && value) {
+		node = uci_node_child_get(node, value);
 	}
 
-	*has_transform_uci_data_private = has_transform_uci_data_private_tmp;
+	return node;
+}
 
-	FREE_SAFE(xpath_tmp);
+static void uci_package_working_account(srpo_uci_package_t *package)
+{
+	size_t working_memory_size = package->working ? uci_node_memory_size(UCI2_CFG_ROOT(package->working)) + uci_sections_memory_size(&package->sections) : 0;
 
-	return SRPO_UCI_ERR_OK;
+	stats_memory_free(SRPO_STATS_MEMORY_UCI_WORKING, package->working_memory_size);
+	__atomic_store_n(&package->working_memory_size, working_memory_size, __ATOMIC_RELAXED);
+	stats_memory_alloc(SRPO_STATS_MEMORY_UCI_WORKING, working_memory_size);
 }
 
-char *srpo_uci_section_name_get(const char *ucipath)
+static size_t uci_package_memory_size(srpo_uci_package_t *package)
 {
-	int error = 0;
-	srpo_uci_path_t uci_path;
-	char *value_tmp = NULL;
+	size_t memory_size = __atomic_load_n(&package->working_memory_size, __ATOMIC_RELAXED);
 
-	uci_path_init(&uci_path);
+	// only what the package holds itself, snapshots pinned by readers alone can't be evicted
+	pthread_mutex_lock(&package->snapshot_lock);
+	if (package->published) {
+		memory_size += package->published->memory_size;
+	}
+	if (package->diff_base && package->diff_base != package->published) {
+		memory_size += package->diff_base->memory_size;
+	}
+	pthread_mutex_unlock(&package->snapshot_lock);
 
-	error = uci_path_parse(&uci_path, ucipath);
+	return memory_size;
+}
 
-	if (error)
-		goto out;
+static size_t uci_package_evict(srpo_uci_package_t *package)
+{
+	size_t evicted_size = 0;
+	srpo_uci_snapshot_t *old_snapshot = NULL;
+	srpo_uci_snapshot_t *old_diff_base = NULL;
+
+	// the next reader loads the file again, readers that pinned the snapshot keep it until they are done
+	pthread_mutex_lock(&package->snapshot_lock);
+	if (package->published && (package->published != package->diff_base || !package->diffed)) {
+		old_snapshot = package->published;
+		package->published = NULL;
+		evicted_size += old_snapshot->memory_size;
+		stats_memory_evict(SRPO_STATS_MEMORY_UCI_SNAPSHOT, old_snapshot->memory_size);
+		// without a diff taken yet the base is only the first version read, the next load becomes the base
+		if (!package->diffed) {
+			old_diff_base = package->diff_base;
+			package->diff_base = NULL;
+			if (old_diff_base && old_diff_base != old_snapshot) {
+				evicted_size += old_diff_base->memory_size;
+				stats_memory_evict(SRPO_STATS_MEMORY_UCI_SNAPSHOT, old_diff_base->memory_size);
+			}
+		}
+	}
+	pthread_mutex_unlock(&package->snapshot_lock);
+
+	uci_snapshot_put(old_snapshot);
+	uci_snapshot_put(old_diff_base);
+
+	// a tree with pending edits is never dropped, a busy writer is skipped rather than waited for
+	if (pthread_mutex_trylock(&package->write_lock) == 0) {
+		if (package->working && package->journal.size == 0) {
+			evicted_size += package->working_memory_size;
+			stats_memory_evict(SRPO_STATS_MEMORY_UCI_WORKING, package->working_memory_size);
+			uci2_free_ctx(package->working);
+			package->working = NULL;
+			uci_sections_free(&package->sections);
+			uci_sections_init(&package->sections);
+			package->sections_valid = false;
+			uci_package_working_account(package);
+		}
+		pthread_mutex_unlock(&package->write_lock);
+	}
 
-	// check for empty section
-	if (!uci_path.section) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	return evicted_size;
+}
+
+static void uci_package_free(srpo_uci_package_t *package)
+{
+	if (package) {
+		uci_journal_free(&package->journal);
+		uci_sections_free(&package->sections);
+		if (package->working) {
+			uci2_free_ctx(package->working);
+		}
+		stats_memory_free(SRPO_STATS_MEMORY_UCI_WORKING, package->working_memory_size);
+		uci_snapshot_put(package->published);
+		uci_snapshot_put(package->diff_base);
+		FREE_SAFE(package->name);
+		pthread_mutex_destroy(&package->snapshot_lock);
+		pthread_mutex_destroy(&package->diff_lock);
+		pthread_mutex_destroy(&package->diff_run_lock);
+		pthread_mutex_destroy(&package->write_lock);
+		xfree(package);
 	}
+}
 
-	value_tmp = xstrdup(uci_path.section);
+static void *uci_preload_worker(void *arg)
+{
+	srpo_uci_preload_job_t *job = arg;
+	size_t i = 0;
 
-out:
-	uci_path_free(&uci_path);
+	while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->size) {
+		job->errors[i] = uci_package_parse(job->packages[i], false);
+	}
 
-	return value_tmp;
+	return NULL;
 }
 
-char *srpo_uci_xpath_key_value_get(const char *xpath, int level)
+static size_t uci_node_memory_size(uci2_n_t *node)
 {
-	sr_xpath_ctx_t sr_xpath_ctx = {0};
-	int xpath_level = 0;
-	char *xpath_node = NULL;
-	char *xpath_key_name = NULL;
-	char *xpath_key_value = NULL;
+	size_t size = sizeof(uci2_n_t) + (size_t) uci2_nc(node) * sizeof(uci2_n_t *);
 
-	xpath_node = sr_xpath_next_node((char *) xpath, &sr_xpath_ctx);
-	if (xpath_node) {
-		do {
-			xpath_key_name = sr_xpath_next_key_name(NULL, &sr_xpath_ctx);
-			if (xpath_key_name) {
-				xpath_level++;
+	size += node->name ? strlen(node->name) + 1 : 0;
+	size += node->value ? strlen(node->value) + 1 : 0;
 
-				if (xpath_level >= level) {
-					xpath_key_value = strdup(sr_xpath_next_key_value(NULL, &sr_xpath_ctx));
-					break;
-				}
-			}
-		} while (sr_xpath_next_node(NULL, &sr_xpath_ctx));
+	// detached children are still owned by the tree and counted with it
+	for (int i = 0; i < uci2_nc(node); i++) {
+		size += uci_node_memory_size(node->ch[i]);
 	}
 
-	sr_xpath_recover(&sr_xpath_ctx);
+	return size;
+}
 
-	return xpath_key_value;
+static srpo_uci_ctx_t *uci_context_alloc(void)
+{
+	srpo_uci_ctx_t *ctx = xcalloc(1, sizeof(srpo_uci_ctx_t));
+	pthread_mutex_init(&ctx->packages_lock, NULL);
+	return ctx;
 }
 
-int srpo_uci_section_create(const char *ucipath, const char *uci_section_type)
+static void uci_context_set_config_dir(srpo_uci_ctx_t *ctx, const char *dir)
 {
-	int error = SRPO_UCI_ERR_OK;
-	srpo_uci_path_t uci_path;
-	uci2_n_t *last_type = NULL;
+	FREE_SAFE(ctx->config_dir);
+	ctx->config_dir = xstrdup(dir);
+}
 
-	uci_path_init(&uci_path);
+static int uci_context_set_cache_dir(srpo_uci_ctx_t *ctx, const char *dir)
+{
+	struct stat dir_stat = {0};
 
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	if (dir && mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		return SRPO_UCI_ERR_DIRECTORY;
 	}
 
-	if (uci_section_type == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	// another user who can write to the directory could swap the images for ones the loader trusts
+	if (dir && (stat(dir, &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode) || dir_stat.st_uid != geteuid() || (dir_stat.st_mode & (S_IWGRP | S_IWOTH)))) {
+		return SRPO_UCI_ERR_DIRECTORY;
 	}
 
-	error = uci_path_parse(&uci_path, ucipath);
+	// packages already in the cache keep the setting they were created with
+	pthread_mutex_lock(&ctx->packages_lock);
+	FREE_SAFE(ctx->cache_dir);
+	ctx->cache_dir = dir ? xstrdup(dir) : NULL;
+	pthread_mutex_unlock(&ctx->packages_lock);
 
-	last_type = uci_get_last_type(UCI2_CFG_ROOT(uci_context->parser_ctx), uci_section_type);
+	return SRPO_UCI_ERR_OK;
+}
 
-	if (!last_type) {
-		error = SRPO_UCI_ERR_UCI;
-		goto out;
+static srpo_uci_package_t *uci_context_package_find(srpo_uci_ctx_t *ctx, const char *config)
+{
+	for (srpo_uci_package_t *package = ctx->packages; package; package = package->next) {
+		if (strcmp(package->name, config) == 0) {
+			return package;
+		}
 	}
 
-	uci2_add_S(uci_context->parser_ctx, last_type, uci_path.section);
-
-out:
-	uci_path_free(&uci_path);
-	return error;
+	return NULL;
 }
 
-int srpo_uci_section_delete(const char *ucipath)
+static int uci_context_package_get(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_package_t **package)
 {
-	int error = SRPO_UCI_ERR_OK;
-	srpo_uci_path_t uci_path;
-	uci2_n_t *lookup_node = NULL;
+	int error = 0;
+	srpo_uci_package_t *package_tmp = NULL;
+
+	// packages are never removed from the cache while the handle is alive, the pointer stays valid after unlocking
+	pthread_mutex_lock(&ctx->packages_lock);
+	package_tmp = uci_context_package_find(ctx, config);
+	if (package_tmp == NULL) {
+		package_tmp = uci_package_alloc(ctx->config_dir, ctx->cache_dir, config, &error);
+		if (package_tmp) {
+			package_tmp->next = ctx->packages;
+			ctx->packages = package_tmp;
+		}
+	}
+	if (package_tmp) {
+		package_tmp->last_used = ++ctx->use_clock;
+	}
+	pthread_mutex_unlock(&ctx->packages_lock);
 
-	uci_path_init(&uci_path);
+	*package = package_tmp;
 
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
-	}
+	return error;
+}
 
-	error = uci_path_parse(&uci_path, ucipath);
+static int uci_context_package_acquire(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_package_t **package)
+{
+	int error = 0;
+	srpo_uci_package_t *package_tmp = NULL;
 
+	error = uci_context_package_get(ctx, config, &package_tmp);
 	if (error) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
-	}
-
-	if (!uci_path.section || !uci_path.package) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+		return error;
 	}
 
-	lookup_node = uci2_q(uci_context->parser_ctx, uci_path.section);
+	pthread_mutex_lock(&package_tmp->write_lock);
 
-	if (!lookup_node) {
-		// no such node found
-		error = SRPO_UCI_ERR_NOT_FOUND;
-		goto out;
+	// writers never touch the published snapshot, they edit a libuci2 tree parsed from the file
+	// which is refreshed if the file changed behind our back without pending edits to lose
+	if (package_tmp->working == NULL || (package_tmp->journal.size == 0 && uci_package_file_changed(package_tmp, &package_tmp->working_file_id))) {
+		error = uci_package_working_parse(package_tmp);
+		if (error) {
+			pthread_mutex_unlock(&package_tmp->write_lock);
+			return error;
+		}
+		uci_context_evict(ctx, package_tmp);
 	}
 
-	uci2_del(lookup_node);
-out:
-	uci_path_free(&uci_path);
+	*package = package_tmp;
+
 	return error;
 }
 
-int srpo_uci_option_set(const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+static void uci_context_package_release(srpo_uci_package_t *package)
 {
-	int error = SRPO_UCI_ERR_OK;
-	char *transform_value = NULL;
-	srpo_uci_path_t uci_path;
-	uci2_n_t *lookup_node = NULL;
+	pthread_mutex_unlock(&package->write_lock);
+}
 
-	uci_path_init(&uci_path);
+static int uci_context_snapshot_acquire(srpo_uci_ctx_t *ctx, const char *config, srpo_uci_snapshot_t **snapshot)
+{
+	int error = 0;
+	srpo_uci_package_t *package = NULL;
+	srpo_uci_snapshot_t *snapshot_tmp = NULL;
+	srpo_uci_snapshot_t *old_snapshot = NULL;
+	srpo_uci_snapshot_t *replaced_snapshot = NULL;
 
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	error = uci_context_package_get(ctx, config, &package);
+	if (error) {
+		return error;
 	}
 
-	if (value == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	pthread_mutex_lock(&package->snapshot_lock);
+	if (package->published) {
+		snapshot_tmp = uci_snapshot_get(package->published);
 	}
+	pthread_mutex_unlock(&package->snapshot_lock);
 
-	transform_value = transform_sysrepo_data_cb ? transform_sysrepo_data_cb(value, private_data) : xstrdup(value);
-	if (transform_value == NULL) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	if (snapshot_tmp && !uci_package_file_changed(package, &snapshot_tmp->index.file_id)) {
+		*snapshot = snapshot_tmp;
+		return SRPO_UCI_ERR_OK;
 	}
 
-	uci_path_parse(&uci_path, ucipath);
-	if (!uci_path.package || !uci_path.section || !uci_path.option) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	// parse outside of the lock, concurrent readers keep using the version they already pinned
+	old_snapshot = snapshot_tmp;
+	snapshot_tmp = uci_snapshot_load(package, &error);
+	if (snapshot_tmp == NULL) {
+		uci_snapshot_put(old_snapshot);
+		return error;
 	}
 
-	lookup_node = uci2_q(uci_context->parser_ctx, uci_path.section, uci_path.option);
-
-	if (!lookup_node) {
-		error = SRPO_UCI_ERR_NOT_FOUND;
-		goto out;
+	// publish it unless a commit or another reader already replaced the stale version
+	pthread_mutex_lock(&package->snapshot_lock);
+	if (package->published == old_snapshot) {
+		replaced_snapshot = package->published;
+		package->published = uci_snapshot_get(snapshot_tmp);
+		if (package->diff_base == NULL) {
+			package->diff_base = uci_snapshot_get(snapshot_tmp);
+		}
 	}
+	pthread_mutex_unlock(&package->snapshot_lock);
 
-	uci2_change_value(lookup_node, transform_value);
+	// drop the reference the package held on the replaced version and the one we pinned
+	uci_snapshot_put(replaced_snapshot);
+	uci_snapshot_put(old_snapshot);
+	uci_context_evict(ctx, package);
 
-out:
-	uci_path_free(&uci_path);
-	FREE_SAFE(transform_value);
+	*snapshot = snapshot_tmp;
 
-	return error;
+	return SRPO_UCI_ERR_OK;
 }
 
-int srpo_uci_option_remove(const char *ucipath)
+static int uci_context_create_config_path(const char *config_dir, const char *config, char *config_path, size_t config_path_size)
 {
 	int error = 0;
-	srpo_uci_path_t uci_path;
-	uci2_n_t *lookup_node = NULL;
-
-	uci_path_init(&uci_path);
-
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
-	}
-
-	error = uci_path_parse(&uci_path, ucipath);
+	size_t path_len = strlen(config_dir);
+	size_t config_len = strlen(config);
 
-	if (error) {
-		error = SRPO_UCI_ERR_ARGUMENT;
+	if (path_len + config_len + 2 > config_path_size) {
+		error = SRPO_UCI_ERR_FILE_PATH_SIZE;
 		goto out;
 	}
 
-	if (!uci_path.package || !uci_path.section || !uci_path.option) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	snprintf(config_path, config_path_size, "%s", config_dir);
+	if (config_path[path_len - 1] != '/') {
+		// no trailing '/' -> add one
+		config_path[path_len] = '/';
+		config_path[++path_len] = 0;
 	}
+	snprintf(config_path + path_len, config_path_size - path_len, "%s", config);
+out:
+	return error;
+}
 
-	lookup_node = uci2_q(uci_context->parser_ctx, uci_path.section, uci_path.option);
-
-	if (!lookup_node) {
-		error = SRPO_UCI_ERR_NOT_FOUND;
-		goto out;
+static int uci_context_revert(srpo_uci_ctx_t *ctx, const char *config, size_t savepoint)
+{
+	int error = 0;
+	srpo_uci_package_t *package = NULL;
+
+	pthread_mutex_lock(&ctx->packages_lock);
+	package = uci_context_package_find(ctx, config);
+	pthread_mutex_unlock(&ctx->packages_lock);
+
+	if (package) {
+		pthread_mutex_lock(&package->write_lock);
+		if (savepoint > package->journal.size) {
+			error = SRPO_UCI_ERR_ARGUMENT;
+		} else if (package->working) {
+			// replay the inverse edits on the working copy, readers never saw them
+			uci_journal_rollback(&package->journal, savepoint);
+			package->sections_valid = false;
+		}
+		pthread_mutex_unlock(&package->write_lock);
 	}
 
-	uci2_del(lookup_node);
-
-out:
-	uci_path_free(&uci_path);
+	return error;
+}
 
+static int uci_context_commit(srpo_uci_ctx_t *ctx, const char *config)
+{
+	int error = 0;
+	uint64_t stats_start = 0;
+	srpo_uci_package_t *package = NULL;
+
+	TRACE1(uci_commit_entry, config);
+
+	pthread_mutex_lock(&ctx->packages_lock);
+	package = uci_context_package_find(ctx, config);
+	pthread_mutex_unlock(&ctx->packages_lock);
+
+	if (package) {
+		// diffs take the snapshot and the diff base under diff_lock, none may see the written file before the base moved past it
+		pthread_mutex_lock(&package->write_lock);
+		pthread_mutex_lock(&package->diff_lock);
+		if (package->working) {
+			// write to file
+			stats_start = stats_clock();
+			error = uci2_export_ctx_fsync(package->working, package->config_path);
+			stats_record(SRPO_STATS_UCI_COMMIT, stats_start, error);
+			if (error) {
+				SRPO_LOG_ERROR("writing %s failed: %d", package->config_path, error);
+			}
+			if (error == 0) {
+				// committed edits can no longer be reverted and our own write is not an external change,
+				// the tree matches the file now and is kept for the next edit
+				uci_journal_free(&package->journal);
+				uci_file_id_get(package->config_path, &package->working_file_id);
+				uci_package_working_account(package);
+
+				// publish what was written, readers still holding the old snapshot keep it alive
+				error = uci_package_parse(package, true);
+			}
+		}
+		pthread_mutex_unlock(&package->diff_lock);
+		pthread_mutex_unlock(&package->write_lock);
+	}
+	TRACE2(uci_commit_return, config, error);
 	return error;
 }
 
-int srpo_uci_list_set(const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data)
+static int uci_context_config_snapshot(srpo_uci_ctx_t *ctx, const char *config, const char *snapshot_dir)
 {
 	int error = SRPO_UCI_ERR_OK;
-	char *transform_value = NULL;
-	uci2_n_t *lookup_node = NULL;
-	srpo_uci_path_t uci_path;
-
-	uci_path_init(&uci_path);
+	srpo_uci_package_t *package = NULL;
+	char config_path[PATH_MAX] = {0};
+	char snapshot_path[PATH_MAX] = {0};
+	char snapshot_path_tmp[PATH_MAX] = {0};
+	FILE *config_file = NULL;
+	FILE *snapshot_file = NULL;
+	char buffer[4096];
+	size_t buffer_size = 0;
+
+	error = uci_context_create_config_path(ctx->config_dir, config, config_path, sizeof(config_path));
+	if (error) {
+		return error;
+	}
 
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	error = uci_context_create_config_path(snapshot_dir, config, snapshot_path, sizeof(snapshot_path) - strlen(".tmp"));
+	if (error) {
+		return error;
 	}
+	snprintf(snapshot_path_tmp, sizeof(snapshot_path_tmp), "%s.tmp", snapshot_path);
 
-	if (value == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	pthread_mutex_lock(&ctx->packages_lock);
+	package = uci_context_package_find(ctx, config);
+	pthread_mutex_unlock(&ctx->packages_lock);
+
+	// commits write the file while holding the write lock, the copy never sees half of a commit
+	if (package) {
+		pthread_mutex_lock(&package->write_lock);
 	}
 
-	transform_value = transform_sysrepo_data_cb ? transform_sysrepo_data_cb(value, private_data) : xstrdup(value);
-	if (transform_value == NULL) {
-		error = SRPO_UCI_ERR_ARGUMENT;
+	config_file = fopen(config_path, "r");
+	if (config_file == NULL) {
+		error = SRPO_UCI_ERR_UCI_FILE;
 		goto out;
 	}
 
-	error = uci_path_parse(&uci_path, ucipath);
-	if (error) {
-		error = SRPO_UCI_ERR_ARGUMENT;
+	snapshot_file = fopen(snapshot_path_tmp, "w");
+	if (snapshot_file == NULL) {
+		error = SRPO_UCI_ERR_DIRECTORY;
 		goto out;
 	}
 
-	if (!uci_path.package || !uci_path.section || !uci_path.option) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	while ((buffer_size = fread(buffer, 1, sizeof(buffer), config_file)) > 0) {
+		if (fwrite(buffer, 1, buffer_size, snapshot_file) != buffer_size) {
+			error = SRPO_UCI_ERR_UCI_FILE;
+			goto out;
+		}
 	}
 
-	lookup_node = uci2_q(uci_context->parser_ctx, uci_path.section, uci_path.option);
+	if (ferror(config_file)) {
+		error = SRPO_UCI_ERR_UCI_FILE;
+		goto out;
+	}
 
-	if (!lookup_node) {
-		error = SRPO_UCI_ERR_NOT_FOUND;
+	error = fclose(snapshot_file) == 0 ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_UCI_FILE;
+	snapshot_file = NULL;
+	if (error) {
 		goto out;
 	}
 
-	uci2_add_I(uci_context->parser_ctx, lookup_node, transform_value);
+	// a snapshot taken earlier is only replaced by a complete copy
+	if (rename(snapshot_path_tmp, snapshot_path) != 0) {
+		error = SRPO_UCI_ERR_UCI_FILE;
+		goto out;
+	}
 
 out:
-	uci_path_free(&uci_path);
-	FREE_SAFE(transform_value);
-
-	return error;
-}
-
-int srpo_uci_list_remove(const char *ucipath, const char *value)
-{
-	int error = SRPO_UCI_ERR_OK;
-	uci2_n_t *lookup_node = NULL;
-	srpo_uci_path_t uci_path;
-
-	uci_path_init(&uci_path);
-
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	if (package) {
+		pthread_mutex_unlock(&package->write_lock);
 	}
-
-	if (value == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
+	if (config_file) {
+		fclose(config_file);
+	}
+	if (snapshot_file) {
+		fclose(snapshot_file);
+	}
+	if (error) {
+		unlink(snapshot_path_tmp);
 	}
 
-	error = uci_path_parse(&uci_path, ucipath);
+	return error;
+}
+
+static int uci_context_diff(srpo_uci_ctx_t *ctx, srpo_uci_diff_ctx_t *diff_ctx)
+{
+	int error = SRPO_UCI_ERR_OK;
+	srpo_uci_package_t *package = NULL;
+	srpo_uci_snapshot_t *snapshot = NULL;
+	srpo_uci_snapshot_t *diff_base = NULL;
+	srpo_uci_snapshot_t *old_diff_base = NULL;
+
+	error = uci_context_package_get(ctx, diff_ctx->uci_config, &package);
 	if (error) {
-		error = SRPO_UCI_ERR_ARGUMENT;
 		goto out;
 	}
 
-	if (!uci_path.package || !uci_path.section || !uci_path.option) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
+	// from now on eviction keeps the diff base, the changes since it would be lost otherwise
+	pthread_mutex_lock(&package->snapshot_lock);
+	package->diffed = true;
+	pthread_mutex_unlock(&package->snapshot_lock);
+
+	pthread_mutex_lock(&package->diff_run_lock);
+
+	// the snapshot and the diff base are taken together under diff_lock, so a diff never sees the file a commit wrote
+	// next to the diff base from before the commit
+	pthread_mutex_lock(&package->diff_lock);
+
+	// the current snapshot is refreshed from the file if it changed on disk, without a callback that is all there is to do
+	error = uci_context_snapshot_acquire(ctx, diff_ctx->uci_config, &snapshot);
+	if (error == SRPO_UCI_ERR_OK && diff_ctx->diff_cb) {
+		pthread_mutex_lock(&package->snapshot_lock);
+		diff_base = uci_snapshot_get(package->diff_base);
+		pthread_mutex_unlock(&package->snapshot_lock);
 	}
 
-	lookup_node = uci2_q(uci_context->parser_ctx, uci_path.section, uci_path.option, value);
+	pthread_mutex_unlock(&package->diff_lock);
 
-	if (!lookup_node) {
-		error = SRPO_UCI_ERR_NOT_FOUND;
-		goto out;
+	// the callbacks run without diff_lock, applying the changes can make a Sysrepo subscriber commit this package
+	if (diff_base && diff_base != snapshot) {
+		path_buffer_init(&diff_ctx->buffer);
+		error = uci_index_diff(&diff_base->index, &snapshot->index, diff_node_cb, diff_ctx);
+		path_buffer_free(&diff_ctx->buffer);
+		if (error == SRPO_UCI_ERR_OK && diff_ctx->finish_cb) {
+			error = diff_ctx->finish_cb(diff_ctx->private_data);
+		}
+
+		// only move on if the caller took every change, otherwise the next diff reports them again,
+		// a commit in the meantime already moved the diff base past its own write and that base is kept
+		if (error == SRPO_UCI_ERR_OK) {
+			pthread_mutex_lock(&package->diff_lock);
+			pthread_mutex_lock(&package->snapshot_lock);
+			if (package->diff_base == diff_base) {
+				old_diff_base = package->diff_base;
+				package->diff_base = uci_snapshot_get(snapshot);
+			}
+			pthread_mutex_unlock(&package->snapshot_lock);
+			pthread_mutex_unlock(&package->diff_lock);
+		}
 	}
 
-	uci2_del(lookup_node);
+	pthread_mutex_unlock(&package->diff_run_lock);
 
 out:
-	uci_path_free(&uci_path);
+	uci_snapshot_put(old_diff_base);
+	uci_snapshot_put(diff_base);
+	uci_snapshot_put(snapshot);
 
 	return error;
 }
 
-int srpo_uci_element_value_get(const char *ucipath, srpo_uci_transform_data_cb transform_uci_data_cb, void *private_data, char ***value_list, size_t *value_list_size)
+static void *uci_watch_thread(void *arg)
 {
-	int error = 0;
-	srpo_uci_path_t uci_path;
-	uci2_n_t *uci_root, *uci_type, *uci_section, *tmp_node = NULL;
-	struct {
-		char **list;
-		size_t size;
-	} val_list = {0, 0};
-
-	*value_list = NULL;
-	*value_list_size = 0;
-
-	uci_path_init(&uci_path);
+	srpo_uci_watch_t *watch = arg;
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds[2] = {{watch->inotify_fd, POLLIN, 0}, {watch->stop_pipe[0], POLLIN, 0}};
+	struct timespec now = {0};
+	struct timespec deadline = {0};
+	bool scheduled = false;
+	int timeout = -1;
+	ssize_t events_size = 0;
+
+	for (;;) {
+		timeout = -1;
+		if (scheduled) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout = (int) ((deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec) / 1000000);
+			timeout = timeout < 0 ? 0 : timeout;
+		}
 
-	if (ucipath == NULL) {
-		return SRPO_UCI_ERR_ARGUMENT;
-	}
+		if (poll(fds, 2, timeout) < 0 && errno != EINTR) {
+			SRPO_LOG_ERROR("watching %s failed, UCI changes are no longer synced: %s", watch->ctx->config_dir, strerror(errno));
+			break;
+		}
 
-	error = uci_path_parse(&uci_path, ucipath);
-	if (error) {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
-	}
+		if (fds[1].revents) {
+			break;
+		}
 
-	// there needs to be an options which is wanted -> no option == noting to return
-	if (uci_path.package && uci_path.section && uci_path.option) {
-		// tmp_node = uci2_q(uci_context->parser_ctx, uci_path.section, uci_path.option);
-		uci_root = UCI2_CFG_ROOT(uci_context->parser_ctx);
-
-		for (int i = 0; i < uci_root->ch_nr; i++) {
-			uci_type = uci_root->ch[i];
-			for (int j = 0; j < uci_type->ch_nr; j++) {
-				// named section match
-				if (strcmp(uci_type->ch[j]->name, uci_path.section) == 0) {
-					uci_section = uci_type->ch[j];
-					break;
+		if (fds[0].revents & POLLIN) {
+			while ((events_size = read(watch->inotify_fd, events, sizeof(events))) > 0) {
+				for (char *ptr = events; ptr < events + events_size; ptr += sizeof(struct inotify_event) + ((struct inotify_event *) (void *) ptr)->len) {
+					uci_watch_event_handle(watch, (struct inotify_event *) (void *) ptr);
 				}
 			}
+
+			// every burst of writes pushes the sync back, e.g. a script calling uci commit in a loop
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+			deadline.tv_sec += watch->debounce_ms / 1000;
+			deadline.tv_nsec += (long) (watch->debounce_ms % 1000) * 1000000;
+			if (deadline.tv_nsec >= 1000000000) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+			scheduled = false;
+			for (size_t i = 0; i < watch->config_list_size; i++) {
+				scheduled = scheduled || watch->pending[i];
+			}
+			continue;
 		}
 
-		if (uci_section == NULL) {
-			error = SRPO_UCI_ERR_NOT_FOUND;
-			goto out;
+		if (!scheduled) {
+			continue;
 		}
 
-		for (int i = 0; i < uci_section->ch_nr; i++) {
-			// option name match
-			if (strcmp(uci_section->ch[i]->name, uci_path.option) == 0) {
-				tmp_node = uci_section->ch[i];
-				break;
+		scheduled = false;
+		for (size_t i = 0; i < watch->config_list_size; i++) {
+			srpo_uci_diff_ctx_t diff_ctx = {0};
+			srpo_uci_watch_diff_ctx_t watch_diff_ctx = {watch, &watch->config_list[i], &diff_ctx, 0};
+
+			if (!watch->pending[i]) {
+				continue;
 			}
-		}
 
-		if (tmp_node == NULL) {
-			error = SRPO_UCI_ERR_NOT_FOUND;
-			goto out;
-		}
+			diff_ctx.uci_config = watch->config_list[i].uci_config;
+			diff_ctx.diff_cb = uci_watch_diff_cb;
+			diff_ctx.finish_cb = uci_watch_apply_cb;
+			diff_ctx.private_data = &watch_diff_ctx;
 
-		if (tmp_node->nt == UCI2_NT_LIST) {
-			// gather all values
-			uci2_iter(tmp_node, li)
-			{
-				val_list.list = xrealloc(val_list.list, sizeof(char *) * (++val_list.size));
-				val_list.list[val_list.size - 1] = transform_uci_data_cb ? transform_uci_data_cb(li->name, private_data) : xstrdup(li->name);
+			// a failed sync stays pending and is retried with the next event
+			watch->pending[i] = uci_context_diff(watch->ctx, &diff_ctx) != SRPO_UCI_ERR_OK;
+			if (watch->pending[i]) {
+				sr_discard_changes(watch->session);
 			}
-		} else if (tmp_node->nt == UCI2_NT_OPTION) {
-			// gather one value
-			val_list.list = xrealloc(val_list.list, sizeof(char *) * (++val_list.size));
-			val_list.list[val_list.size - 1] = transform_uci_data_cb ? transform_uci_data_cb(tmp_node->value, private_data) : xstrdup(tmp_node->value);
-		} else {
-			// some internal libuci2 error
-			error = SRPO_UCI_ERR_UCI;
-			goto out;
 		}
-	} else if (uci_path.package && uci_path.section) {
-		val_list.list = xrealloc(val_list.list, sizeof(char *) * (++val_list.size));
-		val_list.list[val_list.size - 1] = xstrdup("");
-	} else {
-		error = SRPO_UCI_ERR_ARGUMENT;
-		goto out;
 	}
 
-	*value_list = val_list.list;
-	*value_list_size = val_list.size;
-out:
-	uci_path_free(&uci_path);
-	return error;
+	return NULL;
 }
 
-int srpo_uci_revert(const char *uci_config)
+static void uci_watch_event_handle(srpo_uci_watch_t *watch, const struct inotify_event *event)
 {
-	int error = SRPO_UCI_ERR_OK;
-	char *uci_config_tmp = NULL;
-
-	if (uci_config == NULL) {
-		error = SRPO_UCI_ERR_UCI;
-		goto out;
-	}
-
-	error = uci_context_revert(uci_context, uci_config);
-	if (error) {
-		error = SRPO_UCI_ERR_UCI;
-		goto out;
+	for (size_t i = 0; i < watch->config_list_size; i++) {
+		// the queue overflowed, any package could have changed
+		if (event->mask & IN_Q_OVERFLOW || (event->len && strcmp(event->name, watch->config_list[i].uci_config) == 0)) {
+			watch->pending[i] = true;
+		}
 	}
-
-out:
-	FREE_SAFE(uci_config_tmp);
-	return error;
 }
 
-int srpo_uci_commit(const char *uci_config)
+static int uci_watch_diff_cb(const char *ucipath, srpo_uci_diff_op_t op, const char *old_value, const char *new_value, void *private_data)
 {
 	int error = SRPO_UCI_ERR_OK;
-	char *uci_config_tmp = NULL;
+	srpo_uci_watch_diff_ctx_t *watch_diff_ctx = private_data;
+	sr_session_ctx_t *session = watch_diff_ctx->watch->session;
+	srpo_uci_xpath_uci_template_map_t *template_entry = NULL;
+	const char *uci_value = op == SRPO_UCI_DIFF_OP_DELETE ? old_value : new_value;
+	char *xpath = NULL;
+	char *value = NULL;
+	char *item_xpath = NULL;
+	size_t item_xpath_size = 0;
+
+	template_entry = template_map_ucipath_entry_get(ucipath, watch_diff_ctx->config->uci_xpath_template_map, watch_diff_ctx->config->uci_xpath_template_map_size, &xpath, &error);
+	if (template_entry == NULL) {
+		// paths without a template are not synced
+		return error == SRPO_UCI_ERR_NOT_FOUND ? SRPO_UCI_ERR_OK : error;
+	}
 
-	if (uci_config == NULL) {
-		error = SRPO_UCI_ERR_UCI;
-		goto out;
+	if (uci_value && template_entry->transform_uci_data_cb) {
+		value = template_entry->transform_uci_data_cb(uci_value, template_entry->has_transform_uci_data_private ? watch_diff_ctx->config->private_data : NULL);
+		if (value == NULL) {
+			// transform callback dropped the value
+			goto out;
+		}
+		uci_value = value;
 	}
 
-	error = uci_context_commit(uci_context, uci_config);
-	if (error) {
-		error = SRPO_UCI_ERR_UCI;
-		goto out;
+	if (op != SRPO_UCI_DIFF_OP_DELETE) {
+		error = sr_set_item_str(session, xpath, uci_value, NULL, SR_EDIT_DEFAULT) == SR_ERR_OK ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_XPATH;
+	} else if (watch_diff_ctx->diff_ctx->list) {
+		// a removed list item is a single leaf-list instance
+		item_xpath_size = strlen(xpath) + strlen(uci_value) + sizeof("[.='']");
+		item_xpath = xmalloc(item_xpath_size);
+		snprintf(item_xpath, item_xpath_size, strchr(uci_value, '\'') ? "%s[.=\"%s\"]" : "%s[.='%s']", xpath, uci_value);
+		error = sr_delete_item(session, item_xpath, SR_EDIT_DEFAULT) == SR_ERR_OK ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_XPATH;
+	} else {
+		// sections are removed with their subtree
+		error = sr_delete_item(session, xpath, SR_EDIT_DEFAULT) == SR_ERR_OK ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_XPATH;
+	}
+
+	if (error == SRPO_UCI_ERR_OK) {
+		watch_diff_ctx->edit_count++;
 	}
 
 out:
-	FREE_SAFE(uci_config_tmp);
+	FREE_SAFE(xpath);
+	FREE_SAFE(value);
+	FREE_SAFE(item_xpath);
+
 	return error;
 }
 
-static char *path_from_template_get(const char *template, const char *data)
+static int uci_watch_apply_cb(void *private_data)
 {
-	char *path = NULL;
-	size_t path_size = 0;
+	srpo_uci_watch_diff_ctx_t *watch_diff_ctx = private_data;
 
-	if (strstr(template, "%s")) {
-		path_size = strlen(template) - 2 + (data ? strlen(data) : 0) + 1;
-		path = xmalloc(path_size);
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-		snprintf(path, path_size, template, data ? data : "");
-#pragma GCC diagnostic warning "-Wformat-nonliteral"
-	} else {
-		path = xstrdup(template);
+	if (watch_diff_ctx->edit_count == 0) {
+		return SRPO_UCI_ERR_OK;
 	}
 
-	return path;
+	// one apply per package, the changes of a uci commit reach the running datastore together
+	return sr_apply_changes(watch_diff_ctx->watch->session, 0, 1) == SR_ERR_OK ? SRPO_UCI_ERR_OK : SRPO_UCI_ERR_XPATH;
 }
 
-static uci2_n_t *uci_get_last_type(uci2_n_t *cfg, const char *type_name)
+static void uci_watch_free(srpo_uci_watch_t *watch)
 {
-	uci2_n_t *ret_node = NULL;
-	uci2_iter(cfg, t)
-	{
-		// check that the node is not deleted
-		if (t->parent && strcmp(t->name, type_name) == 0) {
-			ret_node = t;
+	if (watch) {
+		if (watch->inotify_fd >= 0) {
+			close(watch->inotify_fd);
 		}
+		if (watch->stop_pipe[0] >= 0) {
+			close(watch->stop_pipe[0]);
+		}
+		if (watch->stop_pipe[1] >= 0) {
+			close(watch->stop_pipe[1]);
+		}
+		if (watch->session) {
+			sr_session_stop(watch->session);
+		}
+		FREE_SAFE(watch->config_list);
+		FREE_SAFE(watch->pending);
+		xfree(watch);
 	}
-	return ret_node;
 }
 
-static void uci_path_init(srpo_uci_path_t *ptr)
+static void *uci_reload_thread(void *arg)
 {
-	ptr->package = NULL;
-	ptr->section = NULL;
-	ptr->option = NULL;
-	ptr->value = NULL;
-}
+	srpo_uci_reload_t *reload = arg;
+	srpo_uci_reload_request_t *requests = NULL;
 
-static void uci_path_print(srpo_uci_path_t *ptr)
-{
-	if (ptr->package)
-		printf("ptr->package = %s\n", ptr->package);
-	if (ptr->section)
-		printf("ptr->section = %s\n", ptr->section);
-	if (ptr->option)
-		printf("ptr->option = %s\n", ptr->option);
-	if (ptr->value)
-		printf("ptr->value = %s\n", ptr->value);
-}
+	pthread_mutex_lock(&reload->lock);
+	for (;;) {
+		while (!reload->stop && reload->requests == NULL) {
+			pthread_cond_wait(&reload->cond, &reload->lock);
+		}
 
-static int uci_path_parse(srpo_uci_path_t *path, const char *uci_path)
-{
-	int error = 0;
-	size_t opt_pos = 0;
-	const char delims[] = ".[]=";
-	char *token = NULL;
-	char *ucipath = xstrdup(uci_path);
+		if (reload->requests == NULL) {
+			break;
+		}
 
-	struct {
-		char **list;
-		size_t size;
-	} parts = {0, 0};
+		while (!reload->stop && pthread_cond_timedwait(&reload->cond, &reload->lock, &reload->deadline) != ETIMEDOUT)
+			;
 
-	token = strtok((char *) ucipath, delims);
-	while (token != NULL) {
-		parts.list = xrealloc(parts.list, sizeof(char *) * (++parts.size));
-		parts.list[parts.size - 1] = xstrdup(token);
-		token = strtok(NULL, delims);
-	}
-	if (parts.size > 0) {
-		path->package = xstrdup(parts.list[0]);
+		// commits that arrive during the reload open the next window
+		requests = reload->requests;
+		reload->requests = NULL;
+		reload->requests_tail = &reload->requests;
+
+		pthread_mutex_unlock(&reload->lock);
+		uci_reload_run(reload, requests);
+		pthread_mutex_lock(&reload->lock);
 	}
-	if (parts.size > 1) {
-		if (parts.list[1][0] == '@' && parts.size > 2) {
-			size_t size = strlen(parts.list[1]) + strlen(parts.list[2]) + 1;
-			path->section = xmalloc(sizeof(char) * size);
-			snprintf(path->section, size, "%s#%d", parts.list[1] + 1, atoi(parts.list[2]) + 1);
-			opt_pos = 3;
-		} else {
-			path->section = xstrdup(parts.list[1]);
-			opt_pos = 2;
+	pthread_mutex_unlock(&reload->lock);
+
+	return NULL;
+}
+
+static void uci_reload_run(srpo_uci_reload_t *reload, srpo_uci_reload_request_t *requests)
+{
+	const srpo_uci_reload_config_t **services = NULL;
+	int *results = NULL;
+	size_t services_size = 0;
+	size_t requests_size = 0;
+	srpo_uci_reload_request_t *request = NULL;
+
+	// every service is reloaded once for all of its configurations commited in the window
+	for (request = requests; request; request = request->next) {
+		const srpo_uci_reload_config_t *service = uci_reload_service_get(reload, request->uci_config);
+
+		for (request->service = 0; request->service < services_size; request->service++) {
+			if (uci_reload_service_equal(services[request->service], service)) {
+				break;
+			}
 		}
-	}
-	if (parts.size > opt_pos) {
-		if (parts.size <= opt_pos + 1) {
-			path->option = xstrdup(parts.list[opt_pos]);
-		} else {
-			path->option = xstrdup(parts.list[opt_pos]);
-			path->value = xstrdup(parts.list[opt_pos + 1]);
+
+		if (request->service == services_size) {
+			services = xrealloc(services, sizeof(srpo_uci_reload_config_t *) * (services_size + 1));
+			services[services_size++] = service;
 		}
+		requests_size++;
 	}
 
-	for (size_t i = 0; i < parts.size; i++) {
-		FREE_SAFE(parts.list[i]);
+	results = xcalloc(services_size ? services_size : 1, sizeof(int));
+	for (size_t i = 0; i < services_size; i++) {
+		srpo_ubus_call_data_t call_data = {
+			.lookup_path = services[i]->lookup_path,
+			.method = services[i]->method,
+			.json_call_arguments = services[i]->json_call_arguments,
+			.timeout = services[i]->timeout,
+		};
+
+		if (srpo_ubus_call(NULL, &call_data) != SRPO_UBUS_ERR_OK) {
+			SRPO_LOG_ERROR("reload of %s %s failed", call_data.lookup_path, call_data.method);
+			results[i] = SRPO_UCI_ERR_RELOAD;
+		}
 	}
-	FREE_SAFE(parts.list);
-	FREE_SAFE(ucipath);
-	return error;
-}
+	SRPO_LOG_DEBUG("%zu commits applied with %zu service reloads", requests_size, services_size);
 
-static void uci_path_free(srpo_uci_path_t *ptr)
-{
-	FREE_SAFE(ptr->package);
-	FREE_SAFE(ptr->section);
-	FREE_SAFE(ptr->option);
-	FREE_SAFE(ptr->value);
-}
+	while (requests) {
+		request = requests;
+		requests = request->next;
 
-static void srpo_path_list_init(srpo_path_list_t *ls)
-{
-	ls->data = NULL;
-	ls->size = 0;
-}
+		if (request->reload_cb) {
+			request->reload_cb(request->uci_config, results[request->service], request->private_data);
+		}
+		FREE_SAFE(request->uci_config);
+		xfree(request);
+	}
 
-static void srpo_path_list_append(srpo_path_list_t *ls, char *path)
-{
-	ls->data = xrealloc(ls->data, sizeof(char *) * (++ls->size));
-	ls->data[ls->size - 1] = path;
+	FREE_SAFE(services);
+	FREE_SAFE(results);
 }
 
-static void srpo_path_list_free(srpo_path_list_t *ls)
+static const srpo_uci_reload_config_t *uci_reload_service_get(srpo_uci_reload_t *reload, const char *uci_config)
 {
-	if (ls->data) {
-		for (size_t i = 0; i < ls->size; i++) {
-			FREE_SAFE(ls->data[i]);
+	// procd compares the checksums of all configurations and restarts the services of those that changed
+	static const srpo_uci_reload_config_t reload_config_default = {NULL, "uci", "reload_config", NULL, SRPO_UCI_RELOAD_TIMEOUT};
+
+	for (size_t i = 0; i < reload->config_list_size; i++) {
+		if (strcmp(reload->config_list[i].uci_config, uci_config) == 0) {
+			return &reload->config_list[i];
 		}
-		FREE_SAFE(ls->data);
-		srpo_path_list_init(ls);
 	}
+
+	return &reload_config_default;
 }
 
-static srpo_uci_ctx_t *uci_context_alloc(void)
+static bool uci_reload_service_equal(const srpo_uci_reload_config_t *a, const srpo_uci_reload_config_t *b)
 {
-	srpo_uci_ctx_t *ctx = xcalloc(1, sizeof(srpo_uci_ctx_t));
-	return ctx;
+	if (strcmp(a->lookup_path, b->lookup_path) != 0 || strcmp(a->method, b->method) != 0 || a->timeout != b->timeout) {
+		return false;
+	}
+
+	if (a->json_call_arguments == NULL || b->json_call_arguments == NULL) {
+		return a->json_call_arguments == b->json_call_arguments;
+	}
+
+	return strcmp(a->json_call_arguments, b->json_call_arguments) == 0;
 }
 
-static void uci_context_set_config_dir(srpo_uci_ctx_t *ctx, const char *dir)
+static void uci_reload_free(srpo_uci_reload_t *reload)
 {
-	ctx->config_dir = dir;
+	if (reload) {
+		if (reload->thread_started) {
+			pthread_join(reload->thread, NULL);
+		}
+		pthread_cond_destroy(&reload->cond);
+		pthread_mutex_destroy(&reload->lock);
+		for (size_t i = 0; i < reload->config_list_size; i++) {
+			xfree((void *) reload->config_list[i].uci_config);
+			xfree((void *) reload->config_list[i].lookup_path);
+			xfree((void *) reload->config_list[i].method);
+			xfree((void *) reload->config_list[i].json_call_arguments);
+		}
+		FREE_SAFE(reload->config_list);
+		xfree(reload);
+	}
 }
 
-static int uci_context_load(srpo_uci_ctx_t *ctx, const char *config)
+static void uci_context_evict(srpo_uci_ctx_t *ctx, srpo_uci_package_t *keep)
 {
-	int error = 0;
-	ctx->current_file = xstrdup(config);
-	error = uci_context_create_config_path(ctx, config);
-	ctx->parser_ctx = uci2_parse_file((const char *) ctx->config_path);
+	srpo_uci_package_t **packages = NULL;
+	size_t packages_size = 0;
+	size_t memory_size = 0;
+	size_t memory_budget = __atomic_load_n(&ctx->memory_budget, __ATOMIC_RELAXED);
 
-	if (!ctx->parser_ctx) {
-		error = SRPO_UCI_ERR_UCI_FILE;
+	if (memory_budget == 0) {
+		return;
 	}
-	return error;
-}
 
-static int uci_context_create_config_path(srpo_uci_ctx_t *ctx, const char *config)
-{
-	int error = 0;
-	size_t path_len = strlen(ctx->config_dir);
-	size_t config_len = strlen(config);
+	// packages are never removed from the cache, the pointers stay valid once the lock is released
+	pthread_mutex_lock(&ctx->packages_lock);
+	for (srpo_uci_package_t *package = ctx->packages; package; package = package->next) {
+		packages_size++;
+	}
+	packages = xcalloc(packages_size ? packages_size : 1, sizeof(srpo_uci_package_t *));
+	packages_size = 0;
+	for (srpo_uci_package_t *package = ctx->packages; package; package = package->next) {
+		packages[packages_size++] = package;
+	}
+	pthread_mutex_unlock(&ctx->packages_lock);
 
-	if (path_len + config_len + 1 > sizeof(ctx->config_path)) {
-		error = SRPO_UCI_ERR_FILE_PATH_SIZE;
+	// the budget covers what this handle can evict, arenas, replay tables and other handles are not counted
+	for (size_t i = 0; i < packages_size; i++) {
+		memory_size += uci_package_memory_size(packages[i]);
+	}
+	if (memory_size <= memory_budget) {
 		goto out;
 	}
 
-	snprintf(ctx->config_path, sizeof(ctx->config_path), "%s", ctx->config_dir);
-	if (ctx->config_path[path_len - 1] != '/') {
-		// no trailing '/' -> add one
-		ctx->config_path[path_len] = '/';
-		ctx->config_path[++path_len] = 0;
+	qsort(packages, packages_size, sizeof(srpo_uci_package_t *), uci_package_last_used_compare);
+
+	// least recently used first, the package the caller works on stays
+	for (size_t i = 0; i < packages_size && memory_size > memory_budget; i++) {
+		if (packages[i] != keep) {
+			size_t evicted_size = uci_package_evict(packages[i]);
+
+			memory_size -= evicted_size < memory_size ? evicted_size : memory_size;
+			if (evicted_size) {
+				SRPO_LOG_INFO("evicted %zu bytes of %s to stay within the memory budget of %zu bytes", evicted_size, packages[i]->name, memory_budget);
+			}
+		}
 	}
-	snprintf(ctx->config_path + path_len, sizeof(ctx->config_path) - path_len, "%s", config);
+
 out:
-	return error;
+	FREE_SAFE(packages);
 }
 
-static int uci_context_revert(srpo_uci_ctx_t *ctx, const char *config)
-{
-	int error = 0;
-	if (strcmp(config, ctx->current_file) == 0) {
-		// reload the file
-		uci2_free_ctx(ctx->parser_ctx);
-		error = uci_context_load(ctx, config);
-	}
-	return error;
-}
-static int uci_context_commit(srpo_uci_ctx_t *ctx, const char *config)
+static int uci_package_last_used_compare(const void *a, const void *b)
 {
-	int error = 0;
-	if (strcmp(config, ctx->current_file) == 0) {
-		// write to file
-		error = uci2_export_ctx_fsync(ctx->parser_ctx, ctx->config_path);
-	}
-	return error;
+	const srpo_uci_package_t *package_a = *(srpo_uci_package_t *const *) a;
+	const srpo_uci_package_t *package_b = *(srpo_uci_package_t *const *) b;
+
+	return package_a->last_used < package_b->last_used ? -1 : package_a->last_used > package_b->last_used;
 }
 
 static void uci_context_free(srpo_uci_ctx_t *ctx)
 {
 	if (ctx) {
-		if (ctx->current_file) {
-			FREE_SAFE(ctx->current_file);
+		while (ctx->packages) {
+			srpo_uci_package_t *package = ctx->packages;
+
+			ctx->packages = package->next;
+			uci_package_free(package);
 		}
-		uci2_free_ctx(ctx->parser_ctx);
-		free(ctx);
+		FREE_SAFE(ctx->config_dir);
+		FREE_SAFE(ctx->cache_dir);
+		pthread_mutex_destroy(&ctx->packages_lock);
+		xfree(ctx);
 	}
-}
\ No newline at end of file
+}
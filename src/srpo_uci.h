@@ -23,8 +23,11 @@
 #define SRPO_UCI_H_ONCE
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include <sysrepo.h>
+
 typedef enum {
 #define SRPO_UCI_ERROR_TABLE                                                  \
 	XM(SRPO_UCI_ERR_OK, 0, "Success")                                         \
@@ -37,7 +40,8 @@ typedef enum {
 	XM(SRPO_UCI_ERR_TRANSFORM_CB, -7, "Tranform data callback error")         \
 	XM(SRPO_UCI_ERR_UCI_FILE, -8, "Error opening uci config file")            \
 	XM(SRPO_UCI_ERR_DIRECTORY, -9, "Error opening uci packages directory")    \
-	XM(SRPO_UCI_ERR_FILE_PATH_SIZE, -10, "Invalid file name size")
+	XM(SRPO_UCI_ERR_FILE_PATH_SIZE, -10, "Invalid file name size")            \
+	XM(SRPO_UCI_ERR_RELOAD, -11, "Service reload failed")
 
 #define XM(ENUM, CODE, DESCRIPTION) ENUM = CODE,
 	SRPO_UCI_ERROR_TABLE
@@ -49,8 +53,38 @@ typedef enum {
 	SRPO_UCI_PATH_DIRECTION_XPATH,
 } srpo_uci_path_direction_t;
 
+typedef enum {
+	SRPO_UCI_DIFF_OP_ADD = 0,
+	SRPO_UCI_DIFF_OP_DELETE,
+	SRPO_UCI_DIFF_OP_MODIFY,
+} srpo_uci_diff_op_t;
+
+typedef enum {
+	SRPO_UCI_XPATH_TOKEN_NODE = 0,
+	SRPO_UCI_XPATH_TOKEN_KEY,
+} srpo_uci_xpath_token_type_t;
+
+// spans point into the tokenized XPath, nothing is copied
+typedef struct {
+	srpo_uci_xpath_token_type_t type;
+	const char *name; // node name with the module prefix or key name
+	size_t name_size;
+	const char *value; // key value without the quotes, NULL for nodes
+	size_t value_size;
+	char quote; // a doubled quote inside the value stands for the quote itself
+} srpo_uci_xpath_token_t;
+
+typedef struct srpo_uci_arena srpo_uci_arena_t;
+
 typedef char *(*srpo_uci_transform_data_cb)(const char *value, void *private_data);
+typedef int (*srpo_uci_transform_data_batch_cb)(const char **values, size_t values_size, srpo_uci_arena_t *arena, const char **transformed_values, void *private_data);
 typedef int (*srpo_uci_transform_path_cb)(const char *target, const char *from, const char *to, srpo_uci_path_direction_t direction, char **path);
+typedef int (*srpo_uci_ucipath_cb)(const char *ucipath, void *private_data);
+typedef int (*srpo_uci_diff_cb)(const char *ucipath, srpo_uci_diff_op_t op, const char *old_value, const char *new_value, void *private_data);
+
+typedef struct srpo_uci_ctx srpo_uci_handle_t;
+typedef struct srpo_uci_watch srpo_uci_watch_t;
+typedef struct srpo_uci_reload srpo_uci_reload_t;
 
 typedef struct {
 	const char *xpath_template;
@@ -63,18 +97,67 @@ typedef struct {
 	bool has_transform_uci_data_private;
 } srpo_uci_xpath_uci_template_map_t;
 
+// position of the %s in the templates of a map entry, -1 if the template has none
+typedef struct {
+	int xpath_key_offset;
+	int ucipath_key_offset;
+} srpo_uci_template_key_t;
+
+typedef struct {
+	const uint32_t *seeds; // per bucket hash seed
+	size_t seeds_size;
+	const uint32_t *slots; // map entry per slot
+	size_t slots_size;
+	const uint32_t *fallback; // entries matched with srpo_uci_path_get, in map order
+	size_t fallback_size;
+} srpo_uci_template_hash_t;
+
+// generated by srpo_template_map_gen.py, see SrpoTemplateMap.cmake
+typedef struct {
+	srpo_uci_xpath_uci_template_map_t *map;
+	size_t map_size;
+	const srpo_uci_template_key_t *keys;
+	srpo_uci_template_hash_t xpath_hash;
+	srpo_uci_template_hash_t ucipath_hash;
+} srpo_uci_template_index_t;
+
+typedef struct {
+	const char *uci_config;
+	srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map;
+	size_t uci_xpath_template_map_size;
+	void *private_data;
+} srpo_uci_watch_config_t;
+
+// ubus call that applies a commited UCI configuration, configurations without an entry use `uci reload_config`
+typedef struct {
+	const char *uci_config;
+	const char *lookup_path;
+	const char *method;
+	const char *json_call_arguments;
+	int timeout;
+} srpo_uci_reload_config_t;
+
+typedef void (*srpo_uci_reload_cb)(const char *uci_config, int error, void *private_data);
+
 int srpo_uci_init(void);
+int srpo_uci_preload(const char **uci_config_list, size_t uci_config_list_size, size_t worker_count);
 void srpo_uci_cleanup(void);
 
 const char *srpo_uci_error_description_get(srpo_uci_error_e error);
 
 int srpo_uci_ucipath_list_get(const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, char ***ucipath_list, size_t *ucipath_list_size, bool convert_to_extended);
+int srpo_uci_ucipath_foreach(const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, srpo_uci_ucipath_cb ucipath_cb, void *private_data);
 
 int srpo_uci_xpath_to_ucipath_convert(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, char **ucipath);
 int srpo_uci_ucipath_to_xpath_convert(const char *ucipath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, char **xpath);
+int srpo_uci_xpath_to_ucipath_indexed_convert(const char *xpath, const srpo_uci_template_index_t *index, srpo_uci_xpath_uci_template_map_t **entry, char **ucipath);
+int srpo_uci_ucipath_to_xpath_indexed_convert(const char *ucipath, const srpo_uci_template_index_t *index, srpo_uci_xpath_uci_template_map_t **entry, char **xpath);
 
 char *srpo_uci_section_name_get(const char *ucipath);
 char *srpo_uci_xpath_key_value_get(const char *xpath, int level);
+int srpo_uci_xpath_tokenize(const char *xpath, srpo_uci_xpath_token_t *token_list, size_t token_list_size, size_t *token_count);
+const srpo_uci_xpath_token_t *srpo_uci_xpath_key_get(const srpo_uci_xpath_token_t *token_list, size_t token_count, int level);
+size_t srpo_uci_xpath_token_value_copy(const srpo_uci_xpath_token_t *token, char *buffer, size_t buffer_size);
 
 int srpo_uci_path_get(const char *target, const char *from_template, const char *to_template, srpo_uci_transform_path_cb transform_path_cb, srpo_uci_path_direction_t direction, char **path);
 int srpo_uci_transform_sysrepo_data_cb_get(const char *xpath, srpo_uci_xpath_uci_template_map_t *xpath_uci_template_map, size_t xpath_uci_template_map_size, srpo_uci_transform_data_cb *transform_sysrepo_data_cb);
@@ -90,8 +173,65 @@ int srpo_uci_option_remove(const char *ucipath);
 int srpo_uci_list_set(const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data);
 int srpo_uci_list_remove(const char *ucipath, const char *value);
 int srpo_uci_element_value_get(const char *ucipath, srpo_uci_transform_data_cb transform_uci_data_cb, void *private_data, char ***value_list, size_t *value_list_size);
+int srpo_uci_list_batch_set(const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_list_replace(const char *ucipath, const char **values, size_t values_size, bool ordered, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_list_bulk_add(const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_list_bulk_remove(const char *ucipath, const char **values, size_t values_size);
+int srpo_uci_element_value_batch_get(const char *ucipath, srpo_uci_transform_data_batch_cb transform_uci_data_batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***value_list, size_t *value_list_size);
+
+int srpo_uci_arena_init(srpo_uci_arena_t **arena);
+char *srpo_uci_arena_strdup(srpo_uci_arena_t *arena, const char *value);
+void srpo_uci_arena_reset(srpo_uci_arena_t *arena);
+void srpo_uci_arena_cleanup(srpo_uci_arena_t *arena);
+
+int srpo_uci_sysrepo_export(sr_session_ctx_t *session, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended,
+							srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data);
+int srpo_uci_get_subtree(const struct ly_ctx *ly_ctx, const char *request_xpath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data, struct lyd_node **tree);
 
 int srpo_uci_revert(const char *uci_config);
+int srpo_uci_savepoint_get(const char *uci_config, size_t *savepoint);
+int srpo_uci_savepoint_revert(const char *uci_config, size_t savepoint);
 int srpo_uci_commit(const char *uci_config);
+int srpo_uci_diff(const char *uci_config, srpo_uci_diff_cb diff_cb, void *private_data);
+int srpo_uci_watch_start(sr_conn_ctx_t *connection, const srpo_uci_watch_config_t *watch_config_list, size_t watch_config_list_size, unsigned int debounce_ms, srpo_uci_watch_t **watch);
+void srpo_uci_watch_stop(srpo_uci_watch_t *watch);
+int srpo_uci_reload_start(const srpo_uci_reload_config_t *reload_config_list, size_t reload_config_list_size, unsigned int debounce_ms, srpo_uci_reload_t **reload);
+int srpo_uci_commit_reload(srpo_uci_reload_t *reload, const char *uci_config, srpo_uci_reload_cb reload_cb, void *private_data);
+void srpo_uci_reload_stop(srpo_uci_reload_t *reload);
+int srpo_uci_cache_dir_set(const char *cache_dir);
+int srpo_uci_memory_budget_set(size_t memory_budget);
+int srpo_uci_config_snapshot(const char *uci_config, const char *snapshot_dir);
+
+int srpo_uci_handle_init(const char *config_dir, srpo_uci_handle_t **handle);
+void srpo_uci_handle_cleanup(srpo_uci_handle_t *handle);
+int srpo_uci_handle_cache_dir_set(srpo_uci_handle_t *handle, const char *cache_dir);
+int srpo_uci_handle_memory_budget_set(srpo_uci_handle_t *handle, size_t memory_budget);
+int srpo_uci_handle_config_snapshot(srpo_uci_handle_t *handle, const char *uci_config, const char *snapshot_dir);
+int srpo_uci_handle_preload(srpo_uci_handle_t *handle, const char **uci_config_list, size_t uci_config_list_size, size_t worker_count);
+int srpo_uci_handle_ucipath_foreach(srpo_uci_handle_t *handle, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended, srpo_uci_ucipath_cb ucipath_cb, void *private_data);
+int srpo_uci_handle_ucipath_list_get(srpo_uci_handle_t *handle, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, char ***ucipath_list, size_t *ucipath_list_size, bool convert_to_extended);
+int srpo_uci_handle_sysrepo_export(srpo_uci_handle_t *handle, sr_session_ctx_t *session, const char *uci_config, const char **uci_section_list, size_t uci_section_list_size, bool convert_to_extended,
+							srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size, void *private_data);
+int srpo_uci_handle_get_subtree(srpo_uci_handle_t *handle, const struct ly_ctx *ly_ctx, const char *request_xpath, srpo_uci_xpath_uci_template_map_t *uci_xpath_template_map, size_t uci_xpath_template_map_size,
+								void *private_data, struct lyd_node **tree);
+int srpo_uci_handle_section_create(srpo_uci_handle_t *handle, const char *ucipath, const char *uci_section_type);
+int srpo_uci_handle_section_delete(srpo_uci_handle_t *handle, const char *ucipath);
+int srpo_uci_handle_option_set(srpo_uci_handle_t *handle, const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data);
+int srpo_uci_handle_option_remove(srpo_uci_handle_t *handle, const char *ucipath);
+int srpo_uci_handle_list_set(srpo_uci_handle_t *handle, const char *ucipath, const char *value, srpo_uci_transform_data_cb transform_sysrepo_data_cb, void *private_data);
+int srpo_uci_handle_list_remove(srpo_uci_handle_t *handle, const char *ucipath, const char *value);
+int srpo_uci_handle_element_value_get(srpo_uci_handle_t *handle, const char *ucipath, srpo_uci_transform_data_cb transform_uci_data_cb, void *private_data, char ***value_list, size_t *value_list_size);
+int srpo_uci_handle_list_batch_set(srpo_uci_handle_t *handle, const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_handle_list_replace(srpo_uci_handle_t *handle, const char *ucipath, const char **values, size_t values_size, bool ordered, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_handle_list_bulk_add(srpo_uci_handle_t *handle, const char *ucipath, const char **values, size_t values_size, srpo_uci_transform_data_batch_cb transform_sysrepo_data_batch_cb, void *private_data);
+int srpo_uci_handle_list_bulk_remove(srpo_uci_handle_t *handle, const char *ucipath, const char **values, size_t values_size);
+int srpo_uci_handle_element_value_batch_get(srpo_uci_handle_t *handle, const char *ucipath, srpo_uci_transform_data_batch_cb transform_uci_data_batch_cb, void *private_data, srpo_uci_arena_t *arena, const char ***value_list, size_t *value_list_size);
+int srpo_uci_handle_revert(srpo_uci_handle_t *handle, const char *uci_config);
+int srpo_uci_handle_savepoint_get(srpo_uci_handle_t *handle, const char *uci_config, size_t *savepoint);
+int srpo_uci_handle_savepoint_revert(srpo_uci_handle_t *handle, const char *uci_config, size_t savepoint);
+int srpo_uci_handle_commit(srpo_uci_handle_t *handle, const char *uci_config);
+int srpo_uci_handle_diff(srpo_uci_handle_t *handle, const char *uci_config, srpo_uci_diff_cb diff_cb, void *private_data);
+int srpo_uci_handle_watch_start(srpo_uci_handle_t *handle, sr_conn_ctx_t *connection, const srpo_uci_watch_config_t *watch_config_list, size_t watch_config_list_size, unsigned int debounce_ms, srpo_uci_watch_t **watch);
+int srpo_uci_handle_reload_start(srpo_uci_handle_t *handle, const srpo_uci_reload_config_t *reload_config_list, size_t reload_config_list_size, unsigned int debounce_ms, srpo_uci_reload_t **reload);
 
 #endif /* SRPO_UCI_H_ONCE */
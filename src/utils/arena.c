@@ -0,0 +1,112 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "memory.h"
+#include "stats.h"
+
+#define ARENA_ALIGN sizeof(void *)
+
+struct arena_chunk {
+	arena_chunk_t *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+void arena_init(arena_t *arena, size_t chunk_size)
+{
+	arena->chunks = NULL;
+	arena->chunk_size = chunk_size;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	arena_chunk_t *chunk = arena->chunks;
+	size_t chunk_size = 0;
+	void *ptr = NULL;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		// every chunk is at least twice the previous one, so an arena holding n bytes has O(log n) chunks to search
+		chunk_size = chunk && chunk->size > arena->chunk_size / 2 ? chunk->size * 2 : arena->chunk_size;
+		// oversized allocations get a chunk of their own
+		chunk_size = size > chunk_size ? size : chunk_size;
+		chunk = xmalloc(sizeof(arena_chunk_t) + chunk_size);
+		stats_memory_alloc(SRPO_STATS_MEMORY_ARENA, sizeof(arena_chunk_t) + chunk_size);
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+char *arena_strndup(arena_t *arena, const char *s, size_t size)
+{
+	char *res = arena_alloc(arena, size + 1);
+
+	memcpy(res, s, size);
+	res[size] = '\0';
+
+	return res;
+}
+
+bool arena_owns(const arena_t *arena, const void *ptr)
+{
+	const char *byte = ptr;
+
+	// the chunks are kept newest first, the largest chunk and the most recent allocations are checked first
+	for (const arena_chunk_t *chunk = arena->chunks; chunk; chunk = chunk->next) {
+		if (byte >= chunk->data && byte < chunk->data + chunk->size) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void arena_reset(arena_t *arena)
+{
+	arena_chunk_t *chunk = arena->chunks;
+	arena_chunk_t *next = NULL;
+
+	if (chunk == NULL) {
+		return;
+	}
+
+	// the newest chunk is kept so an arena reused for calls of similar size stops allocating
+	for (next = chunk->next; next; next = chunk->next) {
+		chunk->next = next->next;
+		stats_memory_free(SRPO_STATS_MEMORY_ARENA, sizeof(arena_chunk_t) + next->size);
+		xfree(next);
+	}
+
+	chunk->used = 0;
+}
+
+void arena_free(arena_t *arena)
+{
+	arena_chunk_t *next = NULL;
+
+	for (arena_chunk_t *chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		stats_memory_free(SRPO_STATS_MEMORY_ARENA, sizeof(arena_chunk_t) + chunk->size);
+		xfree(chunk);
+	}
+
+	arena->chunks = NULL;
+}
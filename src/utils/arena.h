@@ -0,0 +1,30 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef ARENA_H_ONCE
+#define ARENA_H_ONCE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct arena_chunk arena_chunk_t;
+
+// bump allocator, everything allocated from it is freed at once
+typedef struct {
+	arena_chunk_t *chunks;
+	size_t chunk_size; // size of the first chunk, later ones double it
+} arena_t;
+
+void arena_init(arena_t *arena, size_t chunk_size);
+void *arena_alloc(arena_t *arena, size_t size);
+char *arena_strndup(arena_t *arena, const char *s, size_t size);
+bool arena_owns(const arena_t *arena, const void *ptr);
+void arena_reset(arena_t *arena);
+void arena_free(arena_t *arena);
+
+#endif /* ARENA_H_ONCE */
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef HASH_H_ONCE
+#define HASH_H_ONCE
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 32 bit FNV-1a, the template map generator hashes the templates with the same function
+#define HASH_FNV_OFFSET 2166136261u
+#define HASH_FNV_PRIME 16777619u
+
+static inline uint32_t hash_fnv_update(uint32_t hash, const char *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= HASH_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static inline uint32_t hash_fnv(const char *string)
+{
+	uint32_t hash = HASH_FNV_OFFSET;
+
+	for (; *string; string++) {
+		hash ^= (unsigned char) *string;
+		hash *= HASH_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+#endif /* HASH_H_ONCE */
@@ -0,0 +1,100 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include "hash_table.h"
+#include "memory.h"
+
+static size_t hash_table_slot(const hash_table_t *table, const void *key);
+static void hash_table_grow(hash_table_t *table);
+
+void hash_table_init(hash_table_t *table, size_t size, hash_table_hash_cb hash_cb, hash_table_equal_cb equal_cb)
+{
+	size_t slots_size = 16;
+
+	while (slots_size < size * 2) {
+		slots_size *= 2;
+	}
+
+	table->slots = xcalloc(slots_size, sizeof(void *));
+	table->size = 0;
+	table->mask = slots_size - 1;
+	table->hash_cb = hash_cb;
+	table->equal_cb = equal_cb;
+}
+
+bool hash_table_add(hash_table_t *table, const void *entry)
+{
+	size_t slot = hash_table_slot(table, entry);
+
+	// an equal entry that is already there stays
+	if (table->slots[slot]) {
+		return false;
+	}
+
+	if ((table->size + 1) * 2 > table->mask + 1) {
+		hash_table_grow(table);
+		slot = hash_table_slot(table, entry);
+	}
+
+	table->slots[slot] = entry;
+	table->size++;
+
+	return true;
+}
+
+const void *hash_table_get(const hash_table_t *table, const void *key)
+{
+	return table->slots[hash_table_slot(table, key)];
+}
+
+size_t hash_table_memory_size(const hash_table_t *table)
+{
+	return table->slots ? (table->mask + 1) * sizeof(void *) : 0;
+}
+
+void hash_table_free(hash_table_t *table)
+{
+	FREE_SAFE(table->slots);
+	table->size = 0;
+	table->mask = 0;
+}
+
+static size_t hash_table_slot(const hash_table_t *table, const void *key)
+{
+	// the slot holding the entry equal to the key or the empty slot it would go to
+	size_t slot = table->hash_cb(key) & table->mask;
+
+	while (table->slots[slot] && !table->equal_cb(table->slots[slot], key)) {
+		slot = (slot + 1) & table->mask;
+	}
+
+	return slot;
+}
+
+static void hash_table_grow(hash_table_t *table)
+{
+	const void **slots = table->slots;
+	size_t slots_size = table->mask + 1;
+
+	table->slots = xcalloc(slots_size * 2, sizeof(void *));
+	table->mask = slots_size * 2 - 1;
+
+	// the entries are unique, each one goes to the first empty slot of its probe sequence
+	for (size_t i = 0; i < slots_size; i++) {
+		if (slots[i]) {
+			size_t slot = table->hash_cb(slots[i]) & table->mask;
+
+			while (table->slots[slot]) {
+				slot = (slot + 1) & table->mask;
+			}
+			table->slots[slot] = slots[i];
+		}
+	}
+
+	FREE_SAFE(slots);
+}
@@ -0,0 +1,35 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef HASH_TABLE_H_ONCE
+#define HASH_TABLE_H_ONCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// a key is looked up as an entry of the same kind, e.g. a section with only the fields the entries are matched by
+typedef uint32_t (*hash_table_hash_cb)(const void *entry);
+typedef bool (*hash_table_equal_cb)(const void *a, const void *b);
+
+// open addressing with linear probing over borrowed entries, kept at most half full so the probing stays short
+typedef struct {
+	const void **slots;
+	size_t size;
+	size_t mask;
+	hash_table_hash_cb hash_cb;
+	hash_table_equal_cb equal_cb;
+} hash_table_t;
+
+void hash_table_init(hash_table_t *table, size_t size, hash_table_hash_cb hash_cb, hash_table_equal_cb equal_cb);
+bool hash_table_add(hash_table_t *table, const void *entry);
+const void *hash_table_get(const hash_table_t *table, const void *key);
+size_t hash_table_memory_size(const hash_table_t *table);
+void hash_table_free(hash_table_t *table);
+
+#endif /* HASH_TABLE_H_ONCE */
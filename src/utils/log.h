@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef LOG_H_ONCE
+#define LOG_H_ONCE
+
+#include "srpo_log.h"
+
+// levels above the SRPO_LOG_LEVEL_MAX build setting are compiled out, the rest is checked against the runtime level
+// before the arguments are formatted
+#ifndef SRPO_LOG_LEVEL_MAX
+#define SRPO_LOG_LEVEL_MAX SRPO_LOG_LEVEL_DEBUG
+#endif
+
+#define SRPO_LOG(level, ...)                                             \
+	do {                                                                 \
+		if ((level) <= SRPO_LOG_LEVEL_MAX && log_level_enabled(level)) { \
+			log_write(level, __VA_ARGS__);                               \
+		}                                                                \
+	} while (0)
+
+#define SRPO_LOG_ERROR(...) SRPO_LOG(SRPO_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define SRPO_LOG_WARNING(...) SRPO_LOG(SRPO_LOG_LEVEL_WARNING, __VA_ARGS__)
+#define SRPO_LOG_INFO(...) SRPO_LOG(SRPO_LOG_LEVEL_INFO, __VA_ARGS__)
+#define SRPO_LOG_DEBUG(...) SRPO_LOG(SRPO_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+extern srpo_log_level_e log_level;
+
+static inline int log_level_enabled(srpo_log_level_e level)
+{
+	return level <= __atomic_load_n(&log_level, __ATOMIC_RELAXED);
+}
+
+void log_write(srpo_log_level_e level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif /* LOG_H_ONCE */
@@ -8,16 +8,82 @@
  * https://www.sartura.hr/
  */
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "srpo_alloc.h"
 #include "memory.h"
+#include "arena.h"
+
+#define MEMORY_SCOPE_CHUNK_SIZE 4096
+
+typedef struct {
+	arena_t arena;
+	size_t depth;
+} memory_scope_t;
+
+// installed before the first allocation, memory_allocator_used rejects any change after it
+static srpo_allocator_t memory_allocator = {0};
+static bool memory_allocator_used = false;
+static __thread memory_scope_t memory_scope = {{NULL, MEMORY_SCOPE_CHUNK_SIZE}, 0};
+
+static inline void memory_allocator_use(void)
+{
+	// the load keeps the cache line shared once the flag is set
+	if (!__atomic_load_n(&memory_allocator_used, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&memory_allocator_used, true, __ATOMIC_RELAXED);
+	}
+}
+
+int srpo_allocator_set(const srpo_allocator_t *allocator)
+{
+	// libc and a custom allocator can't be mixed, memory of one would be passed to the other
+	if (allocator && (allocator->malloc_cb == NULL || allocator->realloc_cb == NULL || allocator->free_cb == NULL) &&
+		(allocator->malloc_cb || allocator->realloc_cb || allocator->free_cb)) {
+		return EINVAL;
+	}
+
+	if (__atomic_load_n(&memory_allocator_used, __ATOMIC_RELAXED)) {
+		return EBUSY;
+	}
+
+	if (allocator) {
+		memory_allocator = *allocator;
+	} else {
+		memset(&memory_allocator, 0, sizeof(memory_allocator));
+	}
+
+	return 0;
+}
+
+void srpo_arena_begin(void)
+{
+	// nested scopes share the outermost one, its end releases everything
+	memory_scope.depth++;
+}
+
+void srpo_arena_end(void)
+{
+	if (memory_scope.depth == 0) {
+		return;
+	}
+
+	memory_scope.depth--;
+	if (memory_scope.depth == 0) {
+		arena_free(&memory_scope.arena);
+	}
+}
 
 void *xmalloc(size_t size)
 {
 	void *res;
 
-	res = malloc(size);
+	memory_allocator_use();
+
+	res = memory_allocator.malloc_cb ? memory_allocator.malloc_cb(size, memory_allocator.private_data) : malloc(size);
 
 	if (res == NULL) {
 		abort();
@@ -30,7 +96,9 @@ void *xrealloc(void *ptr, size_t size)
 {
 	void *res;
 
-	res = realloc(ptr, size);
+	memory_allocator_use();
+
+	res = memory_allocator.realloc_cb ? memory_allocator.realloc_cb(ptr, size, memory_allocator.private_data) : realloc(ptr, size);
 
 	if (res == NULL) {
 		abort();
@@ -43,7 +111,18 @@ void *xcalloc(size_t nmemb, size_t size)
 {
 	void *res;
 
-	res = calloc(nmemb, size);
+	memory_allocator_use();
+
+	if (memory_allocator.malloc_cb == NULL) {
+		res = calloc(nmemb, size);
+	} else if (size && nmemb > SIZE_MAX / size) {
+		res = NULL;
+	} else {
+		res = memory_allocator.malloc_cb(nmemb * size, memory_allocator.private_data);
+		if (res) {
+			memset(res, 0, nmemb * size);
+		}
+	}
 
 	if (res == NULL) {
 		abort();
@@ -56,7 +135,9 @@ char *xstrdup(const char *s)
 {
 	char *res;
 
-	res = strdup(s);
+	memory_allocator_use();
+
+	res = memory_allocator.malloc_cb ? xstrndup(s, strlen(s)) : strdup(s);
 
 	if (res == NULL) {
 		abort();
@@ -69,11 +150,55 @@ char *xstrndup(const char *s, size_t size)
 {
 	char *res;
 
-	res = strndup(s, size);
+	memory_allocator_use();
+
+	if (memory_allocator.malloc_cb == NULL) {
+		res = strndup(s, size);
+	} else {
+		size = strnlen(s, size);
+		res = memory_allocator.malloc_cb(size + 1, memory_allocator.private_data);
+		if (res) {
+			memcpy(res, s, size);
+			res[size] = '\0';
+		}
+	}
 
 	if (res == NULL) {
 		abort();
 	}
 
 	return res;
-}
\ No newline at end of file
+}
+
+void xfree(void *ptr)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	// scratch memory is released with the whole scope
+	if (memory_scope.depth && arena_owns(&memory_scope.arena, ptr)) {
+		return;
+	}
+
+	if (memory_allocator.free_cb) {
+		memory_allocator.free_cb(ptr, memory_allocator.private_data);
+	} else {
+		free(ptr);
+	}
+}
+
+void *scratch_malloc(size_t size)
+{
+	return memory_scope.depth ? arena_alloc(&memory_scope.arena, size) : xmalloc(size);
+}
+
+char *scratch_strdup(const char *s)
+{
+	return memory_scope.depth ? arena_strndup(&memory_scope.arena, s, strlen(s)) : xstrdup(s);
+}
+
+char *scratch_strndup(const char *s, size_t size)
+{
+	return memory_scope.depth ? arena_strndup(&memory_scope.arena, s, strnlen(s, size)) : xstrndup(s, size);
+}
@@ -15,7 +15,7 @@
 
 #define FREE_SAFE(x) \
 	do {             \
-		free(x);     \
+		xfree(x);    \
 		(x) = NULL;  \
 	} while (0)
 
@@ -24,5 +24,12 @@ void *xrealloc(void *ptr, size_t size);
 void *xcalloc(size_t nmemb, size_t size);
 char *xstrdup(const char *s);
 char *xstrndup(const char *s, size_t size);
+void xfree(void *ptr);
 
-#endif /* MEMORY_H_ONCE */
\ No newline at end of file
+// memory that never outlives the call allocating it, inside a srpo_arena_begin scope it comes from the thread's arena
+// and xfree leaves it to srpo_arena_end, it must not be passed to xrealloc
+void *scratch_malloc(size_t size);
+char *scratch_strdup(const char *s);
+char *scratch_strndup(const char *s, size_t size);
+
+#endif /* MEMORY_H_ONCE */
@@ -0,0 +1,26 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef STATS_H_ONCE
+#define STATS_H_ONCE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "srpo_stats.h"
+
+// an operation is timed from stats_clock() to stats_record(), error is the operation result, 0 for success
+uint64_t stats_clock(void);
+void stats_record(srpo_stats_op_e op, uint64_t start_ns, int error);
+
+// bytes a component holds, every stats_memory_alloc() is matched by a stats_memory_free() of the same size
+void stats_memory_alloc(srpo_stats_memory_e component, size_t size);
+void stats_memory_free(srpo_stats_memory_e component, size_t size);
+void stats_memory_evict(srpo_stats_memory_e component, size_t size);
+
+#endif /* STATS_H_ONCE */
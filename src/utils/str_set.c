@@ -0,0 +1,45 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <string.h>
+
+#include "str_set.h"
+#include "hash.h"
+
+static uint32_t str_set_hash(const void *value);
+static bool str_set_equal(const void *a, const void *b);
+
+void str_set_init(str_set_t *set, size_t size)
+{
+	hash_table_init(&set->table, size, str_set_hash, str_set_equal);
+}
+
+bool str_set_add(str_set_t *set, const char *value)
+{
+	return hash_table_add(&set->table, value);
+}
+
+bool str_set_contains(const str_set_t *set, const char *value)
+{
+	return hash_table_get(&set->table, value) != NULL;
+}
+
+void str_set_free(str_set_t *set)
+{
+	hash_table_free(&set->table);
+}
+
+static uint32_t str_set_hash(const void *value)
+{
+	return hash_fnv(value);
+}
+
+static bool str_set_equal(const void *a, const void *b)
+{
+	return strcmp(a, b) == 0;
+}
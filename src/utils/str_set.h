@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef STR_SET_H_ONCE
+#define STR_SET_H_ONCE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hash_table.h"
+
+// set of borrowed strings, the strings must outlive the set
+typedef struct {
+	hash_table_t table;
+} str_set_t;
+
+void str_set_init(str_set_t *set, size_t size);
+bool str_set_add(str_set_t *set, const char *value);
+bool str_set_contains(const str_set_t *set, const char *value);
+void str_set_free(str_set_t *set);
+
+#endif /* STR_SET_H_ONCE */
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef TRACE_H_ONCE
+#define TRACE_H_ONCE
+
+// USDT probes of the "srpo" provider, built in with the ENABLE_TRACE CMake option, e.g.
+// bpftrace -e 'usdt:/usr/lib/libsrpo.so:srpo:uci_commit_return { printf("%s %d\n", str(arg0), arg1); }'
+// a probe is a single nop until a tracer attaches, so the arguments are limited to values the caller already has
+#ifdef SRPO_TRACE
+#include <sys/sdt.h>
+
+#define TRACE1(name, arg1) DTRACE_PROBE1(srpo, name, arg1)
+#define TRACE2(name, arg1, arg2) DTRACE_PROBE2(srpo, name, arg1, arg2)
+#define TRACE3(name, arg1, arg2, arg3) DTRACE_PROBE3(srpo, name, arg1, arg2, arg3)
+#define TRACE4(name, arg1, arg2, arg3, arg4) DTRACE_PROBE4(srpo, name, arg1, arg2, arg3, arg4)
+#else
+#define TRACE1(name, arg1) \
+	do {                   \
+	} while (0)
+#define TRACE2(name, arg1, arg2) \
+	do {                         \
+	} while (0)
+#define TRACE3(name, arg1, arg2, arg3) \
+	do {                               \
+	} while (0)
+#define TRACE4(name, arg1, arg2, arg3, arg4) \
+	do {                                     \
+	} while (0)
+#endif
+
+#endif /* TRACE_H_ONCE */
@@ -0,0 +1,269 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "uci_diff.h"
+#include "hash.h"
+#include "hash_table.h"
+#include "memory.h"
+#include "str_set.h"
+
+#define UCI_DIFF_NO_MATCH SIZE_MAX
+
+static uint32_t diff_section_hash(const void *section);
+static bool diff_section_match(const void *a, const void *b);
+static void diff_table_init(hash_table_t *table, const uci_index_t *index);
+static size_t diff_table_find(const hash_table_t *table, const uci_index_t *index, const uci_index_section_t *section);
+static const uci_index_option_t *diff_option_find(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option);
+static void diff_value_set_init(str_set_t *set, const uci_index_t *index, const uci_index_option_t *option);
+static bool diff_list_order_kept(const uci_index_t *old_index, const uci_index_option_t *old_option, const str_set_t *old_set, const uci_index_t *new_index, const uci_index_option_t *new_option, const str_set_t *new_set);
+static int diff_option_emit(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, uci_diff_op_t op, uci_diff_cb diff_cb, void *private_data);
+static int diff_list_options(const uci_index_t *old_index, const uci_index_section_t *old_section, const uci_index_option_t *old_option, const uci_index_t *new_index, const uci_index_section_t *new_section, const uci_index_option_t *new_option, uci_diff_cb diff_cb, void *private_data);
+static int diff_section_options(const uci_index_t *old_index, const uci_index_section_t *old_section, const uci_index_t *new_index, const uci_index_section_t *new_section, uci_diff_cb diff_cb, void *private_data);
+
+int uci_index_diff(const uci_index_t *old_index, const uci_index_t *new_index, uci_diff_cb diff_cb, void *private_data)
+{
+	int error = 0;
+	hash_table_t table = {0};
+	size_t *matches = NULL;
+	bool *matched = NULL;
+
+	diff_table_init(&table, old_index);
+	matches = xcalloc(new_index->sections_size ? new_index->sections_size : 1, sizeof(size_t));
+	matched = xcalloc(old_index->sections_size ? old_index->sections_size : 1, sizeof(bool));
+
+	for (size_t i = 0; i < new_index->sections_size; i++) {
+		matches[i] = diff_table_find(&table, old_index, &new_index->sections[i]);
+		if (matches[i] != UCI_DIFF_NO_MATCH) {
+			matched[matches[i]] = true;
+		}
+	}
+
+	// sections that are gone, their options go with them
+	for (size_t i = 0; i < old_index->sections_size; i++) {
+		if (!matched[i]) {
+			error = diff_cb(old_index, &old_index->sections[i], NULL, UCI_DIFF_DELETE, NULL, NULL, private_data);
+			if (error) {
+				goto out;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < new_index->sections_size; i++) {
+		const uci_index_section_t *section = &new_index->sections[i];
+
+		if (matches[i] != UCI_DIFF_NO_MATCH) {
+			error = diff_section_options(old_index, &old_index->sections[matches[i]], new_index, section, diff_cb, private_data);
+			if (error) {
+				goto out;
+			}
+			continue;
+		}
+
+		// a new section is reported before its options
+		error = diff_cb(new_index, section, NULL, UCI_DIFF_ADD, NULL, NULL, private_data);
+		for (size_t j = section->option_first; j < section->option_first + section->option_count && error == 0; j++) {
+			error = diff_option_emit(new_index, section, &new_index->options[j], UCI_DIFF_ADD, diff_cb, private_data);
+		}
+		if (error) {
+			goto out;
+		}
+	}
+
+out:
+	hash_table_free(&table);
+	FREE_SAFE(matches);
+	FREE_SAFE(matched);
+
+	return error;
+}
+
+static uint32_t diff_section_hash(const void *section)
+{
+	// the key the sections are matched by
+	const uci_index_section_t *index_section = section;
+	uint32_t hash = hash_fnv(index_section->name ? index_section->name : index_section->type);
+
+	if (index_section->name == NULL) {
+		hash ^= (uint32_t) index_section->position * 2654435761u;
+	}
+
+	return hash;
+}
+
+static bool diff_section_match(const void *a, const void *b)
+{
+	const uci_index_section_t *section_a = a;
+	const uci_index_section_t *section_b = b;
+
+	// named sections are matched by name and anonymous ones by their position among the sections of the same type,
+	// a named section that changed its type is a different section
+	if (strcmp(section_a->type, section_b->type) != 0) {
+		return false;
+	}
+
+	if (section_a->name || section_b->name) {
+		return section_a->name && section_b->name && strcmp(section_a->name, section_b->name) == 0;
+	}
+
+	return section_a->position == section_b->position;
+}
+
+static void diff_table_init(hash_table_t *table, const uci_index_t *index)
+{
+	hash_table_init(table, index->sections_size, diff_section_hash, diff_section_match);
+
+	// a named section given twice is matched by its first occurrence
+	for (size_t i = 0; i < index->sections_size; i++) {
+		hash_table_add(table, &index->sections[i]);
+	}
+}
+
+static size_t diff_table_find(const hash_table_t *table, const uci_index_t *index, const uci_index_section_t *section)
+{
+	const uci_index_section_t *match = hash_table_get(table, section);
+
+	return match ? (size_t) (match - index->sections) : UCI_DIFF_NO_MATCH;
+}
+
+static const uci_index_option_t *diff_option_find(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option)
+{
+	const uci_index_option_t *found = uci_index_option_find(index, section, option->name);
+
+	// an option that became a list or the other way around is a different option
+	return found && found->list == option->list ? found : NULL;
+}
+
+static void diff_value_set_init(str_set_t *set, const uci_index_t *index, const uci_index_option_t *option)
+{
+	str_set_init(set, option->value_count);
+	for (size_t i = option->value_first; i < option->value_first + option->value_count; i++) {
+		str_set_add(set, index->values[i]);
+	}
+}
+
+static bool diff_list_order_kept(const uci_index_t *old_index, const uci_index_option_t *old_option, const str_set_t *old_set, const uci_index_t *new_index, const uci_index_option_t *new_option, const str_set_t *new_set)
+{
+	size_t old_iter = old_option->value_first;
+	size_t old_end = old_option->value_first + old_option->value_count;
+	size_t new_iter = new_option->value_first;
+	size_t new_end = new_option->value_first + new_option->value_count;
+	bool added = false;
+
+	// the items that are in both lists have to come in the same order and as often in both and the added items
+	// have to come after them, then deleting and appending single items turns the old list into the new one
+	for (;;) {
+		while (old_iter < old_end && !str_set_contains(new_set, old_index->values[old_iter])) {
+			old_iter++;
+		}
+		while (new_iter < new_end && !str_set_contains(old_set, new_index->values[new_iter])) {
+			added = true;
+			new_iter++;
+		}
+
+		if (old_iter == old_end || new_iter == new_end) {
+			return old_iter == old_end && new_iter == new_end;
+		}
+
+		if (added) {
+			return false;
+		}
+
+		if (strcmp(old_index->values[old_iter], new_index->values[new_iter]) != 0) {
+			return false;
+		}
+		old_iter++;
+		new_iter++;
+	}
+}
+
+static int diff_option_emit(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, uci_diff_op_t op, uci_diff_cb diff_cb, void *private_data)
+{
+	int error = 0;
+
+	for (size_t i = option->value_first; i < option->value_first + option->value_count && error == 0; i++) {
+		const char *value = index->values[i];
+
+		error = diff_cb(index, section, option, op, op == UCI_DIFF_DELETE ? value : NULL, op == UCI_DIFF_ADD ? value : NULL, private_data);
+	}
+
+	return error;
+}
+
+static int diff_list_options(const uci_index_t *old_index, const uci_index_section_t *old_section, const uci_index_option_t *old_option, const uci_index_t *new_index, const uci_index_section_t *new_section, const uci_index_option_t *new_option, uci_diff_cb diff_cb, void *private_data)
+{
+	int error = 0;
+	str_set_t old_set = {0};
+	str_set_t new_set = {0};
+
+	diff_value_set_init(&old_set, old_index, old_option);
+	diff_value_set_init(&new_set, new_index, new_option);
+
+	if (!diff_list_order_kept(old_index, old_option, &old_set, new_index, new_option, &new_set)) {
+		// the list was reordered, an item was inserted or is in it more or less often, the whole list is replaced so its order is kept
+		error = diff_option_emit(old_index, old_section, old_option, UCI_DIFF_DELETE, diff_cb, private_data);
+		if (error == 0) {
+			error = diff_option_emit(new_index, new_section, new_option, UCI_DIFF_ADD, diff_cb, private_data);
+		}
+		goto out;
+	}
+
+	// otherwise only the removed and the added items are reported, one by one
+	for (size_t i = old_option->value_first; i < old_option->value_first + old_option->value_count && error == 0; i++) {
+		if (!str_set_contains(&new_set, old_index->values[i])) {
+			error = diff_cb(old_index, old_section, old_option, UCI_DIFF_DELETE, old_index->values[i], NULL, private_data);
+		}
+	}
+	for (size_t i = new_option->value_first; i < new_option->value_first + new_option->value_count && error == 0; i++) {
+		if (!str_set_contains(&old_set, new_index->values[i])) {
+			error = diff_cb(new_index, new_section, new_option, UCI_DIFF_ADD, NULL, new_index->values[i], private_data);
+		}
+	}
+
+out:
+	str_set_free(&old_set);
+	str_set_free(&new_set);
+
+	return error;
+}
+
+static int diff_section_options(const uci_index_t *old_index, const uci_index_section_t *old_section, const uci_index_t *new_index, const uci_index_section_t *new_section, uci_diff_cb diff_cb, void *private_data)
+{
+	int error = 0;
+
+	// options that are gone
+	for (size_t i = old_section->option_first; i < old_section->option_first + old_section->option_count && error == 0; i++) {
+		const uci_index_option_t *old_option = &old_index->options[i];
+
+		if (diff_option_find(new_index, new_section, old_option) == NULL) {
+			error = diff_option_emit(old_index, old_section, old_option, UCI_DIFF_DELETE, diff_cb, private_data);
+		}
+	}
+
+	for (size_t i = new_section->option_first; i < new_section->option_first + new_section->option_count && error == 0; i++) {
+		const uci_index_option_t *new_option = &new_index->options[i];
+		const uci_index_option_t *old_option = diff_option_find(old_index, old_section, new_option);
+
+		if (old_option == NULL) {
+			error = diff_option_emit(new_index, new_section, new_option, UCI_DIFF_ADD, diff_cb, private_data);
+		} else if (!new_option->list) {
+			const char *old_value = old_index->values[old_option->value_first];
+			const char *new_value = new_index->values[new_option->value_first];
+
+			if (strcmp(old_value, new_value) != 0) {
+				error = diff_cb(new_index, new_section, new_option, UCI_DIFF_MODIFY, old_value, new_value, private_data);
+			}
+		} else {
+			error = diff_list_options(old_index, old_section, old_option, new_index, new_section, new_option, diff_cb, private_data);
+		}
+	}
+
+	return error;
+}
@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef UCI_DIFF_H_ONCE
+#define UCI_DIFF_H_ONCE
+
+#include "uci_index.h"
+
+typedef enum {
+	UCI_DIFF_ADD,
+	UCI_DIFF_DELETE,
+	UCI_DIFF_MODIFY,
+} uci_diff_op_t;
+
+// option is NULL for changes of the section itself, the section belongs to the index the change was found in
+typedef int (*uci_diff_cb)(const uci_index_t *index, const uci_index_section_t *section, const uci_index_option_t *option, uci_diff_op_t op, const char *old_value, const char *new_value, void *private_data);
+
+int uci_index_diff(const uci_index_t *old_index, const uci_index_t *new_index, uci_diff_cb diff_cb, void *private_data);
+
+#endif /* UCI_DIFF_H_ONCE */
@@ -0,0 +1,691 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "uci_index.h"
+#include "memory.h"
+
+#define UCI_INDEX_ARGS_MAX 3
+
+#define UCI_INDEX_CACHE_MAGIC "SRPOIDX"
+#define UCI_INDEX_CACHE_VERSION 1
+
+// the arrays follow the header in the order sections, options, values and the string table,
+// string pointers are stored as offsets into the string table plus one so NULL stays NULL
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t section_size;
+	uint32_t option_size;
+	uci_file_id_t file_id;
+	uint64_t sections_size;
+	uint64_t options_size;
+	uint64_t values_size;
+	uint64_t strings_size;
+} uci_index_cache_header_t;
+
+typedef struct {
+	char *cur;
+	char *end;
+	bool line_end;
+
+	uci_index_t *index;
+	size_t sections_capacity;
+	size_t options_capacity;
+	size_t values_capacity;
+	size_t *value_owners;
+
+	// section types seen so far and how many sections each has, gives the anonymous section positions
+	const char **types;
+	size_t *type_counts;
+	size_t types_size;
+	size_t types_capacity;
+} uci_index_parser_t;
+
+static void file_id_from_stat(const struct stat *file_stat, uci_file_id_t *file_id);
+static char *index_map(int fd, size_t size);
+static void *index_array_reserve(void *array, size_t *capacity, size_t size, size_t element_size);
+static int index_token_next(uci_index_parser_t *parser, char **token);
+static int index_section_add(uci_index_parser_t *parser, const char *type, const char *name);
+static int index_option_add(uci_index_parser_t *parser, const char *name, const char *value, bool list);
+static int index_statement_add(uci_index_parser_t *parser, char **args, size_t args_size);
+static int index_parse(uci_index_parser_t *parser);
+static void index_values_group(uci_index_parser_t *parser);
+static void index_parser_free(uci_index_parser_t *parser);
+static const char *index_cache_offset(const uci_index_t *index, const char *string);
+static int index_cache_pointer(char *strings, uint64_t strings_size, const char **string);
+static int index_cache_write(const char *cache_path, const char *image, size_t image_size);
+
+int uci_file_id_get(const char *path, uci_file_id_t *file_id)
+{
+	struct stat file_stat = {0};
+
+	if (stat(path, &file_stat) != 0) {
+		return -1;
+	}
+
+	file_id_from_stat(&file_stat, file_id);
+
+	return 0;
+}
+
+bool uci_file_id_equal(const uci_file_id_t *a, const uci_file_id_t *b)
+{
+	return a->dev == b->dev &&
+		   a->ino == b->ino &&
+		   a->size == b->size &&
+		   a->mtime.tv_sec == b->mtime.tv_sec &&
+		   a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+int uci_index_load(const char *path, uci_index_t *index)
+{
+	int error = -1;
+	int fd = -1;
+	struct stat file_stat = {0};
+	uci_index_parser_t parser = {0};
+
+	memset(index, 0, sizeof(uci_index_t));
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		goto out;
+	}
+
+	// identify the file through the descriptor that is mapped, a rename in between can not mix two files
+	if (fstat(fd, &file_stat) != 0) {
+		goto out;
+	}
+	file_id_from_stat(&file_stat, &index->file_id);
+
+	if (file_stat.st_size > 0) {
+		index->data = index_map(fd, (size_t) file_stat.st_size);
+		if (index->data == NULL) {
+			goto out;
+		}
+		index->data_size = (size_t) file_stat.st_size + 1;
+	}
+
+	parser.index = index;
+	parser.cur = index->data;
+	parser.end = index->data ? index->data + file_stat.st_size : NULL;
+
+	error = index_parse(&parser);
+	if (error) {
+		errno = EINVAL;
+		goto out;
+	}
+
+	index_values_group(&parser);
+
+	// the arrays grew by doubling, the snapshot keeps them for its whole life so they are trimmed to what is used
+	if (index->sections_size) {
+		index->sections = xrealloc(index->sections, sizeof(uci_index_section_t) * index->sections_size);
+	}
+	if (index->options_size) {
+		index->options = xrealloc(index->options, sizeof(uci_index_option_t) * index->options_size);
+	}
+
+out:
+	if (fd >= 0) {
+		close(fd);
+	}
+	index_parser_free(&parser);
+	if (error) {
+		uci_index_free(index);
+	}
+
+	return error;
+}
+
+const uci_index_option_t *uci_index_option_find(const uci_index_t *index, const uci_index_section_t *section, const char *name)
+{
+	for (size_t i = section->option_first; i < section->option_first + section->option_count; i++) {
+		if (strcmp(index->options[i].name, name) == 0) {
+			return &index->options[i];
+		}
+	}
+
+	return NULL;
+}
+
+int uci_index_cache_load(const char *cache_path, const uci_file_id_t *file_id, uci_index_t *index)
+{
+	int error = -1;
+	int fd = -1;
+	struct stat file_stat = {0};
+	char *image = NULL;
+	size_t image_size = 0;
+	uci_index_cache_header_t *header = NULL;
+	char *strings = NULL;
+
+	memset(index, 0, sizeof(uci_index_t));
+
+	fd = open(cache_path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+	if (fd < 0) {
+		goto out;
+	}
+
+	// the image is trusted like the library's own memory, only a file this process could have written itself is used
+	if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_uid != geteuid() || (file_stat.st_mode & (S_IWGRP | S_IWOTH)) ||
+		(size_t) file_stat.st_size < sizeof(uci_index_cache_header_t)) {
+		goto out;
+	}
+	image_size = (size_t) file_stat.st_size;
+
+	// the whole image is one private mapping, only the string pointers are fixed up in it
+	image = mmap(NULL, image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (image == MAP_FAILED) {
+		image = NULL;
+		goto out;
+	}
+
+	header = (uci_index_cache_header_t *) (void *) image;
+	if (memcmp(header->magic, UCI_INDEX_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != UCI_INDEX_CACHE_VERSION ||
+		header->header_size != sizeof(uci_index_cache_header_t) ||
+		header->section_size != sizeof(uci_index_section_t) ||
+		header->option_size != sizeof(uci_index_option_t) ||
+		!uci_file_id_equal(&header->file_id, file_id)) {
+		goto out;
+	}
+
+	if (sizeof(uci_index_cache_header_t) + header->sections_size * sizeof(uci_index_section_t) + header->options_size * sizeof(uci_index_option_t) +
+			header->values_size * sizeof(char *) + header->strings_size !=
+		image_size) {
+		goto out;
+	}
+
+	index->data = image;
+	index->data_size = image_size;
+	index->cached = true;
+	index->file_id = header->file_id;
+	index->sections = (uci_index_section_t *) (void *) (image + sizeof(uci_index_cache_header_t));
+	index->sections_size = (size_t) header->sections_size;
+	index->options = (uci_index_option_t *) (void *) (index->sections + index->sections_size);
+	index->options_size = (size_t) header->options_size;
+	index->values = (const char **) (void *) (index->options + index->options_size);
+	index->values_size = (size_t) header->values_size;
+	strings = (char *) (index->values + index->values_size);
+
+	for (size_t i = 0; i < index->sections_size; i++) {
+		uci_index_section_t *section = &index->sections[i];
+
+		if (index_cache_pointer(strings, header->strings_size, &section->type) || section->type == NULL ||
+			index_cache_pointer(strings, header->strings_size, &section->name) ||
+			section->option_first + section->option_count > index->options_size) {
+			goto out;
+		}
+	}
+
+	for (size_t i = 0; i < index->options_size; i++) {
+		uci_index_option_t *option = &index->options[i];
+
+		if (index_cache_pointer(strings, header->strings_size, &option->name) || option->name == NULL ||
+			option->value_first + option->value_count > index->values_size) {
+			goto out;
+		}
+	}
+
+	for (size_t i = 0; i < index->values_size; i++) {
+		if (index_cache_pointer(strings, header->strings_size, &index->values[i]) || index->values[i] == NULL) {
+			goto out;
+		}
+	}
+
+	error = 0;
+
+out:
+	if (fd >= 0) {
+		close(fd);
+	}
+	if (error) {
+		if (image && !index->cached) {
+			munmap(image, image_size);
+		}
+		uci_index_free(index);
+	}
+
+	return error;
+}
+
+int uci_index_cache_store(const uci_index_t *index, const char *cache_path)
+{
+	int error = 0;
+	char *image = NULL;
+	size_t image_size = 0;
+	uci_index_cache_header_t *header = NULL;
+	uci_index_section_t *sections = NULL;
+	uci_index_option_t *options = NULL;
+	const char **values = NULL;
+
+	image_size = sizeof(uci_index_cache_header_t) + index->sections_size * sizeof(uci_index_section_t) + index->options_size * sizeof(uci_index_option_t) +
+				 index->values_size * sizeof(char *) + index->data_size;
+	image = xcalloc(1, image_size);
+
+	header = (uci_index_cache_header_t *) (void *) image;
+	memcpy(header->magic, UCI_INDEX_CACHE_MAGIC, sizeof(header->magic));
+	header->version = UCI_INDEX_CACHE_VERSION;
+	header->header_size = sizeof(uci_index_cache_header_t);
+	header->section_size = sizeof(uci_index_section_t);
+	header->option_size = sizeof(uci_index_option_t);
+	header->file_id = index->file_id;
+	header->sections_size = index->sections_size;
+	header->options_size = index->options_size;
+	header->values_size = index->values_size;
+	header->strings_size = index->data_size;
+
+	sections = (uci_index_section_t *) (void *) (image + sizeof(uci_index_cache_header_t));
+	for (size_t i = 0; i < index->sections_size; i++) {
+		sections[i] = index->sections[i];
+		sections[i].type = index_cache_offset(index, index->sections[i].type);
+		sections[i].name = index_cache_offset(index, index->sections[i].name);
+	}
+
+	options = (uci_index_option_t *) (void *) (sections + index->sections_size);
+	for (size_t i = 0; i < index->options_size; i++) {
+		options[i] = index->options[i];
+		options[i].name = index_cache_offset(index, index->options[i].name);
+	}
+
+	values = (const char **) (void *) (options + index->options_size);
+	for (size_t i = 0; i < index->values_size; i++) {
+		values[i] = index_cache_offset(index, index->values[i]);
+	}
+
+	// the file data already holds every string NUL terminated, it is the string table as is
+	if (index->data_size) {
+		memcpy(values + index->values_size, index->data, index->data_size);
+	}
+
+	error = index_cache_write(cache_path, image, image_size);
+	xfree(image);
+
+	return error;
+}
+
+size_t uci_index_memory_size(const uci_index_t *index)
+{
+	// a cache image holds the arrays too, a parsed file has them allocated next to the mapping
+	if (index->cached) {
+		return index->data_size;
+	}
+
+	return index->data_size + index->sections_size * sizeof(uci_index_section_t) + index->options_size * sizeof(uci_index_option_t) +
+		   index->values_size * sizeof(char *);
+}
+
+void uci_index_free(uci_index_t *index)
+{
+	if (index->data) {
+		munmap(index->data, index->data_size);
+	}
+	if (!index->cached) {
+		FREE_SAFE(index->sections);
+		FREE_SAFE(index->options);
+		FREE_SAFE(index->values);
+	}
+	memset(index, 0, sizeof(uci_index_t));
+}
+
+static void file_id_from_stat(const struct stat *file_stat, uci_file_id_t *file_id)
+{
+	file_id->dev = file_stat->st_dev;
+	file_id->ino = file_stat->st_ino;
+	file_id->size = file_stat->st_size;
+	file_id->mtime = file_stat->st_mtim;
+}
+
+static char *index_map(int fd, size_t size)
+{
+	char *data = NULL;
+
+	// reserve one byte more than the file so the last token can be NUL terminated in place as well,
+	// the spare byte is anonymous memory even if the file ends on a page boundary
+	data = mmap(NULL, size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	// private mapping, unescaping and terminating tokens only touches our copy of the pages
+	if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(data, size + 1);
+		return NULL;
+	}
+
+	return data;
+}
+
+static void *index_array_reserve(void *array, size_t *capacity, size_t size, size_t element_size)
+{
+	if (size == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 16;
+		array = xrealloc(array, element_size * *capacity);
+	}
+
+	return array;
+}
+
+static int index_token_next(uci_index_parser_t *parser, char **token)
+{
+	char *read = parser->cur;
+	char *write = NULL;
+	char *quote = NULL;
+	char *escape = NULL;
+
+	// the previous token ended the line
+	if (parser->line_end) {
+		parser->line_end = false;
+		return 0;
+	}
+
+	while (read < parser->end && (*read == ' ' || *read == '\t' || *read == '\r' || (*read == '\\' && read + 1 < parser->end && read[1] == '\n'))) {
+		read += *read == '\\' ? 2 : 1;
+	}
+
+	if (read == parser->end) {
+		parser->cur = read;
+		return 0;
+	}
+
+	if (*read == '\n' || *read == '#') {
+		// comments run to the end of the line
+		quote = *read == '#' ? memchr(read, '\n', (size_t) (parser->end - read)) : read;
+		parser->cur = quote ? quote + 1 : parser->end;
+		return 0;
+	}
+
+	// unescape the token in place, it never grows so the write position stays behind the read position
+	*token = write = read;
+	while (read < parser->end) {
+		if (*read == '\'') {
+			// no escapes inside single quotes
+			quote = memchr(read + 1, '\'', (size_t) (parser->end - read - 1));
+			if (quote == NULL) {
+				return -1;
+			}
+			memmove(write, read + 1, (size_t) (quote - read - 1));
+			write += quote - read - 1;
+			read = quote + 1;
+		} else if (*read == '"') {
+			read++;
+			for (;;) {
+				quote = memchr(read, '"', (size_t) (parser->end - read));
+				if (quote == NULL) {
+					return -1;
+				}
+
+				escape = memchr(read, '\\', (size_t) (quote - read));
+				if (escape == NULL) {
+					break;
+				}
+
+				// an escaped quote is skipped here and the closing one is searched again
+				memmove(write, read, (size_t) (escape - read));
+				write += escape - read;
+				if (escape[1] != '\n') {
+					*write++ = escape[1];
+				}
+				read = escape + 2;
+			}
+			memmove(write, read, (size_t) (quote - read));
+			write += quote - read;
+			read = quote + 1;
+		} else if (*read == '\\') {
+			if (read + 1 == parser->end) {
+				return -1;
+			}
+			if (read[1] != '\n') {
+				*write++ = read[1];
+			}
+			read += 2;
+		} else if (*read == ' ' || *read == '\t' || *read == '\r' || *read == '\n') {
+			break;
+		} else {
+			*write++ = *read++;
+		}
+	}
+
+	// consume the delimiter before the terminator can overwrite it
+	if (read < parser->end) {
+		parser->line_end = *read == '\n';
+		read++;
+	}
+	*write = 0;
+	parser->cur = read;
+
+	return 1;
+}
+
+static int index_section_add(uci_index_parser_t *parser, const char *type, const char *name)
+{
+	uci_index_t *index = parser->index;
+	uci_index_section_t *section = NULL;
+	size_t type_iter = 0;
+
+	for (type_iter = 0; type_iter < parser->types_size; type_iter++) {
+		if (strcmp(parser->types[type_iter], type) == 0) {
+			break;
+		}
+	}
+
+	if (type_iter == parser->types_size) {
+		size_t types_capacity = parser->types_capacity;
+
+		parser->types = index_array_reserve(parser->types, &parser->types_capacity, parser->types_size, sizeof(char *));
+		parser->type_counts = index_array_reserve(parser->type_counts, &types_capacity, parser->types_size, sizeof(size_t));
+		parser->types[parser->types_size] = type;
+		parser->type_counts[parser->types_size] = 0;
+		parser->types_size++;
+	}
+
+	index->sections = index_array_reserve(index->sections, &parser->sections_capacity, index->sections_size, sizeof(uci_index_section_t));
+	section = &index->sections[index->sections_size++];
+	section->type = type;
+	section->name = name;
+	section->position = parser->type_counts[type_iter]++;
+	section->option_first = index->options_size;
+	section->option_count = 0;
+
+	return 0;
+}
+
+static int index_option_add(uci_index_parser_t *parser, const char *name, const char *value, bool list)
+{
+	uci_index_t *index = parser->index;
+	uci_index_section_t *section = NULL;
+	uci_index_option_t *option = NULL;
+	size_t option_iter = 0;
+	size_t values_capacity = parser->values_capacity;
+
+	if (index->sections_size == 0) {
+		return -1;
+	}
+	section = &index->sections[index->sections_size - 1];
+
+	// list items with the same name belong to one list even if other options are written in between
+	if (list) {
+		for (option_iter = section->option_first; option_iter < index->options_size; option_iter++) {
+			if (index->options[option_iter].list && strcmp(index->options[option_iter].name, name) == 0) {
+				option = &index->options[option_iter];
+				break;
+			}
+		}
+	}
+
+	if (option == NULL) {
+		index->options = index_array_reserve(index->options, &parser->options_capacity, index->options_size, sizeof(uci_index_option_t));
+		option_iter = index->options_size++;
+		option = &index->options[option_iter];
+		option->name = name;
+		option->list = list;
+		option->value_first = 0;
+		option->value_count = 0;
+		section->option_count++;
+	}
+
+	index->values = index_array_reserve(index->values, &parser->values_capacity, index->values_size, sizeof(char *));
+	parser->value_owners = index_array_reserve(parser->value_owners, &values_capacity, index->values_size, sizeof(size_t));
+	index->values[index->values_size] = value;
+	parser->value_owners[index->values_size] = option_iter;
+	index->values_size++;
+	option->value_count++;
+
+	return 0;
+}
+
+static int index_statement_add(uci_index_parser_t *parser, char **args, size_t args_size)
+{
+	if (strcmp(args[0], "package") == 0 && args_size == 2) {
+		// the package name is given by the file name
+		return 0;
+	} else if (strcmp(args[0], "config") == 0 && (args_size == 2 || args_size == 3)) {
+		return index_section_add(parser, args[1], args_size == 3 ? args[2] : NULL);
+	} else if (strcmp(args[0], "option") == 0 && args_size == 3) {
+		return index_option_add(parser, args[1], args[2], false);
+	} else if (strcmp(args[0], "list") == 0 && args_size == 3) {
+		return index_option_add(parser, args[1], args[2], true);
+	}
+
+	return -1;
+}
+
+static int index_parse(uci_index_parser_t *parser)
+{
+	int error = 0;
+	char *args[UCI_INDEX_ARGS_MAX + 1] = {0};
+	size_t args_size = 0;
+	char *token = NULL;
+
+	while (parser->cur < parser->end || parser->line_end) {
+		args_size = 0;
+		while ((error = index_token_next(parser, &token)) == 1) {
+			if (args_size == UCI_INDEX_ARGS_MAX + 1) {
+				return -1;
+			}
+			args[args_size++] = token;
+		}
+
+		if (error) {
+			return -1;
+		}
+
+		if (args_size && index_statement_add(parser, args, args_size)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void index_values_group(uci_index_parser_t *parser)
+{
+	uci_index_t *index = parser->index;
+	const char **values = NULL;
+	size_t value_first = 0;
+
+	if (index->values_size == 0) {
+		return;
+	}
+
+	// values were collected in file order, regroup them so every option owns one contiguous range
+	for (size_t i = 0; i < index->options_size; i++) {
+		index->options[i].value_first = value_first;
+		value_first += index->options[i].value_count;
+		index->options[i].value_count = 0;
+	}
+
+	values = xmalloc(sizeof(char *) * index->values_size);
+	for (size_t i = 0; i < index->values_size; i++) {
+		uci_index_option_t *option = &index->options[parser->value_owners[i]];
+
+		values[option->value_first + option->value_count++] = index->values[i];
+	}
+
+	xfree(index->values);
+	index->values = values;
+}
+
+static void index_parser_free(uci_index_parser_t *parser)
+{
+	FREE_SAFE(parser->value_owners);
+	FREE_SAFE(parser->types);
+	FREE_SAFE(parser->type_counts);
+}
+
+static const char *index_cache_offset(const uci_index_t *index, const char *string)
+{
+	return string ? (const char *) (uintptr_t) (string - index->data + 1) : NULL;
+}
+
+static int index_cache_pointer(char *strings, uint64_t strings_size, const char **string)
+{
+	uintptr_t offset = (uintptr_t) *string;
+
+	if (offset == 0) {
+		return 0;
+	}
+
+	// a corrupted image must not point outside of the string table
+	if (offset > strings_size) {
+		return -1;
+	}
+
+	*string = strings + offset - 1;
+
+	return 0;
+}
+
+static int index_cache_write(const char *cache_path, const char *image, size_t image_size)
+{
+	int error = -1;
+	int fd = -1;
+	char tmp_path[PATH_MAX] = {0};
+	size_t written = 0;
+	ssize_t ret = 0;
+
+	if ((size_t) snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", cache_path) >= sizeof(tmp_path)) {
+		return -1;
+	}
+
+	fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		return -1;
+	}
+
+	while (written < image_size) {
+		ret = write(fd, image + written, image_size - written);
+		if (ret < 0 && errno != EINTR) {
+			goto out;
+		}
+		written += ret > 0 ? (size_t) ret : 0;
+	}
+
+	// readers either see the previous image or the complete new one
+	if (rename(tmp_path, cache_path) == 0) {
+		error = 0;
+	}
+
+out:
+	close(fd);
+	if (error) {
+		unlink(tmp_path);
+	}
+
+	return error;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef UCI_INDEX_H_ONCE
+#define UCI_INDEX_H_ONCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+// identity of a file on disk, changes whenever the file is rewritten or replaced
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+} uci_file_id_t;
+
+typedef struct {
+	const char *type;
+	const char *name; // NULL for anonymous sections
+	size_t position;  // position among the sections of the same type, the n in @type[n]
+	size_t option_first;
+	size_t option_count;
+} uci_index_section_t;
+
+typedef struct {
+	const char *name;
+	bool list;
+	size_t value_first;
+	size_t value_count;
+} uci_index_option_t;
+
+// read-only view of a UCI file, all strings point into data
+typedef struct {
+	char *data;
+	size_t data_size;
+	bool cached; // data is a cache image which also holds the arrays
+	uci_file_id_t file_id;
+
+	uci_index_section_t *sections;
+	size_t sections_size;
+	uci_index_option_t *options;
+	size_t options_size;
+	const char **values;
+	size_t values_size;
+} uci_index_t;
+
+int uci_file_id_get(const char *path, uci_file_id_t *file_id);
+bool uci_file_id_equal(const uci_file_id_t *a, const uci_file_id_t *b);
+
+int uci_index_load(const char *path, uci_index_t *index);
+int uci_index_cache_load(const char *cache_path, const uci_file_id_t *file_id, uci_index_t *index);
+int uci_index_cache_store(const uci_index_t *index, const char *cache_path);
+const uci_index_option_t *uci_index_option_find(const uci_index_t *index, const uci_index_section_t *section, const char *name);
+size_t uci_index_memory_size(const uci_index_t *index);
+void uci_index_free(uci_index_t *index);
+
+#endif /* UCI_INDEX_H_ONCE */
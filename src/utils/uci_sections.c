@@ -0,0 +1,128 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <string.h>
+
+#include "uci_sections.h"
+#include "hash.h"
+#include "memory.h"
+
+static uint32_t sections_type_hash(const void *type_sections);
+static bool sections_type_equal(const void *a, const void *b);
+static uci_sections_type_t *sections_type_find(const uci_sections_t *sections, const char *type);
+
+void uci_sections_init(uci_sections_t *sections)
+{
+	hash_table_init(&sections->types, 0, sections_type_hash, sections_type_equal);
+}
+
+void uci_sections_append(uci_sections_t *sections, const char *type, const void *section)
+{
+	uci_sections_type_t *type_sections = sections_type_find(sections, type);
+
+	if (type_sections == NULL) {
+		type_sections = xcalloc(1, sizeof(uci_sections_type_t));
+		type_sections->type = type;
+		hash_table_add(&sections->types, type_sections);
+	}
+
+	if (type_sections->sections_size == type_sections->sections_capacity) {
+		type_sections->sections_capacity = type_sections->sections_capacity ? type_sections->sections_capacity * 2 : 4;
+		type_sections->sections = xrealloc(type_sections->sections, type_sections->sections_capacity * sizeof(void *));
+	}
+
+	type_sections->sections[type_sections->sections_size++] = section;
+}
+
+bool uci_sections_remove(uci_sections_t *sections, const char *type, const void *section)
+{
+	uci_sections_type_t *type_sections = sections_type_find(sections, type);
+
+	if (type_sections == NULL) {
+		return false;
+	}
+
+	// the sections behind the removed one move up by one position, just like @type[n] does in UCI
+	for (size_t i = 0; i < type_sections->sections_size; i++) {
+		if (type_sections->sections[i] == section) {
+			memmove(&type_sections->sections[i], &type_sections->sections[i + 1], (type_sections->sections_size - i - 1) * sizeof(void *));
+			type_sections->sections_size--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const void *uci_sections_get(const uci_sections_t *sections, const char *type, long position)
+{
+	const uci_sections_type_t *type_sections = sections_type_find(sections, type);
+	size_t index = 0;
+
+	if (type_sections == NULL) {
+		return NULL;
+	}
+
+	// negative positions count from the last section, @type[-1] is the last one
+	if (position < 0) {
+		if ((size_t) -position > type_sections->sections_size) {
+			return NULL;
+		}
+		index = type_sections->sections_size - (size_t) -position;
+	} else {
+		index = (size_t) position;
+	}
+
+	return index < type_sections->sections_size ? type_sections->sections[index] : NULL;
+}
+
+size_t uci_sections_memory_size(const uci_sections_t *sections)
+{
+	size_t size = hash_table_memory_size(&sections->types);
+
+	for (size_t i = 0; sections->types.slots && i <= sections->types.mask; i++) {
+		const uci_sections_type_t *type_sections = sections->types.slots[i];
+
+		if (type_sections) {
+			size += sizeof(uci_sections_type_t) + type_sections->sections_capacity * sizeof(void *);
+		}
+	}
+
+	return size;
+}
+
+void uci_sections_free(uci_sections_t *sections)
+{
+	for (size_t i = 0; sections->types.slots && i <= sections->types.mask; i++) {
+		uci_sections_type_t *type_sections = (uci_sections_type_t *) sections->types.slots[i];
+
+		if (type_sections) {
+			xfree(type_sections->sections);
+			xfree(type_sections);
+		}
+	}
+
+	hash_table_free(&sections->types);
+}
+
+static uint32_t sections_type_hash(const void *type_sections)
+{
+	return hash_fnv(((const uci_sections_type_t *) type_sections)->type);
+}
+
+static bool sections_type_equal(const void *a, const void *b)
+{
+	return strcmp(((const uci_sections_type_t *) a)->type, ((const uci_sections_type_t *) b)->type) == 0;
+}
+
+static uci_sections_type_t *sections_type_find(const uci_sections_t *sections, const char *type)
+{
+	uci_sections_type_t key = {.type = type};
+
+	return (uci_sections_type_t *) hash_table_get(&sections->types, &key);
+}
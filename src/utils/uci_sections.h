@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#ifndef UCI_SECTIONS_H_ONCE
+#define UCI_SECTIONS_H_ONCE
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hash_table.h"
+
+// sections of one type in file order, position n is the section addressed by @type[n]
+typedef struct {
+	const char *type;
+	const void **sections;
+	size_t sections_size;
+	size_t sections_capacity;
+} uci_sections_type_t;
+
+// positional index of the sections of a configuration, the section handles and type names are borrowed
+typedef struct {
+	hash_table_t types; // uci_sections_type_t by type name
+} uci_sections_t;
+
+void uci_sections_init(uci_sections_t *sections);
+void uci_sections_append(uci_sections_t *sections, const char *type, const void *section);
+bool uci_sections_remove(uci_sections_t *sections, const char *type, const void *section);
+const void *uci_sections_get(const uci_sections_t *sections, const char *type, long position);
+size_t uci_sections_memory_size(const uci_sections_t *sections);
+void uci_sections_free(uci_sections_t *sections);
+
+#endif /* UCI_SECTIONS_H_ONCE */
@@ -0,0 +1,385 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2019 Sartura Ltd.
+ *
+ * https://www.sartura.hr/
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libuci2.h>
+
+#include "utils/memory.h"
+#include "utils/uci_index.h"
+
+// both parsers are reduced to the same form, lists are merged by name in the order their first item appears
+typedef struct {
+	const char *name;
+	bool list;
+	const char **values;
+	size_t values_size;
+} test_option_t;
+
+typedef struct {
+	const char *type;
+	const char *name;
+	size_t position;
+	test_option_t *options;
+	size_t options_size;
+} test_section_t;
+
+typedef struct {
+	test_section_t *sections;
+	size_t sections_size;
+} test_config_t;
+
+static int test_file(const char *path);
+static void test_config_from_index(const uci_index_t *index, test_config_t *config);
+static void test_config_from_uci2(uci2_parser_ctx_t *ctx, test_config_t *config);
+static void test_section_from_uci2(test_config_t *config, const char *type, const char *name, uci2_n_t *node);
+static test_section_t *test_section_add(test_config_t *config, const char *type, const char *name);
+static test_option_t *test_option_add(test_section_t *section, const char *name, bool list);
+static void test_value_add(test_option_t *option, const char *value);
+static int test_section_compare(const void *a, const void *b);
+static size_t test_config_compare(const char *path, test_config_t *index_config, test_config_t *uci2_config);
+static size_t test_section_diff(const char *path, const test_section_t *index_section, const test_section_t *uci2_section);
+static bool test_string_equal(const char *a, const char *b);
+static void test_config_free(test_config_t *config);
+
+int main(int argc, char **argv)
+{
+	int error = 0;
+	DIR *corpus = NULL;
+	struct dirent *entry = NULL;
+	char path[PATH_MAX] = {0};
+	size_t files = 0;
+	size_t failed = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s corpus_dir\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	corpus = opendir(argv[1]);
+	if (corpus == NULL) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	while ((entry = readdir(corpus)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		if (snprintf(path, sizeof(path), "%s/%s", argv[1], entry->d_name) >= (int) sizeof(path)) {
+			fprintf(stderr, "%s/%s: path too long\n", argv[1], entry->d_name);
+			failed++;
+			continue;
+		}
+
+		error = test_file(path);
+		if (error) {
+			failed++;
+		}
+		files++;
+	}
+
+	closedir(corpus);
+
+	if (files == 0) {
+		fprintf(stderr, "%s: no UCI files in the corpus\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%zu of %zu files parsed the same by the UCI index and libuci2\n", files - failed, files);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int test_file(const char *path)
+{
+	int error = 0;
+	uci_index_t index = {0};
+	uci2_parser_ctx_t *ctx = NULL;
+	test_config_t index_config = {0};
+	test_config_t uci2_config = {0};
+
+	error = uci_index_load(path, &index);
+	if (error) {
+		fprintf(stderr, "%s: the UCI index failed to parse the file\n", path);
+		goto out;
+	}
+
+	ctx = uci2_parse_file(path);
+	if (ctx == NULL) {
+		fprintf(stderr, "%s: libuci2 failed to parse the file\n", path);
+		error = -1;
+		goto out;
+	}
+
+	test_config_from_index(&index, &index_config);
+	test_config_from_uci2(ctx, &uci2_config);
+
+	error = test_config_compare(path, &index_config, &uci2_config) ? -1 : 0;
+
+out:
+	test_config_free(&index_config);
+	test_config_free(&uci2_config);
+	if (ctx) {
+		uci2_free_ctx(ctx);
+	}
+	uci_index_free(&index);
+
+	return error;
+}
+
+static void test_config_from_index(const uci_index_t *index, test_config_t *config)
+{
+	for (size_t i = 0; i < index->sections_size; i++) {
+		const uci_index_section_t *index_section = &index->sections[i];
+		test_section_t *section = test_section_add(config, index_section->type, index_section->name);
+
+		section->position = index_section->position;
+		for (size_t j = 0; j < index_section->option_count; j++) {
+			const uci_index_option_t *index_option = &index->options[index_section->option_first + j];
+			test_option_t *option = test_option_add(section, index_option->name, index_option->list);
+
+			for (size_t k = 0; k < index_option->value_count; k++) {
+				test_value_add(option, index->values[index_option->value_first + k]);
+			}
+		}
+	}
+}
+
+static void test_config_from_uci2(uci2_parser_ctx_t *ctx, test_config_t *config)
+{
+	uci2_n_t *root = UCI2_CFG_ROOT(ctx);
+	size_t position = 0;
+
+	if (root == NULL) {
+		return;
+	}
+
+	// same walk as the @type[n] lookup of the library, a type node is an anonymous section or holds named sections
+	for (int i = 0; i < uci2_nc(root); i++) {
+		uci2_n_t *type = root->ch[i];
+		bool named = false;
+
+		if (type->nt != UCI2_NT_TYPE) {
+			continue;
+		}
+
+		for (int j = 0; j < uci2_nc(type); j++) {
+			if (type->ch[j]->nt == UCI2_NT_SECTION_NAME) {
+				named = true;
+				test_section_from_uci2(config, type->name, type->ch[j]->name, type->ch[j]);
+			}
+		}
+
+		if (!named) {
+			test_section_from_uci2(config, type->name, NULL, type);
+		}
+	}
+
+	// positions count the sections of each type in walk order
+	for (size_t i = 0; i < config->sections_size; i++) {
+		position = 0;
+		for (size_t j = 0; j < i; j++) {
+			if (strcmp(config->sections[j].type, config->sections[i].type) == 0) {
+				position++;
+			}
+		}
+		config->sections[i].position = position;
+	}
+}
+
+static void test_section_from_uci2(test_config_t *config, const char *type, const char *name, uci2_n_t *node)
+{
+	test_section_t *section = test_section_add(config, type, name);
+
+	for (int i = 0; i < uci2_nc(node); i++) {
+		uci2_n_t *child = node->ch[i];
+		test_option_t *option = NULL;
+
+		if (child->nt == UCI2_NT_OPTION) {
+			option = test_option_add(section, child->name, false);
+			test_value_add(option, child->value);
+		} else if (child->nt == UCI2_NT_LIST) {
+			for (size_t j = 0; j < section->options_size; j++) {
+				if (section->options[j].list && strcmp(section->options[j].name, child->name) == 0) {
+					option = &section->options[j];
+					break;
+				}
+			}
+			if (option == NULL) {
+				option = test_option_add(section, child->name, true);
+			}
+
+			// the value of a list item is its node name
+			for (int j = 0; j < uci2_nc(child); j++) {
+				if (child->ch[j]->nt == UCI2_NT_LIST_ITEM) {
+					test_value_add(option, child->ch[j]->name);
+				}
+			}
+		}
+	}
+}
+
+static test_section_t *test_section_add(test_config_t *config, const char *type, const char *name)
+{
+	test_section_t *section = NULL;
+
+	config->sections = xrealloc(config->sections, sizeof(test_section_t) * (config->sections_size + 1));
+	section = &config->sections[config->sections_size++];
+	memset(section, 0, sizeof(test_section_t));
+	section->type = type;
+	section->name = name;
+
+	return section;
+}
+
+static test_option_t *test_option_add(test_section_t *section, const char *name, bool list)
+{
+	test_option_t *option = NULL;
+
+	section->options = xrealloc(section->options, sizeof(test_option_t) * (section->options_size + 1));
+	option = &section->options[section->options_size++];
+	memset(option, 0, sizeof(test_option_t));
+	option->name = name;
+	option->list = list;
+
+	return option;
+}
+
+static void test_value_add(test_option_t *option, const char *value)
+{
+	option->values = xrealloc(option->values, sizeof(char *) * (option->values_size + 1));
+	option->values[option->values_size++] = value;
+}
+
+static int test_section_compare(const void *a, const void *b)
+{
+	const test_section_t *section_a = a;
+	const test_section_t *section_b = b;
+	int type_compare = strcmp(section_a->type, section_b->type);
+
+	if (type_compare) {
+		return type_compare;
+	}
+
+	return (section_a->position > section_b->position) - (section_a->position < section_b->position);
+}
+
+static size_t test_config_compare(const char *path, test_config_t *index_config, test_config_t *uci2_config)
+{
+	size_t mismatches = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	// both sides are matched by @type[n], which is how the library resolves anonymous sections
+	qsort(index_config->sections, index_config->sections_size, sizeof(test_section_t), test_section_compare);
+	qsort(uci2_config->sections, uci2_config->sections_size, sizeof(test_section_t), test_section_compare);
+
+	while (i < index_config->sections_size || j < uci2_config->sections_size) {
+		int compare = 0;
+
+		if (i == index_config->sections_size) {
+			compare = 1;
+		} else if (j == uci2_config->sections_size) {
+			compare = -1;
+		} else {
+			compare = test_section_compare(&index_config->sections[i], &uci2_config->sections[j]);
+		}
+
+		if (compare < 0) {
+			fprintf(stderr, "%s: @%s[%zu] only found by the UCI index\n", path, index_config->sections[i].type, index_config->sections[i].position);
+			mismatches++;
+			i++;
+		} else if (compare > 0) {
+			fprintf(stderr, "%s: @%s[%zu] only found by libuci2\n", path, uci2_config->sections[j].type, uci2_config->sections[j].position);
+			mismatches++;
+			j++;
+		} else {
+			mismatches += test_section_diff(path, &index_config->sections[i], &uci2_config->sections[j]);
+			i++;
+			j++;
+		}
+	}
+
+	return mismatches;
+}
+
+static size_t test_section_diff(const char *path, const test_section_t *index_section, const test_section_t *uci2_section)
+{
+	size_t mismatches = 0;
+	const char *type = index_section->type;
+	size_t position = index_section->position;
+
+	if (!test_string_equal(index_section->name, uci2_section->name)) {
+		fprintf(stderr, "%s: @%s[%zu] is named \"%s\" by the UCI index and \"%s\" by libuci2\n", path, type, position,
+				index_section->name ? index_section->name : "", uci2_section->name ? uci2_section->name : "");
+		mismatches++;
+	}
+
+	if (index_section->options_size != uci2_section->options_size) {
+		fprintf(stderr, "%s: @%s[%zu] has %zu options in the UCI index and %zu in libuci2\n", path, type, position, index_section->options_size, uci2_section->options_size);
+		return mismatches + 1;
+	}
+
+	for (size_t i = 0; i < index_section->options_size; i++) {
+		const test_option_t *index_option = &index_section->options[i];
+		const test_option_t *uci2_option = &uci2_section->options[i];
+
+		if (strcmp(index_option->name, uci2_option->name) != 0 || index_option->list != uci2_option->list) {
+			fprintf(stderr, "%s: @%s[%zu] option %zu is %s \"%s\" in the UCI index and %s \"%s\" in libuci2\n", path, type, position, i,
+					index_option->list ? "list" : "option", index_option->name, uci2_option->list ? "list" : "option", uci2_option->name);
+			mismatches++;
+			continue;
+		}
+
+		if (index_option->values_size != uci2_option->values_size) {
+			fprintf(stderr, "%s: @%s[%zu].%s has %zu values in the UCI index and %zu in libuci2\n", path, type, position, index_option->name,
+					index_option->values_size, uci2_option->values_size);
+			mismatches++;
+			continue;
+		}
+
+		// list order is part of the value
+		for (size_t j = 0; j < index_option->values_size; j++) {
+			if (!test_string_equal(index_option->values[j], uci2_option->values[j])) {
+				fprintf(stderr, "%s: @%s[%zu].%s value %zu is \"%s\" in the UCI index and \"%s\" in libuci2\n", path, type, position, index_option->name, j,
+						index_option->values[j] ? index_option->values[j] : "", uci2_option->values[j] ? uci2_option->values[j] : "");
+				mismatches++;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+static bool test_string_equal(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+
+	return strcmp(a, b) == 0;
+}
+
+static void test_config_free(test_config_t *config)
+{
+	for (size_t i = 0; i < config->sections_size; i++) {
+		for (size_t j = 0; j < config->sections[i].options_size; j++) {
+			FREE_SAFE(config->sections[i].options[j].values);
+		}
+		FREE_SAFE(config->sections[i].options);
+	}
+	FREE_SAFE(config->sections);
+	config->sections_size = 0;
+}